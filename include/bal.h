@@ -51,17 +51,56 @@ bool bal_shutdown(bal_socket* s, int how);
 
 bool bal_connect(bal_socket* s, const char* host, const char* port);
 bool bal_connect_addrlist(bal_socket* s, bal_addrlist* al);
+bool bal_connect_race(bal_socket* s, const char* host, const char* port);
+bool bal_connect_race_addrlist(bal_socket* s, bal_addrlist* al);
 
 ssize_t bal_send(const bal_socket* s, const void* data, bal_iolen len, int flags);
 ssize_t bal_recv(const bal_socket* s, void* data, bal_iolen len, int flags);
 
+bal_io_result bal_try_send(const bal_socket* s, const void* data, bal_iolen len, int flags);
+bal_io_result bal_try_recv(const bal_socket* s, void* data, bal_iolen len, int flags);
+
 ssize_t bal_sendto(const bal_socket* s, const char* host, const char* port, const void* data,
     bal_iolen len, int flags);
 ssize_t bal_sendto_addr(const bal_socket* s, const bal_sockaddr* sa, const void* data,
     bal_iolen len, int flags);
 
+bool bal_dest_prepare(const char* host, const char* port, bal_dest* dest);
+ssize_t bal_sendto_dest(const bal_socket* s, const bal_dest* dest, const void* data,
+    bal_iolen len, int flags);
+ssize_t bal_sendto_dests(const bal_socket* s, const bal_dest* dests, size_t count,
+    const void* data, bal_iolen len, int flags);
+
 ssize_t bal_recvfrom(const bal_socket* s, void* data, bal_iolen len, int flags, bal_sockaddr* res);
 
+bool bal_set_framing(bal_socket* s, const bal_framing* cfg);
+bool bal_get_frame(const bal_socket* s, bal_frame* out);
+
+bool bal_set_coalescing(bal_socket* s, bool enable);
+bool bal_flush(const bal_socket* s);
+
+bool bal_set_arena(bal_socket* s, size_t chunk_size);
+void* bal_arena_alloc(bal_socket* s, size_t size);
+bool bal_arena_reset(bal_socket* s);
+
+bool bal_pool_create(bal_pool** pool, const bal_pool_cfg* cfg);
+bool bal_pool_destroy(bal_pool** pool);
+bool bal_pool_checkout(bal_pool* pool, const char* host, const char* port, bal_socket** out);
+bool bal_pool_checkout_async(bal_pool* pool, const char* host, const char* port,
+    bal_pool_cb cb, void* ctx);
+bool bal_pool_checkin(bal_socket** s, bool reuse);
+bool bal_pool_get_stats(const bal_pool* pool, bal_pool_stats* out);
+
+bool bal_set_watermarks(bal_socket* s, size_t low, size_t high, bool pause_read);
+size_t bal_get_sendqueue_size(const bal_socket* s);
+
+bool bal_enable_timestamping(bal_socket* s, uint32_t flags);
+ssize_t bal_recv_ts(const bal_socket* s, void* data, bal_iolen len, int flags,
+    bal_timestamp* ts);
+ssize_t bal_recvfrom_ts(const bal_socket* s, void* data, bal_iolen len, int flags,
+    bal_sockaddr* res, bal_timestamp* ts);
+bool bal_get_tx_timestamp(const bal_socket* s, bal_timestamp* ts);
+
 bool bal_bind(const bal_socket* s, const char* addr, const char* srv);
 bool bal_bindall(const bal_socket* s, const char* srv);
 
@@ -113,16 +152,37 @@ bool bal_is_writable(const bal_socket* s);
 bool bal_is_listening(const bal_socket* s);
 
 bool bal_resolve_host(const char* host, bal_addrlist* out);
+bool bal_parse_addr(const char* host, const char* port, bal_sockaddr* out);
+bool bal_resolve_async(const char* host, const char* port, bal_resolve_cb cb, void* ctx);
+bool bal_connect_async(bal_socket* s, const char* host, const char* port);
+bool bal_set_resolver_cache(size_t max_entries, uint32_t ttl_sec, uint32_t neg_ttl_sec);
+bool bal_flush_resolver_cache(void);
+bool bal_get_resolver_cache_stats(bal_cache_stats* out);
 bool bal_get_peer_addr(const bal_socket* s, bal_sockaddr* out);
 bool bal_get_peer_strings(const bal_socket* s, bool dns, bal_addrstrings* out);
 bool bal_get_localhost_addr(const bal_socket* s, bal_sockaddr* out);
 bool bal_get_localhost_strings(const bal_socket* s, bool dns, bal_addrstrings* out);
 bool bal_get_addrstrings(const bal_sockaddr* in, bool dns, bal_addrstrings* out);
+size_t bal_format_addr(const bal_sockaddr* in, char* buf, size_t size);
+bool bal_set_rdns_cache(size_t max_entries, uint32_t ttl_sec, uint32_t neg_ttl_sec);
+bool bal_flush_rdns_cache(void);
+bool bal_get_rdns_cache_stats(bal_cache_stats* out);
 
 bool bal_reset_addrlist(bal_addrlist* addrs);
 const bal_sockaddr* bal_enum_addrlist(bal_addrlist* addrs);
+size_t bal_count_addrlist(const bal_addrlist* addrs);
 bool bal_free_addrlist(bal_addrlist* addrs);
 
+bool bal_get_stats(bal_stats* out);
+bool bal_get_socket_stats(const bal_socket* s, bal_socket_stats* out);
+bool bal_get_histogram(int which, bal_histogram* out);
+uint64_t bal_histogram_bucket_min(size_t bucket);
+uint64_t bal_histogram_percentile(const bal_histogram* h, double pct);
+bool bal_set_callback_budget(uint64_t budget_nsec, bal_slow_cb cb, void* ctx);
+bool bal_trace_dump(const char* path);
+bool bal_get_lock_stats(bal_lock_stats* out, size_t* count);
+bool bal_reset_lock_stats(void);
+
 void bal_thread_yield(void);
 void bal_sleep_msec(uint32_t msec);
 
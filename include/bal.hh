@@ -28,14 +28,31 @@
 
 # include "bal.h"
 # include <type_traits>
+# include <concepts>
 # include <functional>
 # include <stdexcept>
 # include <cstdlib>
 # include <cstring>
 # include <vector>
+# include <span>
+# include <memory_resource>
+# include <limits>
 # include <atomic>
 # include <string>
+# include <string_view>
 # include <version>
+# include <chrono>
+# include <algorithm>
+# include <coroutine>
+# include <mutex>
+# include <new>
+# include <exception>
+# include <memory>
+# include <thread>
+# include <condition_variable>
+# include <deque>
+# include <optional>
+# include <array>
 
 # if defined(__has_include)
 #  define __HAS_INCLUDE(hdr) __has_include(hdr)
@@ -48,6 +65,11 @@
 #  define source_location std::source_location
 # endif
 
+# if defined(__cpp_lib_format) && __HAS_INCLUDE(<format>)
+#  include <format>
+#  define __HAVE_STD_FORMAT__
+# endif
+
 # if defined(__cpp_lib_bit_cast) && __HAS_INCLUDE(<bit>)
 #  include <bit>
 #  define bit_cast std::bit_cast
@@ -79,11 +101,18 @@ namespace bal
         ~exception() override = default;
     };
 
+    /** Strings describing an address. Allocates through its allocator (e.g. a
+     * std::pmr::monotonic_buffer_resource). */
     class address_info
     {
     public:
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
         address_info() = default;
-        explicit address_info(const bal_addrstrings& strings)
+        explicit address_info(const allocator_type& alloc)
+            : _type(alloc), _host(alloc), _addr(alloc), _port(alloc) { }
+        explicit address_info(const bal_addrstrings& strings, const allocator_type& alloc = {})
+            : address_info(alloc)
         {
             *this = strings;
         }
@@ -98,10 +127,12 @@ namespace bal
             return *this;
         }
 
-        std::string get_type() const { return _type; }
-        std::string get_host() const { return _host; }
-        std::string get_addr() const { return _addr; }
-        std::string get_port() const { return _port; }
+        const std::pmr::string& get_type() const noexcept { return _type; }
+        const std::pmr::string& get_host() const noexcept { return _host; }
+        const std::pmr::string& get_addr() const noexcept { return _addr; }
+        const std::pmr::string& get_port() const noexcept { return _port; }
+
+        allocator_type get_allocator() const noexcept { return _type.get_allocator(); }
 
         void clear()
         {
@@ -112,10 +143,73 @@ namespace bal
         }
 
     private:
-        std::string _type;
-        std::string _host;
-        std::string _addr;
-        std::string _port;
+        std::pmr::string _type;
+        std::pmr::string _host;
+        std::pmr::string _addr;
+        std::pmr::string _port;
+    };
+
+    /** The outcome of a nonblocking send/recv, in the manner of std::expected:
+     * a byte count when the operation made progress, a BAL_IO_* status when it
+     * did not (would block, end of stream or error). */
+    class io_result
+    {
+    public:
+        io_result() = default;
+        explicit io_result(const bal_io_result& res) noexcept : _res(res) { }
+        ~io_result() = default;
+
+        bool has_value() const noexcept
+        {
+            return BAL_IO_OK == _res.status || BAL_IO_PARTIAL == _res.status;
+        }
+
+        explicit operator bool() const noexcept { return has_value(); }
+
+        size_t value() const
+        {
+            if (!has_value()) {
+                throw exception("io_result holds status " + std::to_string(_res.status) +
+                    ", not a value");
+            }
+            return _res.bytes;
+        }
+
+        size_t operator*() const noexcept { return _res.bytes; }
+        size_t value_or(size_t def) const noexcept { return has_value() ? _res.bytes : def; }
+
+        /** The BAL_IO_* status (meaningful when has_value() is false). */
+        int error() const noexcept { return _res.status; }
+
+        bool partial() const noexcept { return BAL_IO_PARTIAL == _res.status; }
+        bool would_block() const noexcept { return BAL_IO_WOULDBLOCK == _res.status; }
+        bool eof() const noexcept { return BAL_IO_EOF == _res.status; }
+
+    private:
+        bal_io_result _res {BAL_IO_ERROR, 0U};
+    };
+
+    /** The numeric "addr:port" form of an address, held without allocating. */
+    class address_string
+    {
+    public:
+        address_string() = default;
+        explicit address_string(const bal_sockaddr& addr)
+        {
+            _len = bal_format_addr(&addr, _buf, sizeof(_buf));
+        }
+        ~address_string() = default;
+
+        std::string_view view() const noexcept { return {_buf, _len}; }
+        const char* c_str() const noexcept { return _buf; }
+        size_t size() const noexcept { return _len; }
+        bool empty() const noexcept { return 0U == _len; }
+
+        operator std::string_view() const noexcept { return view(); }
+
+    private:
+        char _buf[BAL_ADDRSTRLEN] {};
+        size_t _len = 0U;
     };
 
     class address
@@ -123,22 +217,42 @@ namespace bal
     public:
         address() = default;
         explicit address(const bal_sockaddr& addr) : _sockaddr(addr) { }
+        explicit address(const bal_dest& dest) : _sockaddr(dest.addr) { }
         virtual ~address() = default;
 
+        /** Resolves host/port once, for use with repeated calls to sendto. */
+        static address prepare(const std::string& host, const std::string& port)
+        {
+            bal_dest dest {};
+            if (!bal_dest_prepare(host.c_str(), port.c_str(), &dest)) {
+                throw exception(error::from_last_error());
+            }
+
+            return address {dest};
+        }
+
         address& operator=(const bal_sockaddr& addr)
         {
             _sockaddr = addr;
             return *this;
         }
 
-        address_info get_address_info(bool dns_resolve = false) const
+        address_info get_address_info(bool dns_resolve = false,
+            const address_info::allocator_type& alloc = {}) const
         {
             bal_addrstrings strings {};
             if (!bal_get_addrstrings(&_sockaddr, dns_resolve, &strings)) {
                 throw exception(error::from_last_error());
             }
 
-            return address_info {strings};
+            return address_info {strings, alloc};
+        }
+
+        /** Formats the numeric address and port without consulting a resolver
+         * or allocating; the result is empty if the address is unset. */
+        address_string to_string() const noexcept
+        {
+            return address_string {_sockaddr};
         }
 
         const bal_sockaddr& get_sockaddr() const
@@ -155,13 +269,15 @@ namespace bal
         bal_sockaddr _sockaddr {};
     };
 
-    class address_list : public std::vector<address>
+    /** Addresses copied from a bal_addrlist; allocates through its allocator. */
+    class address_list : public std::pmr::vector<address>
     {
     public:
-        using Base = std::vector<address>;
+        using Base = std::pmr::vector<address>;
         using Base::vector;
 
-        explicit address_list(bal_addrlist& addrs)
+        explicit address_list(bal_addrlist& addrs, const allocator_type& alloc = {})
+            : Base(alloc)
         {
             *this = addrs;
         }
@@ -172,6 +288,8 @@ namespace bal
                 throw exception(error::from_last_error());
             }
 
+            Base::reserve(Base::size() + bal_count_addrlist(&addrs));
+
             auto addr = bal_enum_addrlist(&addrs);
             while (addr != nullptr) {
                 Base::emplace_back(address {*addr});
@@ -215,6 +333,13 @@ namespace bal
         return value;
     }
 
+    /** Clamps a buffer's size to what one send or receive can transfer. */
+    constexpr bal_iolen to_iolen(size_t size) noexcept
+    {
+        constexpr auto max = static_cast<size_t>(std::numeric_limits<bal_iolen>::max());
+        return static_cast<bal_iolen>(std::min(size, max));
+    }
+
     class initializer
     {
     public:
@@ -237,70 +362,221 @@ namespace bal
         initializer& operator=(initializer&&) = delete;
     };
 
-    template<bool RAII, DerivedFromPolicy TPolicy>
-    class socket_base
+    /** Recycles coroutine frames (see task). libbal has a single event thread, so
+     * one pool serves every coroutine it resumes. Frames up to 1 KiB are kept in
+     * 64-byte size classes; larger ones come from operator new. */
+    class frame_pool
     {
     public:
-        using async_io_cb = std::function<bool(socket_base*)>;
+        static void* allocate(size_t size)
+        {
+            const auto cls = _class_of(size);
+            if (cls < _classes) {
+                auto& pool = _instance();
+                std::lock_guard<std::mutex> lock(pool._mutex);
+                if (auto* blk = pool._free[cls]; blk != nullptr) {
+                    pool._free[cls] = blk->next;
+                    pool._count[cls]--;
+                    return blk;
+                }
+                size = (cls + 1) * _granularity;
+            }
+            return ::operator new(size);
+        }
 
-        socket_base()
+        static void deallocate(void* ptr, size_t size) noexcept
         {
-            set_default_event_handlers();
+            const auto cls = _class_of(size);
+            if (cls < _classes) {
+                auto& pool = _instance();
+                std::lock_guard<std::mutex> lock(pool._mutex);
+                if (pool._count[cls] < _max_free) {
+                    pool._free[cls] = new (ptr) block {pool._free[cls]};
+                    pool._count[cls]++;
+                    return;
+                }
+            }
+            ::operator delete(ptr);
         }
 
-        socket_base(const socket_base&) = delete;
+    private:
+        struct block
+        {
+            block* next = nullptr;
+        };
+
+        static constexpr size_t _granularity = 64;
+        static constexpr size_t _classes     = 16;
+        static constexpr size_t _max_free    = 64;
 
-        socket_base(socket_base&& other) noexcept
+        frame_pool() = default;
+
+        ~frame_pool()
         {
-            *this = other;
+            for (auto* blk : _free) {
+                while (blk != nullptr) {
+                    auto* next = blk->next;
+                    ::operator delete(blk);
+                    blk = next;
+                }
+            }
         }
 
-        socket_base(int addr_fam, int type, int proto) requires RAII : socket_base()
+        static frame_pool& _instance()
         {
-            [[maybe_unused]]
-            auto unused = create(addr_fam, type, proto);
+            static frame_pool pool;
+            return pool;
         }
 
-        socket_base(int addr_fam, int proto, const std::string& host,
-            const std::string& srv) requires RAII : socket_base()
+        static constexpr size_t _class_of(size_t size) noexcept
         {
-            [[maybe_unused]]
-            auto unused = create(addr_fam, proto, host, srv);
+            return size == 0 ? 0 : (size - 1) / _granularity;
         }
 
-        virtual ~socket_base()
+        std::mutex _mutex;
+        block* _free[_classes] {};
+        size_t _count[_classes] {};
+    };
+
+    /** The return type of a coroutine that awaits socket operations (see
+     * socket_base::async_recv). It starts running immediately and cannot itself
+     * be awaited; once suspended, it is resumed by the event thread. An exception
+     * that escapes the coroutine ends it, and is kept for the task to observe. */
+    class task
+    {
+        struct state
         {
-            if constexpr(RAII) {
-                if (is_valid()) {
-                    [[maybe_unused]] auto unused1 = deregister_async_poll();
-                    [[maybe_unused]] auto unused2 = bal_close(&_s, true);
+            std::atomic_bool done = false;
+            std::exception_ptr error;
+        };
+
+    public:
+        class promise_type
+        {
+        public:
+            promise_type() : _state(std::make_shared<state>()) { }
+            ~promise_type() { _state->done.store(true, std::memory_order_release); }
+
+            task get_return_object() noexcept { return task {_state}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept { }
+
+            void unhandled_exception() noexcept
+            {
+                try {
+                    throw;
+                } catch (std::exception& ex) {
+                    _bal_dbglog("error: caught exception: '%s'!", ex.what());
+                } catch (...) {
+                    _bal_dbglog("error: caught unknown exception!");
                 }
+                _state->error = std::current_exception();
+            }
+
+            static void* operator new(size_t size)
+            {
+                return frame_pool::allocate(size);
+            }
+
+            static void operator delete(void* ptr, size_t size) noexcept
+            {
+                frame_pool::deallocate(ptr, size);
             }
+
+        private:
+            std::shared_ptr<state> _state;
+        };
+
+        task() = default;
+
+        /** Whether the coroutine has finished, by returning or by throwing. */
+        bool done() const noexcept
+        {
+            return _state && _state->done.load(std::memory_order_acquire);
         }
 
-        socket_base& operator=(socket_base&) = delete;
+        /** The exception that ended the coroutine; null until it is done, or if
+         * it returned. */
+        std::exception_ptr exception() const noexcept
+        {
+            return done() ? _state->error : nullptr;
+        }
 
-        socket_base& operator=(socket_base&& rhs) noexcept
+        /** Rethrows the exception that ended the coroutine, if there was one. */
+        void rethrow_if_failed() const
         {
-            [[maybe_unused]] const auto* unused = attach(rhs.detach());
+            if (const auto error = exception()) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        explicit task(std::shared_ptr<state> st) noexcept : _state(std::move(st)) { }
 
-            on_read          = rhs.on_read;
-            on_write         = rhs.on_write;
-            on_connect       = rhs.on_connect;
-            on_conn_fail     = rhs.on_conn_fail;
-            on_incoming_conn = rhs.on_incoming_conn;
-            on_close         = rhs.on_close;
-            on_priority      = rhs.on_priority;
-            on_error         = rhs.on_error;
-            on_invalid       = rhs.on_invalid;
-            on_oob_read      = rhs.on_oob_read;
-            on_oob_write     = rhs.on_oob_write;
+        std::shared_ptr<state> _state;
+    };
 
-            rhs.set_default_event_handlers();
+    /** A coroutine suspended on one of socket_base's awaitables. */
+    class io_waiter
+    {
+    public:
+        /** Attempts the operation once `events` arrive; returns true when done. */
+        virtual bool try_complete(uint32_t events) = 0;
 
-            return *this;
+        std::coroutine_handle<> handle;
+
+    protected:
+        ~io_waiter() = default;
+    };
+
+    /** A std::pmr::memory_resource over a socket's arena (see bal_arena_alloc).
+     * Deallocation does nothing: memory is reclaimed by bal_arena_reset, or when
+     * the socket is destroyed. Like the arena, it is not thread-safe. */
+    class arena_resource : public std::pmr::memory_resource
+    {
+    public:
+        explicit arena_resource(bal_socket* s) noexcept : _s(s) { }
+        ~arena_resource() override = default;
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            const size_t extra = alignment > BAL_ARENA_ALIGN ? alignment - 1 : 0;
+            void* ptr = bal_arena_alloc(_s, std::max<size_t>(bytes, 1) + extra);
+            if (ptr == nullptr) {
+                throw std::bad_alloc();
+            }
+
+            const auto addr = bit_cast<uintptr_t>(ptr);
+            return bit_cast<void*>((addr + extra) & ~static_cast<uintptr_t>(extra));
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+        {
+            BAL_UNUSED(ptr);
+            BAL_UNUSED(bytes);
+            BAL_UNUSED(alignment);
         }
 
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            const auto* rhs = dynamic_cast<const arena_resource*>(&other);
+            return rhs != nullptr && rhs->_s == _s;
+        }
+
+    private:
+        bal_socket* _s = nullptr;
+    };
+
+    /** The socket operations shared by socket_base and socket<THandler>. */
+    template<bool RAII, DerivedFromPolicy TPolicy>
+    class basic_socket
+    {
+    public:
+        basic_socket(const basic_socket&) = delete;
+        basic_socket& operator=(const basic_socket&) = delete;
+
         bal_socket* get() const noexcept
         {
             return _s;
@@ -372,24 +648,26 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool async_poll(uint32_t mask = BAL_EVT_NORMAL)
+        bool deregister_async_poll() noexcept
         {
-            if (!is_valid()) {
-                return false;
-            }
+            return is_valid() ? bal_async_poll(_s, nullptr, 0U) : false;
+        }
 
-            const auto ret = bal_async_poll(_s, &socket_base::_on_async_io, mask);
+        bool connect(const std::string& host, const std::string& port)
+        {
+            const auto ret = bal_connect(_s, host.c_str(), port.c_str());
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool deregister_async_poll() noexcept
+        bool connect_async(const std::string& host, const std::string& port)
         {
-            return is_valid() ? bal_async_poll(_s, nullptr, 0U) : false;
+            const auto ret = bal_connect_async(_s, host.c_str(), port.c_str());
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool connect(const std::string& host, const std::string& port)
+        bool connect_race(const std::string& host, const std::string& port)
         {
-            const auto ret = bal_connect(_s, host.c_str(), port.c_str());
+            const auto ret = bal_connect_race(_s, host.c_str(), port.c_str());
             return throw_on_policy<TPolicy>(ret, false);
         }
 
@@ -399,6 +677,11 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, -1L);
         }
 
+        ssize_t send(std::span<const std::byte> data, int flags = MSG_NOSIGNAL) const
+        {
+            return send(data.data(), to_iolen(data.size()), flags);
+        }
+
         ssize_t sendto(const std::string& host, const std::string& port,
             const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
         {
@@ -407,12 +690,90 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, -1L);
         }
 
+        ssize_t sendto(const std::string& host, const std::string& port,
+            std::span<const std::byte> data, int flags = MSG_NOSIGNAL) const
+        {
+            return sendto(host, port, data.data(), to_iolen(data.size()), flags);
+        }
+
+        ssize_t sendto(const address& addr, const void* data, bal_iolen len,
+            int flags = MSG_NOSIGNAL) const
+        {
+            const auto ret =
+                bal_sendto_addr(_s, &addr.get_sockaddr(), data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        ssize_t sendto(const address& addr, std::span<const std::byte> data,
+            int flags = MSG_NOSIGNAL) const
+        {
+            return sendto(addr, data.data(), to_iolen(data.size()), flags);
+        }
+
+        ssize_t sendto(const bal_dest& dest, const void* data, bal_iolen len,
+            int flags = MSG_NOSIGNAL) const
+        {
+            const auto ret = bal_sendto_dest(_s, &dest, data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        ssize_t sendto(const bal_dest& dest, std::span<const std::byte> data,
+            int flags = MSG_NOSIGNAL) const
+        {
+            return sendto(dest, data.data(), to_iolen(data.size()), flags);
+        }
+
+        ssize_t sendto(const std::vector<bal_dest>& dests, const void* data,
+            bal_iolen len, int flags = MSG_NOSIGNAL) const
+        {
+            const auto ret =
+                bal_sendto_dests(_s, dests.data(), dests.size(), data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        ssize_t sendto(const std::vector<bal_dest>& dests, std::span<const std::byte> data,
+            int flags = MSG_NOSIGNAL) const
+        {
+            return sendto(dests, data.data(), to_iolen(data.size()), flags);
+        }
+
         ssize_t recv(void* data, bal_iolen len, int flags) const
         {
             const auto ret = bal_recv(_s, data, len, flags);
             return throw_on_policy<TPolicy>(ret, -1L);
         }
 
+        ssize_t recv(std::span<std::byte> data, int flags = 0) const
+        {
+            return recv(data.data(), to_iolen(data.size()), flags);
+        }
+
+        /** Only BAL_IO_ERROR is subject to the error policy; would-block and
+         * end of stream are ordinary results. */
+        io_result try_send(const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
+        {
+            const auto ret = bal_try_send(_s, data, len, flags);
+            throw_on_policy<TPolicy>(ret.status, BAL_IO_ERROR);
+            return io_result {ret};
+        }
+
+        io_result try_send(std::span<const std::byte> data, int flags = MSG_NOSIGNAL) const
+        {
+            return try_send(data.data(), to_iolen(data.size()), flags);
+        }
+
+        io_result try_recv(void* data, bal_iolen len, int flags = 0) const
+        {
+            const auto ret = bal_try_recv(_s, data, len, flags);
+            throw_on_policy<TPolicy>(ret.status, BAL_IO_ERROR);
+            return io_result {ret};
+        }
+
+        io_result try_recv(std::span<std::byte> data, int flags = 0) const
+        {
+            return try_recv(data.data(), to_iolen(data.size()), flags);
+        }
+
         ssize_t recvfrom(void* data, bal_iolen len, int flags, address& whence) const
         {
             whence.clear();
@@ -426,6 +787,64 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, -1L);
         }
 
+        ssize_t recvfrom(std::span<std::byte> data, int flags, address& whence) const
+        {
+            return recvfrom(data.data(), to_iolen(data.size()), flags, whence);
+        }
+
+        ssize_t recv_ts(void* data, bal_iolen len, int flags, bal_timestamp& ts) const
+        {
+            const auto ret = bal_recv_ts(_s, data, len, flags, &ts);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        ssize_t recv_ts(std::span<std::byte> data, int flags, bal_timestamp& ts) const
+        {
+            return recv_ts(data.data(), to_iolen(data.size()), flags, ts);
+        }
+
+        bool enable_timestamping(uint32_t flags)
+        {
+            const auto ret = bal_enable_timestamping(_s, flags);
+            if (ret) {
+                if (0U != flags) {
+                    bal_addtomask(_s, BAL_EVT_TXTIME);
+                } else {
+                    bal_remfrommask(_s, BAL_EVT_TXTIME);
+                }
+            }
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool get_tx_timestamp(bal_timestamp& ts) const
+        {
+            return bal_get_tx_timestamp(_s, &ts);
+        }
+
+        bool set_framing(const bal_framing& framing)
+        {
+            const auto ret = bal_set_framing(_s, &framing);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool get_frame(bal_frame& frame) const
+        {
+            const auto ret = bal_get_frame(_s, &frame);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool set_coalescing(bool enable)
+        {
+            const auto ret = bal_set_coalescing(_s, enable);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool flush() const
+        {
+            const auto ret = bal_flush(_s);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
         bool bind(const std::string& addr, const std::string& srv) const
         {
             const auto ret = bal_bind(_s, addr.c_str(), srv.c_str());
@@ -444,7 +863,7 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool accept(socket_base& client_sock, address& client_addr) const
+        bool accept(basic_socket& client_sock, address& client_addr) const
         {
             [[maybe_unused]] const auto* existing = client_sock.detach();
             BAL_ASSERT(existing == nullptr);
@@ -647,177 +1066,1814 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_peer_addr(address& peer_addr) const
+        static bool set_resolver_cache(size_t max_entries, uint32_t ttl_sec,
+            uint32_t neg_ttl_sec)
         {
-            peer_addr.clear();
+            const auto ret = bal_set_resolver_cache(max_entries, ttl_sec, neg_ttl_sec);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
 
-            bal_sockaddr addr {};
-            const auto ret = bal_get_peer_addr(_s, &addr);
-            if (ret) {
-                peer_addr = addr;
-            }
+        static bool flush_resolver_cache()
+        {
+            const auto ret = bal_flush_resolver_cache();
+            return throw_on_policy<TPolicy>(ret, false);
+        }
 
+        static bool get_resolver_cache_stats(bal_cache_stats& stats)
+        {
+            const auto ret = bal_get_resolver_cache_stats(&stats);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        void want_write_events(bool want)
+        static bool set_rdns_cache(size_t max_entries, uint32_t ttl_sec,
+            uint32_t neg_ttl_sec)
         {
-            if (want) {
-                bal_addtomask(_s, BAL_EVT_WRITE);
-            } else {
-                bal_remfrommask(_s, BAL_EVT_WRITE);
-            }
+            const auto ret = bal_set_rdns_cache(max_entries, ttl_sec, neg_ttl_sec);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        static socket_base* from_user_data(bal_socket* s)
+        static bool flush_rdns_cache()
         {
-            return bit_cast<socket_base*>(s->user_data);
+            const auto ret = bal_flush_rdns_cache();
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        uintptr_t to_user_data() const
+        static bool get_rdns_cache_stats(bal_cache_stats& stats)
         {
-            return bit_cast<uintptr_t>(this);
+            const auto ret = bal_get_rdns_cache_stats(&stats);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        async_io_cb on_read;
-        async_io_cb on_write;
-        async_io_cb on_connect;
-        async_io_cb on_conn_fail;
-        async_io_cb on_incoming_conn;
-        async_io_cb on_close;
-        async_io_cb on_priority;
-        async_io_cb on_error;
+        static bool trace_dump(const std::string& path)
+        {
+            const auto ret = bal_trace_dump(path.c_str());
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool get_peer_addr(address& peer_addr) const
+        {
+            peer_addr.clear();
+
+            bal_sockaddr addr {};
+            const auto ret = bal_get_peer_addr(_s, &addr);
+            if (ret) {
+                peer_addr = addr;
+            }
+
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool set_arena(size_t chunk_size = 0)
+        {
+            const auto ret = bal_set_arena(_s, chunk_size);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        void* arena_alloc(size_t size)
+        {
+            void* ret = bal_arena_alloc(_s, size);
+            return throw_on_policy<TPolicy>(ret, static_cast<void*>(nullptr));
+        }
+
+        bool arena_reset()
+        {
+            const auto ret = bal_arena_reset(_s);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        /** A std::pmr::memory_resource that allocates from this socket's arena. */
+        arena_resource get_arena_resource() const noexcept
+        {
+            return arena_resource {_s};
+        }
+
+        bool set_watermarks(size_t low, size_t high, bool pause_read = false)
+        {
+            const auto ret = bal_set_watermarks(_s, low, high, pause_read);
+            if (ret) {
+                if (0U != high) {
+                    bal_addtomask(_s, BAL_EVT_WRITE_HIGH | BAL_EVT_WRITE_LOW);
+                } else {
+                    bal_remfrommask(_s, BAL_EVT_WRITE_HIGH | BAL_EVT_WRITE_LOW);
+                }
+            }
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        size_t get_sendqueue_size() const
+        {
+            return bal_get_sendqueue_size(_s);
+        }
+
+        bool get_stats(bal_socket_stats& stats) const
+        {
+            const auto ret = bal_get_socket_stats(_s, &stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static bool get_library_stats(bal_stats& stats)
+        {
+            const auto ret = bal_get_stats(&stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static bool get_histogram(int which, bal_histogram& hist)
+        {
+            const auto ret = bal_get_histogram(which, &hist);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static bool set_callback_budget(std::chrono::nanoseconds budget, bal_slow_cb cb,
+            void* ctx = nullptr)
+        {
+            const auto nsec = static_cast<uint64_t>(std::max(budget.count(),
+                std::chrono::nanoseconds::rep {0}));
+            const auto ret  = bal_set_callback_budget(nsec, cb, ctx);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static bool get_lock_stats(std::vector<bal_lock_stats>& stats)
+        {
+            stats.clear();
+
+            /* sites are registered as they're first used, so the count may grow. */
+            auto ret = false;
+            for (size_t count = 0;;) {
+                stats.resize(count);
+                size_t have = count;
+                ret = bal_get_lock_stats(stats.data(), &have);
+                if (!ret || have <= count) {
+                    stats.resize(ret ? have : 0);
+                    break;
+                }
+                count = have;
+            }
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static bool reset_lock_stats()
+        {
+            const auto ret = bal_reset_lock_stats();
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        void want_write_events(bool want)
+        {
+            if (want) {
+                bal_addtomask(_s, BAL_EVT_WRITE);
+            } else {
+                bal_remfrommask(_s, BAL_EVT_WRITE);
+            }
+        }
+
+        static basic_socket* from_user_data(bal_socket* s)
+        {
+            return bit_cast<basic_socket*>(s->user_data);
+        }
+
+        uintptr_t to_user_data() const
+        {
+            return bit_cast<uintptr_t>(this);
+        }
+
+    protected:
+        basic_socket() = default;
+
+        basic_socket(basic_socket&& other) noexcept
+        {
+            [[maybe_unused]] const auto* unused = attach(other.detach());
+        }
+
+        ~basic_socket()
+        {
+            /* closing also takes the socket out of the async I/O list; the
+             * derived classes deregister it earlier, while their handlers are
+             * still intact. */
+            if constexpr(RAII) {
+                if (is_valid()) {
+                    [[maybe_unused]] auto unused = bal_close(&_s, true);
+                }
+            }
+        }
+
+        basic_socket& operator=(basic_socket&& rhs) noexcept
+        {
+            [[maybe_unused]] const auto* unused = attach(rhs.detach());
+            return *this;
+        }
+
+        bool _async_poll(bal_async_cb proc, uint32_t mask)
+        {
+            if (!is_valid()) {
+                return false;
+            }
+
+            const auto ret = bal_async_poll(_s, proc, mask);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static void _print_no_user_data(const bal_socket* s)
+        {
+            _bal_dbglog("no user_data for socket " BAL_SOCKET_SPEC " (0x%"
+                PRIxPTR ", mask = %08" PRIx32 ")", s->sd,
+                bit_cast<uintptr_t>(s), s->state.mask);
+# if !defined(BAL_DBGLOG)
+            BAL_UNUSED(s);
+# endif
+        }
+
+        static void _print_early_return(const bal_socket* s, const void* self, uint32_t evt)
+        {
+# if defined(BAL_DBGLOG)
+            _bal_dbglog("early return for socket " BAL_SOCKET_SPEC " (0x%"
+                PRIxPTR ", evt = %08" PRIx32 ", self = 0x%" PRIxPTR ")",
+                s->sd, bit_cast<uintptr_t>(s), evt, bit_cast<uintptr_t>(self));
+# else
+            BAL_UNUSED(s);
+            BAL_UNUSED(self);
+            BAL_UNUSED(evt);
+# endif
+        }
+
+    private:
+        bal_socket* _s = nullptr;
+    };
+
+    /** A socket whose event handlers are std::function members, assignable at
+     * run time. */
+    template<bool RAII, DerivedFromPolicy TPolicy>
+    class socket_base : public basic_socket<RAII, TPolicy>
+    {
+        using base = basic_socket<RAII, TPolicy>;
+
+    public:
+        using async_io_cb = std::function<bool(socket_base*)>;
+
+        socket_base()
+        {
+            set_default_event_handlers();
+        }
+
+        socket_base(const socket_base&) = delete;
+
+        socket_base(socket_base&& other) noexcept : socket_base()
+        {
+            *this = std::move(other);
+        }
+
+        socket_base(int addr_fam, int type, int proto) requires RAII : socket_base()
+        {
+            [[maybe_unused]]
+            auto unused = this->create(addr_fam, type, proto);
+        }
+
+        socket_base(int addr_fam, int proto, const std::string& host,
+            const std::string& srv) requires RAII : socket_base()
+        {
+            [[maybe_unused]]
+            auto unused = this->create(addr_fam, proto, host, srv);
+        }
+
+        virtual ~socket_base()
+        {
+            /* stop events before the handlers are destroyed; basic_socket only
+             * closes. */
+            if constexpr(RAII) {
+                [[maybe_unused]] auto unused = this->deregister_async_poll();
+            }
+        }
+
+        socket_base& operator=(socket_base&) = delete;
+
+        socket_base& operator=(socket_base&& rhs) noexcept
+        {
+            base::operator=(std::move(rhs));
+
+            on_read          = std::move(rhs.on_read);
+            on_write         = std::move(rhs.on_write);
+            on_connect       = std::move(rhs.on_connect);
+            on_conn_fail     = std::move(rhs.on_conn_fail);
+            on_incoming_conn = std::move(rhs.on_incoming_conn);
+            on_close         = std::move(rhs.on_close);
+            on_priority      = std::move(rhs.on_priority);
+            on_error         = std::move(rhs.on_error);
+            on_invalid       = std::move(rhs.on_invalid);
+            on_oob_read      = std::move(rhs.on_oob_read);
+            on_oob_write     = std::move(rhs.on_oob_write);
+            on_write_high    = std::move(rhs.on_write_high);
+            on_write_low     = std::move(rhs.on_write_low);
+            on_tx_time       = std::move(rhs.on_tx_time);
+
+            rhs.set_default_event_handlers();
+
+            return *this;
+        }
+
+        bool async_poll(uint32_t mask = BAL_EVT_NORMAL)
+        {
+            return this->_async_poll(&socket_base::_on_async_io, mask);
+        }
+
+        static socket_base* from_user_data(bal_socket* s)
+        {
+            return static_cast<socket_base*>(base::from_user_data(s));
+        }
+
+        /** Awaitable receive (see async_recv); yields an io_result. */
+        class recv_op final : public io_waiter
+        {
+        public:
+            recv_op(socket_base& sock, void* data, bal_iolen len, int flags) noexcept
+                : _sock(sock), _data(data), _len(len), _flags(flags) { }
+
+            bool await_ready() noexcept
+            {
+                return try_complete(0U);
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                handle = h;
+                return _sock._wait(_read_slot, this);
+            }
+
+            io_result await_resume() const
+            {
+                throw_on_policy<TPolicy>(_res.status, BAL_IO_ERROR);
+                return io_result {_res};
+            }
+
+            bool try_complete(uint32_t events) noexcept override
+            {
+                BAL_UNUSED(events);
+                _res = bal_try_recv(_sock.get(), _data, _len, _flags);
+                return BAL_IO_WOULDBLOCK != _res.status;
+            }
+
+        private:
+            socket_base& _sock;
+            void* _data;
+            bal_iolen _len;
+            int _flags;
+            bal_io_result _res {BAL_IO_WOULDBLOCK, 0U};
+        };
+
+        /** Awaitable send (see async_send); yields an io_result, which may be partial. */
+        class send_op final : public io_waiter
+        {
+        public:
+            send_op(socket_base& sock, const void* data, bal_iolen len, int flags) noexcept
+                : _sock(sock), _data(data), _len(len), _flags(flags) { }
+
+            bool await_ready() noexcept
+            {
+                return try_complete(0U);
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                handle      = h;
+                _want_write = !bal_bitsinmask(_sock.get(), BAL_EVT_WRITE);
+                if (_want_write) {
+                    _sock.want_write_events(true);
+                }
+                if (_sock._wait(_write_slot, this)) {
+                    return true;
+                }
+                if (_want_write) {
+                    _sock.want_write_events(false);
+                }
+                return false;
+            }
+
+            io_result await_resume() const
+            {
+                throw_on_policy<TPolicy>(_res.status, BAL_IO_ERROR);
+                return io_result {_res};
+            }
+
+            bool try_complete(uint32_t events) noexcept override
+            {
+                BAL_UNUSED(events);
+                _res = bal_try_send(_sock.get(), _data, _len, _flags);
+                if (BAL_IO_WOULDBLOCK == _res.status) {
+                    return false;
+                }
+                if (_want_write) {
+                    bal_remfrommask(_sock.get(), BAL_EVT_WRITE);
+                }
+                return true;
+            }
+
+        private:
+            socket_base& _sock;
+            const void* _data;
+            bal_iolen _len;
+            int _flags;
+            bool _want_write = false;
+            bal_io_result _res {BAL_IO_WOULDBLOCK, 0U};
+        };
+
+        /** Awaitable accept (see async_accept); yields true once a connection is
+         * accepted into the client socket. */
+        class accept_op final : public io_waiter
+        {
+        public:
+            accept_op(socket_base& sock, base& client, address& client_addr) noexcept
+                : _sock(sock), _client(client), _client_addr(client_addr) { }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                handle = h;
+                return _sock._wait(_read_slot, this);
+            }
+
+            bool await_resume()
+            {
+                _client_addr.clear();
+                if (_accepted != nullptr) {
+                    [[maybe_unused]] const auto* existing = _client.attach(_accepted);
+                    BAL_ASSERT(existing == nullptr);
+                    _client_addr = _addr;
+                }
+                return throw_on_policy<TPolicy>(_accepted != nullptr, false);
+            }
+
+            bool try_complete(uint32_t events) noexcept override
+            {
+                if (0U == (events & (BAL_EVT_ACCEPT | _fail_events))) {
+                    return false;
+                }
+                if (!bal_accept(_sock.get(), &_accepted, &_addr)) {
+                    _accepted = nullptr;
+                }
+                return true;
+            }
+
+        private:
+            socket_base& _sock;
+            base& _client;
+            address& _client_addr;
+            bal_socket* _accepted = nullptr;
+            bal_sockaddr _addr {};
+        };
+
+        /** Awaitable connect (see async_connect); yields true once connected. */
+        class connect_op final : public io_waiter
+        {
+        public:
+            connect_op(socket_base& sock, std::string host, std::string port)
+                : _sock(sock), _host(std::move(host)), _port(std::move(port)) { }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                handle = h;
+                if (!_sock._wait(_write_slot, this)) {
+                    return false;
+                }
+                /* resolution and the attempt both complete on the event thread, so
+                 * once submitted, this may be resumed at any moment. */
+                if (bal_connect_async(_sock.get(), _host.c_str(), _port.c_str())) {
+                    return true;
+                }
+                _sock._unwait(_write_slot, this);
+                _failed = true;
+                return false;
+            }
+
+            bool await_resume() const
+            {
+                if (_failed) {
+                    return throw_on_policy<TPolicy>(false, false);
+                }
+                return _connected;
+            }
+
+            bool try_complete(uint32_t events) noexcept override
+            {
+                if (0U == (events & (BAL_EVT_CONNECT | BAL_EVT_CONNFAIL))) {
+                    return false;
+                }
+                _connected = bal_isbitset(events, BAL_EVT_CONNECT);
+                return true;
+            }
+
+        private:
+            socket_base& _sock;
+            std::string _host;
+            std::string _port;
+            bool _connected = false;
+            bool _failed    = false;
+        };
+
+        /** co_await receives into `data` from the event thread once the socket is
+         * readable. The socket must be registered with async_poll; one receive (or
+         * accept) and one send (or connect) may be awaited at a time, and not while
+         * the socket is being moved. Call from a coroutine returning bal::task. */
+        recv_op async_recv(void* data, bal_iolen len, int flags = 0)
+        {
+            return {*this, data, len, flags};
+        }
+
+        recv_op async_recv(std::span<std::byte> data, int flags = 0)
+        {
+            return async_recv(data.data(), to_iolen(data.size()), flags);
+        }
+
+        /** co_await sends from `data` once the socket is writable (see async_recv). */
+        send_op async_send(const void* data, bal_iolen len, int flags = MSG_NOSIGNAL)
+        {
+            return {*this, data, len, flags};
+        }
+
+        send_op async_send(std::span<const std::byte> data, int flags = MSG_NOSIGNAL)
+        {
+            return async_send(data.data(), to_iolen(data.size()), flags);
+        }
+
+        /** co_await accepts a connection into `client` (see async_recv). */
+        accept_op async_accept(base& client, address& client_addr)
+        {
+            return {*this, client, client_addr};
+        }
+
+        /** co_await connects to host:port without blocking (see bal_connect_async);
+         * false if resolution or the attempt fails (see async_recv). */
+        connect_op async_connect(const std::string& host, const std::string& port)
+        {
+            return {*this, host, port};
+        }
+
+        async_io_cb on_read;
+        async_io_cb on_write;
+        async_io_cb on_connect;
+        async_io_cb on_conn_fail;
+        async_io_cb on_incoming_conn;
+        async_io_cb on_close;
+        async_io_cb on_priority;
+        async_io_cb on_error;
         async_io_cb on_invalid;
         async_io_cb on_oob_read;
         async_io_cb on_oob_write;
+        async_io_cb on_write_high;
+        async_io_cb on_write_low;
+        async_io_cb on_tx_time;
+
+        void set_default_event_handlers()
+        {
+            on_read = nullptr;
+            on_write = nullptr;
+            on_connect = nullptr;
+            on_conn_fail = nullptr;
+            on_incoming_conn = nullptr;
+            on_close = [](socket_base* sock)
+            {
+                [[maybe_unused]] const auto closed = sock->close();
+                return false;
+            };
+            on_priority = nullptr;
+            on_error = [](socket_base* sock)
+            {
+                [[maybe_unused]] const auto closed = sock->close();
+                return false;
+            };
+            on_invalid = nullptr;
+            on_oob_read = nullptr;
+            on_oob_write = nullptr;
+            on_write_high = nullptr;
+            on_write_low = nullptr;
+            on_tx_time = nullptr;
+        }
+
+    protected:
+        static void _on_async_io(bal_socket* s, uint32_t events)
+        {
+            /* awaiting coroutines are resumed last, since they may destroy the socket. */
+            std::coroutine_handle<> ready[_slots];
+
+            try {
+                socket_base* self = from_user_data(s);
+                BAL_ASSERT(self != nullptr);
+
+                if (self == nullptr) {
+                    base::_print_no_user_data(s);
+                    return;
+                }
+
+                events = self->_complete_waiters(events, ready);
+                _dispatch_handlers(self, s, events);
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+
+            for (auto& handle : ready) {
+                if (handle) {
+                    handle.resume();
+                }
+            }
+        }
+
+        static void _dispatch_handlers(socket_base* self, bal_socket* s, uint32_t events)
+        {
+            if (bal_isbitset(events, BAL_EVT_READ) && self->on_read &&
+                !self->on_read(self)) {
+                base::_print_early_return(s, self, BAL_EVT_READ);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WRITE) && self->on_write &&
+                !self->on_write(self)) {
+                base::_print_early_return(s, self, BAL_EVT_WRITE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CONNECT) && self->on_connect &&
+                !self->on_connect(self)) {
+                base::_print_early_return(s, self, BAL_EVT_CONNECT);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CONNFAIL) && self->on_conn_fail &&
+                !self->on_conn_fail(self)) {
+                base::_print_early_return(s, self, BAL_EVT_CONNFAIL);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_ACCEPT) && self->on_incoming_conn &&
+                !self->on_incoming_conn(self)) {
+                base::_print_early_return(s, self, BAL_EVT_ACCEPT);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CLOSE) && self->on_close &&
+                !self->on_close(self)) {
+                base::_print_early_return(s, self, BAL_EVT_CLOSE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_PRIORITY) && self->on_priority &&
+                !self->on_priority(self)) {
+                base::_print_early_return(s, self, BAL_EVT_PRIORITY);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_ERROR) && self->on_error &&
+                !self->on_error(self)) {
+                base::_print_early_return(s, self, BAL_EVT_ERROR);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_INVALID) && self->on_invalid &&
+                !self->on_invalid(self)) {
+                base::_print_early_return(s, self, BAL_EVT_INVALID);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_OOBREAD) && self->on_oob_read &&
+                !self->on_oob_read(self)) {
+                base::_print_early_return(s, self, BAL_EVT_OOBREAD);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_OOBWRITE) && self->on_oob_write &&
+                !self->on_oob_write(self)) {
+                base::_print_early_return(s, self, BAL_EVT_OOBWRITE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WRITE_HIGH) && self->on_write_high &&
+                !self->on_write_high(self)) {
+                base::_print_early_return(s, self, BAL_EVT_WRITE_HIGH);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WRITE_LOW) && self->on_write_low &&
+                !self->on_write_low(self)) {
+                base::_print_early_return(s, self, BAL_EVT_WRITE_LOW);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_TXTIME) && self->on_tx_time &&
+                !self->on_tx_time(self)) {
+                base::_print_early_return(s, self, BAL_EVT_TXTIME);
+                return;
+            }
+        }
+
+    private:
+        static constexpr size_t _read_slot  = 0;
+        static constexpr size_t _write_slot = 1;
+        static constexpr size_t _slots      = 2;
+
+        /** Events that complete an awaited operation in each slot, and those that
+         * may complete any of them. */
+        static constexpr uint32_t _slot_events[_slots] = {
+            BAL_EVT_READ | BAL_EVT_ACCEPT,
+            BAL_EVT_WRITE | BAL_EVT_CONNECT | BAL_EVT_CONNFAIL
+        };
+        static constexpr uint32_t _fail_events = BAL_EVT_CLOSE | BAL_EVT_ERROR | BAL_EVT_INVALID;
+
+        bool _wait(size_t slot, io_waiter* waiter) noexcept
+        {
+            io_waiter* expected = nullptr;
+            const auto ok = _waiters[slot].compare_exchange_strong(expected, waiter,
+                std::memory_order_release, std::memory_order_relaxed);
+            BAL_ASSERT(ok);
+            return ok;
+        }
+
+        void _unwait(size_t slot, io_waiter* waiter) noexcept
+        {
+            [[maybe_unused]] const auto unused =
+                _waiters[slot].compare_exchange_strong(waiter, nullptr);
+        }
+
+        /** Completes awaited operations; returns the events left for the handlers. */
+        uint32_t _complete_waiters(uint32_t events, std::coroutine_handle<> (&ready)[_slots])
+        {
+            for (size_t n = 0; n < _slots; n++) {
+                if (0U == (events & (_slot_events[n] | _fail_events))) {
+                    continue;
+                }
+                auto* waiter = _waiters[n].load(std::memory_order_acquire);
+                if (waiter != nullptr && waiter->try_complete(events)) {
+                    _waiters[n].store(nullptr, std::memory_order_relaxed);
+                    ready[n] = waiter->handle;
+                    bal_setbitslow(&events, _slot_events[n]);
+                }
+            }
+            return events;
+        }
+
+        std::atomic<io_waiter*> _waiters[_slots] {};
+    };
+
+    template<class THandler>
+    class handler;
+
+    /** A socket whose event handlers are member functions of THandler, which derives
+     * from it (`class conn : public bal::socket<conn>`). Any of on_read, on_write, ...
+     * on_tx_time may be defined, each taking no arguments and returning false to
+     * skip the rest of the events; they are resolved at compile time, and only the
+     * socket itself is stored. As with socket_base, on_close and on_error default to
+     * closing the socket. Only a bal::handler<THandler> can be registered for
+     * events (see below). */
+    template<class THandler, bool RAII = true, DerivedFromPolicy TPolicy = default_policy>
+    class socket : public basic_socket<RAII, TPolicy>
+    {
+        using base = basic_socket<RAII, TPolicy>;
+        friend class handler<THandler>;
+
+    public:
+        socket() = default;
+        socket(const socket&) = delete;
+        socket(socket&&) noexcept = default;
+
+        socket(int addr_fam, int type, int proto) requires RAII
+        {
+            [[maybe_unused]]
+            auto unused = this->create(addr_fam, type, proto);
+        }
+
+        socket(int addr_fam, int proto, const std::string& host,
+            const std::string& srv) requires RAII
+        {
+            [[maybe_unused]]
+            auto unused = this->create(addr_fam, proto, host, srv);
+        }
+
+        socket& operator=(const socket&) = delete;
+        socket& operator=(socket&&) noexcept = default;
+
+        static THandler* from_user_data(bal_socket* s)
+        {
+            return static_cast<THandler*>(static_cast<socket*>(base::from_user_data(s)));
+        }
+
+    protected:
+        ~socket() = default;
+
+    private:
+        bool _poll(uint32_t mask)
+        {
+            return this->_async_poll(&socket::_on_async_io, mask);
+        }
+
+        static void _on_async_io(bal_socket* s, uint32_t events)
+        {
+            try {
+                THandler* self = from_user_data(s);
+                BAL_ASSERT(self != nullptr);
+
+                if (self == nullptr) {
+                    base::_print_no_user_data(s);
+                    return;
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_read() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_READ) && !self->on_read()) {
+                        base::_print_early_return(s, self, BAL_EVT_READ);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_write() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_WRITE) && !self->on_write()) {
+                        base::_print_early_return(s, self, BAL_EVT_WRITE);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_connect() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_CONNECT) && !self->on_connect()) {
+                        base::_print_early_return(s, self, BAL_EVT_CONNECT);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_conn_fail() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_CONNFAIL) && !self->on_conn_fail()) {
+                        base::_print_early_return(s, self, BAL_EVT_CONNFAIL);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_incoming_conn() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_ACCEPT) && !self->on_incoming_conn()) {
+                        base::_print_early_return(s, self, BAL_EVT_ACCEPT);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_close() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_CLOSE) && !self->on_close()) {
+                        base::_print_early_return(s, self, BAL_EVT_CLOSE);
+                        return;
+                    }
+                } else if (bal_isbitset(events, BAL_EVT_CLOSE)) {
+                    [[maybe_unused]] const auto closed = self->close();
+                    return;
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_priority() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_PRIORITY) && !self->on_priority()) {
+                        base::_print_early_return(s, self, BAL_EVT_PRIORITY);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_error() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_ERROR) && !self->on_error()) {
+                        base::_print_early_return(s, self, BAL_EVT_ERROR);
+                        return;
+                    }
+                } else if (bal_isbitset(events, BAL_EVT_ERROR)) {
+                    [[maybe_unused]] const auto closed = self->close();
+                    return;
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_invalid() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_INVALID) && !self->on_invalid()) {
+                        base::_print_early_return(s, self, BAL_EVT_INVALID);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_oob_read() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_OOBREAD) && !self->on_oob_read()) {
+                        base::_print_early_return(s, self, BAL_EVT_OOBREAD);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_oob_write() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_OOBWRITE) && !self->on_oob_write()) {
+                        base::_print_early_return(s, self, BAL_EVT_OOBWRITE);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_write_high() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_WRITE_HIGH) && !self->on_write_high()) {
+                        base::_print_early_return(s, self, BAL_EVT_WRITE_HIGH);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_write_low() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_WRITE_LOW) && !self->on_write_low()) {
+                        base::_print_early_return(s, self, BAL_EVT_WRITE_LOW);
+                        return;
+                    }
+                }
+
+                if constexpr(requires(THandler& h) { { h.on_tx_time() } -> std::convertible_to<bool>; }) {
+                    if (bal_isbitset(events, BAL_EVT_TXTIME) && !self->on_tx_time()) {
+                        base::_print_early_return(s, self, BAL_EVT_TXTIME);
+                        return;
+                    }
+                }
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+        }
+    };
+
+    /** The type to instantiate for a bal::socket handler (`bal::handler<conn> c;`).
+     * Being the most derived class, it deregisters the socket before any part
+     * of THandler is destroyed: a dispatch in progress is waited for, and none
+     * follow, so events never reach a partially destroyed handler. */
+    template<class THandler>
+    class handler final : public THandler
+    {
+    public:
+        using THandler::THandler;
+
+        ~handler()
+        {
+            [[maybe_unused]] const auto unused = this->deregister_async_poll();
+        }
+
+        bool async_poll(uint32_t mask = BAL_EVT_NORMAL)
+        {
+            return this->_poll(mask);
+        }
+    };
+
+    using scoped_socket = socket_base<true, default_policy>;
+    using manual_socket = socket_base<false, default_policy>;
+
+    /** Keeps connections to the destinations it is asked for open between uses
+     * (see bal_pool_create). Connections are attached to, and checked back in
+     * from, any of the socket types above. */
+    template<DerivedFromPolicy TPolicy = default_policy>
+    class connection_pool
+    {
+    public:
+        /** Receives the connection, or nullptr if none could be opened. */
+        using checkout_handler = std::function<void(bal_socket*)>;
+
+        explicit connection_pool(const bal_pool_cfg* cfg = nullptr)
+        {
+            const auto ret = bal_pool_create(&_p, cfg);
+            throw_on_policy<TPolicy>(ret, false);
+        }
+
+        connection_pool(const connection_pool&) = delete;
+        connection_pool(connection_pool&&) = delete;
+
+        ~connection_pool()
+        {
+            if (_p != nullptr) {
+                [[maybe_unused]] auto destroyed = bal_pool_destroy(&_p);
+            }
+        }
+
+        connection_pool& operator=(const connection_pool&) = delete;
+        connection_pool& operator=(connection_pool&&) = delete;
+
+        bal_pool* get() const noexcept
+        {
+            return _p;
+        }
+
+        template<bool RAII, DerivedFromPolicy TSockPolicy>
+        bool checkout(const std::string& host, const std::string& port,
+            basic_socket<RAII, TSockPolicy>& out)
+        {
+            bal_socket* s  = nullptr;
+            const auto ret = bal_pool_checkout(_p, host.c_str(), port.c_str(), &s);
+            if (ret) {
+                [[maybe_unused]] const auto* existing = out.attach(s);
+                BAL_ASSERT(existing == nullptr);
+            }
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        /** The handler runs on the event thread. */
+        bool checkout_async(const std::string& host, const std::string& port,
+            checkout_handler handler)
+        {
+            auto ctx       = std::make_unique<checkout_handler>(std::move(handler));
+            const auto ret = bal_pool_checkout_async(_p, host.c_str(), port.c_str(),
+                &_on_checkout, ctx.get());
+            if (ret) {
+                [[maybe_unused]] const auto* owned = ctx.release();
+            }
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        template<bool RAII, DerivedFromPolicy TSockPolicy>
+        static bool checkin(basic_socket<RAII, TSockPolicy>& sock, bool reuse = true)
+        {
+            bal_socket* s  = sock.detach();
+            const auto ret = bal_pool_checkin(&s, reuse);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        bool get_stats(bal_pool_stats& stats) const
+        {
+            const auto ret = bal_pool_get_stats(_p, &stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+    private:
+        static void _on_checkout(bal_socket* s, void* ctx)
+        {
+            std::unique_ptr<checkout_handler> handler(static_cast<checkout_handler*>(ctx));
+            try {
+                (*handler)(s);
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+        }
+
+        bal_pool* _p = nullptr;
+    };
+
+    /** Settings for server; zero workers means one per hardware thread. */
+    struct server_config
+    {
+        size_t workers = 0U;
+        size_t read_size = 16384U;
+        int backlog = SOMAXCONN;
+        int addr_fam = AF_INET;
+        std::chrono::milliseconds drain_timeout {5000};
+        /** Bytes a connection may have queued but not yet sent; beyond it,
+         * connection::send refuses more until the queue drains. */
+        size_t send_queue_limit = 4U * 1024U * 1024U;
+    };
+
+    /** Identifies a connection; an id is never reused while the server runs. */
+    using connection_id = uint64_t;
+
+    /** A TCP server built from an acceptor, the event thread and a set of
+     * worker threads. The event thread accepts, reads and writes; THandler's
+     * callbacks run on the workers. Every connection is pinned to one worker,
+     * so the callbacks for a connection never run concurrently and arrive in
+     * order. A default-constructed THandler is kept per connection, and may
+     * define any of:
+     *
+     *   void on_connect(connection& c);
+     *   void on_data(connection& c, std::span<const std::byte> data);
+     *   void on_disconnect(connection& c);
+     *   void on_drain(connection& c);
+     *
+     * The parameters may be declared auto&. on_drain follows a send that was
+     * refused because the connection had send_queue_limit bytes queued, once
+     * they have all been sent. stop (and the destructor) stops
+     * accepting, lets the workers finish what has already been read, then
+     * waits up to drain_timeout for queued writes to be sent before dropping
+     * whatever is left. */
+    template<class THandler, DerivedFromPolicy TPolicy = default_policy>
+    class server
+    {
+        struct _key
+        {
+            explicit _key() = default;
+        };
+
+    public:
+        class connection : private bal::socket<connection, true, TPolicy>,
+            public std::enable_shared_from_this<connection>
+        {
+            using base = bal::socket<connection, true, TPolicy>;
+            friend base;
+            friend class handler<connection>;
+            friend class server;
+
+        public:
+            connection(server& srv, _key) : _srv(srv) { }
+
+            connection_id get_id() const noexcept
+            {
+                return _id;
+            }
+
+            const address& get_peer() const noexcept
+            {
+                return _peer;
+            }
 
-        void set_default_event_handlers()
-        {
-            on_read = nullptr;
-            on_write = nullptr;
-            on_connect = nullptr;
-            on_conn_fail = nullptr;
-            on_incoming_conn = nullptr;
-            on_close = [](socket_base* sock)
+            THandler& get_handler() noexcept
             {
-                [[maybe_unused]] const auto closed = sock->close();
-                return false;
-            };
-            on_priority = nullptr;
-            on_error = [](socket_base* sock)
+                return _handler;
+            }
+
+            /** Queues data to be sent; may be called from any thread. Returns
+             * false once the connection is closing, or if the data would take it
+             * past send_queue_limit (see on_drain). */
+            bool send(std::span<const std::byte> data)
             {
-                [[maybe_unused]] const auto closed = sock->close();
-                return false;
-            };
-            on_invalid = nullptr;
-            on_oob_read = nullptr;
-            on_oob_write = nullptr;
+                {
+                    std::lock_guard lock(_mtx);
+                    if (_closed || _closing) {
+                        return false;
+                    }
+
+                    if (_out.size() - _sent + data.size() > _srv._cfg.send_queue_limit) {
+                        _refused = true;
+                        return false;
+                    }
+
+                    _out.insert(_out.end(), data.begin(), data.end());
+                    if (_queued) {
+                        return true;
+                    }
+                    _queued = true;
+                }
+
+                _srv._queue_flush(this->shared_from_this());
+                return true;
+            }
+
+            bool send(std::string_view data)
+            {
+                return send(std::as_bytes(std::span {data}));
+            }
+
+            /** The number of bytes queued but not yet sent. */
+            size_t get_queued()
+            {
+                std::lock_guard lock(_mtx);
+                return _out.size() - _sent;
+            }
+
+            /** Closes the connection once everything queued has been sent. */
+            void close()
+            {
+                {
+                    std::lock_guard lock(_mtx);
+                    if (_closed || _closing) {
+                        return;
+                    }
+
+                    _closing = true;
+                    if (_queued) {
+                        return;
+                    }
+                    _queued = true;
+                }
+
+                _srv._queue_flush(this->shared_from_this());
+            }
+
+        private:
+            void _abort()
+            {
+                {
+                    std::lock_guard lock(_mtx);
+                    if (_closed) {
+                        return;
+                    }
+
+                    _aborted = true;
+                    if (_queued) {
+                        return;
+                    }
+                    _queued = true;
+                }
+
+                _srv._queue_flush(this->shared_from_this());
+            }
+
+            /* _closed is only written on the event thread, so the handlers
+             * below may read it without the lock. */
+            bool on_read()
+            {
+                if (!_closed) {
+                    _srv._read(*this);
+                }
+                return true;
+            }
+
+            bool on_write()
+            {
+                if (!_closed) {
+                    _srv._flush(*this);
+                }
+                return true;
+            }
+
+            bool on_close()
+            {
+                _srv._close_now(*this);
+                return true;
+            }
+
+            bool on_error()
+            {
+                _srv._close_now(*this);
+                return true;
+            }
+
+            bool on_invalid()
+            {
+                _srv._close_now(*this);
+                return true;
+            }
+
+            server& _srv;
+            THandler _handler {};
+            address _peer;
+            connection_id _id = 0U;
+            size_t _worker = 0U;
+            std::mutex _mtx;
+            std::vector<std::byte> _out;
+            size_t _sent = 0U;
+            bool _queued = false;
+            bool _refused = false;
+            bool _closing = false;
+            bool _aborted = false;
+            bool _closed = false;
+        };
+
+        explicit server(const server_config& cfg = {}) : _cfg(cfg)
+        {
+            if (_cfg.workers == 0U) {
+                _cfg.workers = std::max(1U, std::thread::hardware_concurrency());
+            }
+
+            _cfg.read_size = std::max(_cfg.read_size, size_t {1});
+            _scratch.resize(_cfg.read_size);
         }
 
-    protected:
-        static void _on_async_io(bal_socket* s, uint32_t events)
+        server(const server&) = delete;
+        server(server&&) = delete;
+
+        ~server()
+        {
+            [[maybe_unused]] const auto stopped = stop();
+        }
+
+        server& operator=(const server&) = delete;
+        server& operator=(server&&) = delete;
+
+        /** Binds to addr:port and starts accepting connections. */
+        bool start(const std::string& addr, const std::string& port)
         {
+            if (_running) {
+                return true;
+            }
+
+            bool ret = false;
             try {
-                socket_base* self = from_user_data(s);
-                BAL_ASSERT(self != nullptr);
+                ret = _bell.create(AF_INET, SOCK_DGRAM, IPPROTO_UDP) &&
+                      _bell.bind("127.0.0.1", "0") &&
+                      bal_get_localhost_addr(_bell.get(), &_bell_addr) &&
+                      _bell.async_poll(BAL_EVT_READ) &&
+                      _acceptor.create(_cfg.addr_fam, SOCK_STREAM, IPPROTO_TCP) &&
+                      _acceptor.set_reuseaddr(1) &&
+                      _acceptor.bind(addr, port) &&
+                      _acceptor.listen(_cfg.backlog);
+            } catch (...) {
+                _close_socket(_acceptor);
+                _close_socket(_bell);
+                throw;
+            }
 
-                if (self == nullptr) {
-                    _bal_dbglog("no user_data for socket " BAL_SOCKET_SPEC " (0x%"
-                        PRIxPTR ", mask = %08" PRIx32 ")", s->sd,
-                        bit_cast<uintptr_t>(s), s->state.mask);
-                    return;
+            if (ret) {
+                for (size_t n = 0U; n < _cfg.workers; n++) {
+                    auto& w = _workers.emplace_back(std::make_unique<worker>());
+                    w->thread = std::thread(&server::_run, this, std::ref(*w));
                 }
 
-                auto print_early_return = [s, self](uint32_t evt)
-                {
-# if defined(BAL_DBGLOG)
-                    _bal_dbglog("early return for socket " BAL_SOCKET_SPEC " (0x%"
-                        PRIxPTR ", evt = %08" PRIx32 ", self = 0x%" PRIxPTR ")",
-                        s->sd, bit_cast<uintptr_t>(s), evt, bit_cast<uintptr_t>(self));
-# else
-                    BAL_UNUSED(s);
-                    BAL_UNUSED(self);
-                    BAL_UNUSED(evt);
-# endif
-                };
+                _running = true;
+                ret = _acceptor.async_poll(BAL_EVT_NORMAL);
+                if (!ret) {
+                    [[maybe_unused]] const auto stopped = stop();
+                }
+            } else {
+                _close_socket(_acceptor);
+                _close_socket(_bell);
+            }
 
-                if (bal_isbitset(events, BAL_EVT_READ) && self->on_read &&
-                    !self->on_read(self)) {
-                    print_early_return(BAL_EVT_READ);
-                    return;
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        /** Stops accepting, drains the connections and joins the workers. */
+        bool stop()
+        {
+            if (!_running.exchange(false)) {
+                return true;
+            }
+
+            /* deregistering waits for an accept in progress to finish. */
+            _close_socket(_acceptor);
+
+            /* the close is queued behind whatever the worker has yet to
+             * handle, so responses to data already read still go out. */
+            for (auto& conn : _get_connections()) {
+                const auto w = conn->_worker;
+                _post(w, task {std::move(conn), task_kind::close, {}});
+            }
+
+            if (!_wait_drained(_cfg.drain_timeout)) {
+                for (auto& conn : _get_connections()) {
+                    conn->_abort();
                 }
+                [[maybe_unused]] const auto drained = _wait_drained(std::nullopt);
+            }
 
-                if (bal_isbitset(events, BAL_EVT_WRITE) && self->on_write &&
-                    !self->on_write(self)) {
-                    print_early_return(BAL_EVT_WRITE);
-                    return;
+            for (auto& w : _workers) {
+                {
+                    std::lock_guard lock(w->mtx);
+                    w->stop = true;
                 }
+                w->cv.notify_one();
+                w->thread.join();
+            }
+            _workers.clear();
 
-                if (bal_isbitset(events, BAL_EVT_CONNECT) && self->on_connect &&
-                    !self->on_connect(self)) {
-                    print_early_return(BAL_EVT_CONNECT);
-                    return;
+            /* not under _flush_mtx: deregistering waits for the event thread,
+             * which takes it in _answer. */
+            _close_socket(_bell);
+
+            std::lock_guard lock(_flush_mtx);
+            _flushq.clear();
+            _retired.clear();
+            _rung = false;
+
+            return true;
+        }
+
+        bool is_running() const noexcept
+        {
+            return _running;
+        }
+
+        /** Queues data for the connection with the given id, if it is open. */
+        bool send(connection_id id, std::span<const std::byte> data)
+        {
+            auto conn = _find(id);
+            return conn && conn->send(data);
+        }
+
+        bool close(connection_id id)
+        {
+            auto conn = _find(id);
+            if (conn) {
+                conn->close();
+            }
+            return conn != nullptr;
+        }
+
+        size_t get_connection_count() const
+        {
+            std::lock_guard lock(_table_mtx);
+            return _count;
+        }
+
+        /** The listening socket, e.g. to learn the port bound to "0". */
+        bal_socket* get_listener() const noexcept
+        {
+            return _acceptor.get();
+        }
+
+    private:
+        class acceptor : public bal::socket<acceptor, true, TPolicy>
+        {
+        public:
+            explicit acceptor(server& srv) : _srv(srv) { }
+
+            bool on_incoming_conn()
+            {
+                _srv._accept();
+                return true;
+            }
+
+        private:
+            server& _srv;
+        };
+
+        /* the workers' way of waking the event thread: a datagram to itself. */
+        class doorbell : public bal::socket<doorbell, true, TPolicy>
+        {
+        public:
+            explicit doorbell(server& srv) : _srv(srv) { }
+
+            bool on_read()
+            {
+                _srv._answer();
+                return true;
+            }
+
+        private:
+            server& _srv;
+        };
+
+        enum class task_kind
+        {
+            connect,
+            data,
+            close,
+            drain,
+            disconnect
+        };
+
+        struct task
+        {
+            std::shared_ptr<connection> conn;
+            task_kind kind;
+            std::pmr::vector<std::byte> data;
+        };
+
+        struct worker
+        {
+            std::mutex mtx;
+            std::condition_variable cv;
+            std::deque<task> q;
+            bool stop = false;
+            std::thread thread;
+        };
+
+        struct slot
+        {
+            std::shared_ptr<connection> conn;
+            uint32_t gen = 0U;
+        };
+
+        template<class T>
+        static void _close_socket(T& sock)
+        {
+            if (sock.is_valid()) {
+                [[maybe_unused]] const auto unused = bal_async_poll(sock.get(), nullptr, 0U);
+                bal_socket* s = sock.detach();
+                [[maybe_unused]] const auto closed = bal_close(&s, true);
+            }
+        }
+
+        /* event thread. */
+        void _accept()
+        {
+            bal_socket* s = nullptr;
+            bal_sockaddr sa {};
+            if (!bal_accept(_acceptor.get(), &s, &sa)) {
+                return;
+            }
+
+            auto conn = std::allocate_shared<handler<connection>>(
+                std::pmr::polymorphic_allocator<handler<connection>>(&_pool), *this, _key {});
+            [[maybe_unused]] const auto* existing = conn->attach(s);
+            conn->_peer = sa;
+
+            {
+                std::lock_guard lock(_table_mtx);
+                uint32_t index = 0U;
+                if (!_free.empty()) {
+                    index = _free.back();
+                    _free.pop_back();
+                } else {
+                    index = static_cast<uint32_t>(_slots.size());
+                    _slots.emplace_back();
                 }
 
-                if (bal_isbitset(events, BAL_EVT_CONNFAIL) && self->on_conn_fail &&
-                    !self->on_conn_fail(self)) {
-                    print_early_return(BAL_EVT_CONNFAIL);
-                    return;
+                auto& sl     = _slots[index];
+                sl.conn      = conn;
+                conn->_id     = (static_cast<connection_id>(sl.gen) << 32U) | index;
+                conn->_worker = index % _workers.size();
+                _count++;
+                _live++;
+            }
+
+            _post(conn->_worker, task {conn, task_kind::connect, {}});
+
+            bool polling = false;
+            try {
+                polling = conn->async_poll(BAL_EVT_READ | BAL_EVT_CLOSE | BAL_EVT_ERROR |
+                    BAL_EVT_INVALID);
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+
+            if (!polling) {
+                _close_now(*conn);
+            }
+        }
+
+        /* event thread. */
+        void _read(connection& conn)
+        {
+            const auto ret = bal_try_recv(conn.get(), _scratch.data(),
+                to_iolen(_scratch.size()), 0);
+            if (BAL_IO_OK == ret.status) {
+                if (ret.bytes > 0U) {
+                    std::pmr::vector<std::byte> data(_scratch.data(),
+                        _scratch.data() + ret.bytes, &_pool);
+                    _post(conn._worker, task {conn.shared_from_this(), task_kind::data,
+                        std::move(data)});
                 }
+            } else if (BAL_IO_WOULDBLOCK != ret.status) {
+                _close_now(conn);
+            }
+        }
 
-                if (bal_isbitset(events, BAL_EVT_ACCEPT) && self->on_incoming_conn &&
-                    !self->on_incoming_conn(self)) {
-                    print_early_return(BAL_EVT_ACCEPT);
+        /* event thread. */
+        void _flush(connection& conn)
+        {
+            bool done    = false;
+            bool drained = false;
+            {
+                std::lock_guard lock(conn._mtx);
+                conn._queued = false;
+                if (conn._closed) {
                     return;
                 }
 
-                if (bal_isbitset(events, BAL_EVT_CLOSE) && self->on_close &&
-                    !self->on_close(self)) {
-                    print_early_return(BAL_EVT_CLOSE);
-                    return;
+                bool blocked = false;
+                while (!conn._aborted && conn._sent < conn._out.size()) {
+                    const auto ret = bal_try_send(conn.get(), conn._out.data() + conn._sent,
+                        to_iolen(conn._out.size() - conn._sent), MSG_NOSIGNAL);
+                    if (BAL_IO_OK == ret.status || BAL_IO_PARTIAL == ret.status) {
+                        conn._sent += ret.bytes;
+                    } else if (BAL_IO_WOULDBLOCK == ret.status) {
+                        blocked = true;
+                        break;
+                    } else {
+                        conn._aborted = true;
+                    }
                 }
 
-                if (bal_isbitset(events, BAL_EVT_PRIORITY) && self->on_priority &&
-                    !self->on_priority(self)) {
-                    print_early_return(BAL_EVT_PRIORITY);
-                    return;
+                if (!blocked) {
+                    conn._out.clear();
+                    conn._sent = 0U;
+                } else if (conn._sent > 0U) {
+                    /* what has been sent doesn't count against the limit, so
+                     * it mustn't stay in memory either. */
+                    conn._out.erase(conn._out.begin(),
+                        conn._out.begin() + static_cast<std::ptrdiff_t>(conn._sent));
+                    conn._sent = 0U;
                 }
 
-                if (bal_isbitset(events, BAL_EVT_ERROR) && self->on_error &&
-                    !self->on_error(self)) {
-                    print_early_return(BAL_EVT_ERROR);
-                    return;
+                if (blocked && !conn._aborted) {
+                    bal_addtomask(conn.get(), BAL_EVT_WRITE);
+                } else {
+                    bal_remfrommask(conn.get(), BAL_EVT_WRITE);
                 }
 
-                if (bal_isbitset(events, BAL_EVT_INVALID) && self->on_invalid &&
-                    !self->on_invalid(self)) {
-                    print_early_return(BAL_EVT_INVALID);
-                    return;
+                done    = conn._aborted || (conn._closing && !blocked);
+                drained = !done && !blocked && conn._refused;
+                if (drained) {
+                    conn._refused = false;
                 }
+            }
 
-                if (bal_isbitset(events, BAL_EVT_OOBREAD) && self->on_oob_read &&
-                    !self->on_oob_read(self)) {
-                    print_early_return(BAL_EVT_OOBREAD);
+            if (done) {
+                _close_now(conn);
+            } else if (drained) {
+                _post(conn._worker, task {conn.shared_from_this(), task_kind::drain, {}});
+            }
+        }
+
+        /* event thread. the connection is only retired here; the disconnect
+         * task is posted from the doorbell, once the event that got us here
+         * is no longer being dispatched to it. */
+        void _close_now(connection& conn)
+        {
+            {
+                std::lock_guard lock(conn._mtx);
+                if (conn._closed) {
                     return;
                 }
 
-                if (bal_isbitset(events, BAL_EVT_OOBWRITE) && self->on_oob_write &&
-                    !self->on_oob_write(self)) {
-                    print_early_return(BAL_EVT_OOBWRITE);
-                    return;
+                conn._closed = true;
+                conn._out.clear();
+                conn._sent = 0U;
+            }
+
+            bal_socket* s = conn.detach();
+            [[maybe_unused]] const auto closed = bal_close(&s, true);
+
+            std::shared_ptr<connection> retired;
+            {
+                std::lock_guard lock(_table_mtx);
+                auto& sl = _slots[conn._id & 0xffffffffU];
+                retired  = std::move(sl.conn);
+                sl.gen++;
+                _free.push_back(static_cast<uint32_t>(conn._id & 0xffffffffU));
+                _count--;
+            }
+
+            {
+                std::lock_guard lock(_flush_mtx);
+                _retired.push_back(std::move(retired));
+            }
+            _ring();
+        }
+
+        /* event thread. drain the doorbell before lowering the flag: a ring
+         * sent after that point must stay queued for the next pass. */
+        void _answer()
+        {
+            std::array<std::byte, 64> buf {};
+            while (BAL_IO_OK == bal_try_recv(_bell.get(), buf.data(), to_iolen(buf.size()),
+                0).status) { }
+
+            _rung = false;
+
+            std::vector<std::shared_ptr<connection>> flushq;
+            {
+                std::lock_guard lock(_flush_mtx);
+                flushq.swap(_flushq);
+            }
+
+            for (auto& conn : flushq) {
+                _flush(*conn);
+            }
+
+            std::vector<std::shared_ptr<connection>> retired;
+            {
+                std::lock_guard lock(_flush_mtx);
+                retired.swap(_retired);
+            }
+
+            for (auto& conn : retired) {
+                const auto w = conn->_worker;
+                _post(w, task {std::move(conn), task_kind::disconnect, {}});
+            }
+        }
+
+        void _queue_flush(std::shared_ptr<connection> conn)
+        {
+            {
+                std::lock_guard lock(_flush_mtx);
+                _flushq.push_back(std::move(conn));
+            }
+            _ring();
+        }
+
+        void _ring()
+        {
+            if (!_rung.exchange(true)) {
+                const std::byte b {0};
+                [[maybe_unused]] const auto sent = bal_sendto_addr(_bell.get(), &_bell_addr,
+                    &b, 1U, 0);
+            }
+        }
+
+        void _post(size_t w, task&& t)
+        {
+            /* notified under the lock: stop may destroy the worker as soon as
+             * the disconnect task posted here has run. */
+            auto& wk = *_workers[w];
+            std::lock_guard lock(wk.mtx);
+            wk.q.push_back(std::move(t));
+            wk.cv.notify_one();
+        }
+
+        void _run(worker& w)
+        {
+            std::unique_lock lock(w.mtx);
+            while (true) {
+                w.cv.wait(lock, [&w]() { return w.stop || !w.q.empty(); });
+                if (w.q.empty()) {
+                    break;
+                }
+
+                task t = std::move(w.q.front());
+                w.q.pop_front();
+                lock.unlock();
+                _handle(t);
+                t.conn.reset();
+                lock.lock();
+            }
+        }
+
+        /* worker thread. */
+        void _handle(task& t)
+        {
+            auto& conn    = *t.conn;
+            auto& handler = conn._handler;
+
+            try {
+                switch (t.kind) {
+                    case task_kind::connect:
+                        if constexpr(requires(THandler& h, connection& c) { h.on_connect(c); }) {
+                            handler.on_connect(conn);
+                        }
+                    break;
+                    case task_kind::data:
+                        if constexpr(requires(THandler& h, connection& c,
+                            std::span<const std::byte> d) { h.on_data(c, d); }) {
+                            handler.on_data(conn, std::span<const std::byte> {t.data});
+                        }
+                    break;
+                    case task_kind::close:
+                        conn.close();
+                    break;
+                    case task_kind::drain:
+                        if constexpr(requires(THandler& h, connection& c) { h.on_drain(c); }) {
+                            handler.on_drain(conn);
+                        }
+                    break;
+                    case task_kind::disconnect:
+                        if constexpr(requires(THandler& h, connection& c) { h.on_disconnect(c); }) {
+                            handler.on_disconnect(conn);
+                        }
+                    break;
                 }
             } catch (bal::exception& ex) {
                 _bal_dbglog("error: caught exception: '%s'!", ex.what());
             }
+
+            if (task_kind::disconnect == t.kind) {
+                {
+                    std::lock_guard lock(_table_mtx);
+                    _live--;
+                }
+                _table_cv.notify_all();
+            }
         }
 
-    private:
-        bal_socket* _s = nullptr;
-    };
+        std::shared_ptr<connection> _find(connection_id id) const
+        {
+            std::lock_guard lock(_table_mtx);
+            const auto index = id & 0xffffffffU;
+            if (index < _slots.size() && _slots[index].gen == (id >> 32U)) {
+                return _slots[index].conn;
+            }
+            return nullptr;
+        }
 
-    using scoped_socket = socket_base<true, default_policy>;
-    using manual_socket = socket_base<false, default_policy>;
+        std::vector<std::shared_ptr<connection>> _get_connections() const
+        {
+            std::vector<std::shared_ptr<connection>> conns;
+            std::lock_guard lock(_table_mtx);
+            for (const auto& sl : _slots) {
+                if (sl.conn) {
+                    conns.push_back(sl.conn);
+                }
+            }
+            return conns;
+        }
+
+        /* true once every connection has been through on_disconnect. */
+        bool _wait_drained(std::optional<std::chrono::milliseconds> timeout)
+        {
+            std::unique_lock lock(_table_mtx);
+            const auto drained = [this]() { return _live == 0U; };
+            if (!timeout) {
+                _table_cv.wait(lock, drained);
+                return true;
+            }
+            return _table_cv.wait_for(lock, *timeout, drained);
+        }
+
+        /* declared first so that it outlives every connection and buffer. */
+        std::pmr::synchronized_pool_resource _pool;
+        server_config _cfg;
+        std::atomic_bool _running {false};
+        std::vector<std::byte> _scratch;
+
+        mutable std::mutex _table_mtx;
+        std::condition_variable _table_cv;
+        std::vector<slot> _slots;
+        std::vector<uint32_t> _free;
+        size_t _count = 0U;
+        size_t _live = 0U;
+
+        std::mutex _flush_mtx;
+        std::vector<std::shared_ptr<connection>> _flushq;
+        std::vector<std::shared_ptr<connection>> _retired;
+        std::atomic_bool _rung {false};
+        bal_sockaddr _bell_addr {};
+
+        std::vector<std::unique_ptr<worker>> _workers;
+        handler<doorbell> _bell {*this};
+        handler<acceptor> _acceptor {*this};
+    };
 
 } // !namespace bal
 
+# if defined(__HAVE_STD_FORMAT__)
+/** Allows std::format("{}", addr) for bal::address and bal::address_string. */
+template<>
+struct std::formatter<bal::address_string> : std::formatter<std::string_view>
+{
+    auto format(const bal::address_string& str, std::format_context& ctx) const
+    {
+        return std::formatter<std::string_view>::format(str.view(), ctx);
+    }
+};
+
+template<>
+struct std::formatter<bal::address> : std::formatter<bal::address_string>
+{
+    auto format(const bal::address& addr, std::format_context& ctx) const
+    {
+        return std::formatter<bal::address_string>::format(addr.to_string(), ctx);
+    }
+};
+# endif
+
 #endif // !_BAL_HH_INCLUDED
@@ -34,11 +34,17 @@ extern "C" {
 
 int _bal_get_error(bal_error* err, bool extended);
 bool __bal_set_error(int code, const char* func, const char* file, uint32_t line);
-void __bal_set_os_error(int code, const char* message, const char* func,
-    const char* file, uint32_t line);
+void __bal_set_os_error(int code, bool gai, const char* func, const char* file,
+    uint32_t line);
 bool __bal_handle_error(int code, const char* func, const char* file,
     uint32_t line, bool gai);
 
+/** Copies the calling thread's error state (to hand it to another thread). */
+void _bal_save_error(bal_thread_error_info* out);
+
+/** Replaces the calling thread's error state with one saved elsewhere. */
+void _bal_restore_error(const bal_thread_error_info* in);
+
 /** Creates a libbal-specific error code from a positive integer that would
  * otherwise likely collide with OS-level error codes. Supports values
  * 1..255 inclusive. */
@@ -62,6 +68,8 @@ enum
     BAL_E_INTERNAL   = 13, /**< An internal error has occurred */
     BAL_E_UNAVAIL    = 14, /**< Feature is disabled or unavailable */
     BAL_E_PLATFORM   = 15, /**< Platform error code %d (%s) */
+    BAL_E_BADFRAME   = 16, /**< Malformed or oversized message frame */
+    BAL_E_POOLFULL   = 17, /**< Connection pool limit reached */
     BAL_E_UNKNOWN    = 255 /**< An unknown error has occurred */
 };
 
@@ -81,6 +89,8 @@ enum
 # define _BAL_E_INTERNAL   _bal_mk_error(BAL_E_INTERNAL)
 # define _BAL_E_UNAVAIL    _bal_mk_error(BAL_E_UNAVAIL)
 # define _BAL_E_PLATFORM   _bal_mk_error(BAL_E_PLATFORM)
+# define _BAL_E_BADFRAME   _bal_mk_error(BAL_E_BADFRAME)
+# define _BAL_E_POOLFULL   _bal_mk_error(BAL_E_POOLFULL)
 # define _BAL_E_UNKNOWN    _bal_mk_error(BAL_E_UNKNOWN)
 
 /** Determines if the input is a packed error created by _bal_mk_error. */
@@ -155,6 +165,58 @@ bool __bal_validate(bool expr, int err, const char* func, const char* file,
     __bal_handle_error(errno, __func__, __file__, __LINE__, false)
 # endif
 
+/** Retrieves the last socket error code for the calling thread. */
+# if defined(__WIN__)
+#  define _bal_lasterror() WSAGetLastError()
+# else
+#  define _bal_lasterror() errno
+# endif
+
+/** Whether or not an OS error code means the operation would have blocked. */
+# if defined(__WIN__)
+#  define _bal_wouldblock(err) (WSAEWOULDBLOCK == (err))
+# else
+#  define _bal_wouldblock(err) (EAGAIN == (err) || EWOULDBLOCK == (err))
+# endif
+
+/** Records the calling thread's last OS error, unless it means the operation
+ * would have blocked: that is routine for non-blocking I/O, so it is left in
+ * errno (WSAGetLastError on Windows) and the error state is not touched. */
+# define _bal_handlelastioerr() \
+    do { \
+        int _lasterr = _bal_lasterror(); \
+        if (!_bal_wouldblock(_lasterr)) \
+            (void)__bal_handle_error(_lasterr, __func__, __file__, __LINE__, false); \
+    } while (false)
+
+/** Sets the calling thread's last OS error code (errno/WSASetLastError). */
+# if defined(__WIN__)
+#  define _bal_setlasterror(err) WSASetLastError(err)
+# else
+#  define _bal_setlasterror(err) (errno = (err))
+# endif
+
+/** The OS error code reported for an operation that would have blocked. */
+# if defined(__WIN__)
+#  define _BAL_EWOULDBLOCK WSAEWOULDBLOCK
+# else
+#  define _BAL_EWOULDBLOCK EWOULDBLOCK
+# endif
+
+/** Whether or not an OS error code means a non-blocking connect is underway. */
+# if defined(__WIN__)
+#  define _bal_connpending(err) (WSAEWOULDBLOCK == (err))
+# else
+#  define _bal_connpending(err) (EINPROGRESS == (err) || EAGAIN == (err))
+# endif
+
+/** The OS error code reported for a refused connection. */
+# if defined(__WIN__)
+#  define _BAL_ECONNREFUSED WSAECONNREFUSED
+# else
+#  define _BAL_ECONNREFUSED ECONNREFUSED
+# endif
+
 # define _bal_handlegaierr(err) \
     __bal_handle_error(err, __func__, __file__, __LINE__, true)
 
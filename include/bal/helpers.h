@@ -93,18 +93,42 @@ void __bal_safefree(void** pp)
     ((PF_INET6 == ((struct sockaddr* )&(sa))->sa_family) \
         ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in))
 
+# if defined(__HAVE_BAL_LOCKPROF__)
+/** Declares a lock site's contention counters, and the time its mutex was
+ * last waited for or acquired. */
+#  define _BAL_LOCKPROF_SITE(counter) \
+    static bal_locksite _bal_locksite_##counter = {.name = #counter}; \
+    uint64_t _bal_lockprof_##counter = 0;
+#  define _BAL_LOCKPROF_WAIT(counter) \
+    _bal_lockprof_##counter = _bal_monotonic_nsec()
+#  define _BAL_LOCKPROF_ACQUIRED(counter) \
+    _bal_lockprof_##counter = _bal_lockprof_acquired(&_bal_locksite_##counter, \
+        _bal_lockprof_##counter)
+#  define _BAL_LOCKPROF_RELEASE(counter) \
+    _bal_lockprof_released(&_bal_locksite_##counter, _bal_lockprof_##counter)
+# else
+#  define _BAL_LOCKPROF_SITE(counter)
+#  define _BAL_LOCKPROF_WAIT(counter)
+#  define _BAL_LOCKPROF_ACQUIRED(counter)
+#  define _BAL_LOCKPROF_RELEASE(counter)
+# endif
+
 /** Initializes a counter used to determine whether or not a given mutex
- * was locked and unlocked precisely the same amount of times. */
+ * was locked and unlocked precisely the same amount of times. With lock
+ * profiling, also names a lock site (see bal_get_lock_stats). */
 # define _BAL_MUTEX_COUNTER_INIT(counter) \
+    _BAL_LOCKPROF_SITE(counter) \
     size_t _##counter = 0
 
 /** Locks the specified mutex, asserts that it was locked successfully,
  * and increments a counter. */
 # define _BAL_LOCK_MUTEX(m, counter) \
     do { \
+        _BAL_LOCKPROF_WAIT(counter); \
         if (!_bal_mutex_lock(m)) { \
             BAL_ASSERT(!"failed to lock mutex!"); \
         } else { \
+            _BAL_LOCKPROF_ACQUIRED(counter); \
             _##counter++; \
         } \
      } while (false)
@@ -113,6 +137,7 @@ void __bal_safefree(void** pp)
  * and increments a counter. */
 # define _BAL_UNLOCK_MUTEX(m, counter) \
     do { \
+        _BAL_LOCKPROF_RELEASE(counter); \
         if (!_bal_mutex_unlock(m)) { \
             BAL_ASSERT(!"failed to unlock mutex!"); \
         } else { \
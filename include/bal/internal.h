@@ -48,6 +48,11 @@ bool _bal_get_addrinfo(int flags, int addr_fam, int type, const char* host,
 bool _bal_getnameinfo(int flags, const bal_sockaddr* in, char* host, char* port);
 
 bool _bal_is_pending_conn(const bal_socket* s);
+
+/** Classifies the calling thread's last OS error after a failed send/recv as
+ * BAL_IO_WOULDBLOCK (including EINTR) or BAL_IO_ERROR. Only the latter is
+ * recorded in the error state, and only if `record` is true. */
+int _bal_io_failed(bool record);
 bool _bal_is_closed_conn(const bal_socket* s);
 
 uint32_t _bal_on_pending_conn_io(bal_socket* s, uint32_t* events);
@@ -59,6 +64,180 @@ bal_threadret _bal_eventthread(void* ctx);
 
 void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events);
 
+/** Validates a message framing configuration. */
+bool _bal_framing_valid(const bal_framing* cfg);
+
+/** Deallocates a socket's message framing state. */
+void _bal_framer_destroy(bal_framer** f);
+
+/** Reads available data into a framed socket's receive buffer. Returns any
+ * events (close, error) that resulted. */
+uint32_t _bal_framer_recv(bal_socket* s);
+
+/** Extracts the next complete frame from the receive buffer, if present. */
+bool _bal_framer_next(bal_framer* f, bal_frame* out);
+
+/** Moves unconsumed data to the front of the receive buffer. */
+void _bal_framer_compact(bal_framer* f);
+
+/** Delivers each complete frame to the socket's callback. Returns false if the
+ * callback destroyed or deregistered the socket. */
+bool _bal_dispatch_frames(bal_descriptor sd, bal_socket* s);
+
+/** Locates the first occurrence of a delimiter sequence (SSE2/AVX2 if available). */
+const uint8_t* _bal_find_delim(const uint8_t* buf, size_t len, const uint8_t* delim,
+    size_t dlen);
+
+/** Whether the calling thread is the event thread, dispatching callbacks. */
+bool _bal_in_dispatch(void);
+
+/** Deallocates a socket's write coalescing state. */
+void _bal_coalescer_destroy(bal_coalescer** c);
+
+/** Drops any coalesced data that has yet to be sent, and removes the
+ * coalescer from the flush queue. */
+void _bal_coalescer_discard(bal_coalescer* c);
+
+/** Buffers or sends data on a socket with write coalescing state. */
+ssize_t _bal_coalescer_send(const bal_socket* s, const void* data, bal_iolen len,
+    int flags);
+
+/** Sends as much buffered data as possible without blocking. Returns false
+ * (and stores the OS error in `c`) if the socket has failed. */
+bool _bal_coalescer_flush(bal_coalescer* c);
+
+/** Flushes every socket in the flush queue (called once per event loop
+ * iteration, after all callbacks for that iteration have returned). */
+void _bal_coalescer_flush_all(void);
+
+/** Whether or not any coalesced data has yet to be sent. */
+static inline
+bool _bal_coalescer_pending(const bal_coalescer* c)
+{
+    return NULL != c && c->off < c->len;
+}
+
+/** Re-evaluates a socket's send queue against its watermarks, pausing or
+ * resuming reads as configured. Returns BAL_EVT_WRITE_HIGH/LOW on a crossing. */
+uint32_t _bal_watermark_check(bal_socket* s);
+
+/** Deallocates a socket's packet timestamping state. */
+void _bal_tstamp_destroy(bal_tsqueue** q);
+
+/** Reads transmit timestamps from the socket's error queue into its
+ * timestamp queue. Returns BAL_EVT_TXTIME if any were read. */
+uint32_t _bal_tstamp_drain(bal_socket* s);
+
+/** Cancels a connection race, closing any attempts still in flight. */
+void _bal_race_destroy(bal_race** r);
+
+/** Frees a socket's arena and everything allocated from it. */
+void _bal_arena_destroy(bal_arena** a);
+
+/** Releases a pooled socket's slot in its pool destination as it is destroyed
+ * (the caller holds the async I/O mutex). */
+void _bal_pool_release(bal_socket* s);
+
+/** Cancels a socket's connection race, if any (locks the async I/O mutex). */
+void _bal_race_cancel(bal_socket* s);
+
+/** Starts any staggered attempts that are due, lowering `timeout` (msec) to
+ * the time of the next one. Returns the number of attempts in flight. */
+size_t _bal_race_prepare(int* timeout);
+
+/** Fills `fds` with the in-flight attempts (at most `max`). Returns the count. */
+size_t _bal_race_fill(bal_pollfd* fds, size_t max);
+
+/** Processes poll results for race attempts, swapping a winner into its socket
+ * and delivering BAL_EVT_CONNECT/BAL_EVT_CONNFAIL (called by the event thread). */
+void _bal_race_dispatch(const bal_pollfd* fds, size_t nfds);
+
+/** Creates the descriptors used to interrupt the event thread's poll. */
+bool _bal_wakeup_create(void);
+
+/** Closes the descriptors created by _bal_wakeup_create. */
+void _bal_wakeup_destroy(void);
+
+/** Interrupts the event thread's poll (safe to call from any thread). */
+void _bal_wakeup_signal(void);
+
+/** Consumes pending wakeup signals (called by the event thread). */
+void _bal_wakeup_drain(void);
+
+/** Stops the resolver threads, discarding outstanding requests. */
+void _bal_resolver_cleanup(void);
+
+/** Delivers completed resolution requests (called by the event thread). */
+void _bal_resolver_dispatch(void);
+
+/** Resolver thread entry point. */
+bal_threadret _bal_resolver_thread(void* ctx);
+
+/** Parses a literal IPv4/IPv6 address (with optional scope ID) and numeric
+ * port (or NULL, for 0) without consulting a resolver. Sets no error. */
+bool _bal_parse_addr(const char* host, const char* port, bal_sockaddr* out);
+
+/** Writes the numeric form of an IPv4/IPv6 address (with numeric scope ID, if
+ * any) into `buf` without calling getnameinfo. Returns the length written, or
+ * 0 if the family is unsupported or `buf` is too small. Sets no error. */
+size_t _bal_format_ipaddr(const bal_sockaddr* in, char* buf, size_t size);
+
+/** Writes a port number (host byte order) into `buf`; returns the length
+ * written, or 0 if `buf` is too small. */
+size_t _bal_format_port(uint16_t port, char* buf, size_t size);
+
+/** Looks up the host name of `in` through the reverse lookup cache. `addr` is
+ * the numeric form of `in`, as produced by _bal_format_ipaddr. */
+bool _bal_reverse_lookup(const bal_sockaddr* in, const char* addr, char* host,
+    size_t size);
+
+/** Resolves host/port through the resolver cache, copying up to `max`
+ * addresses into `out`. Returns the number copied (0 on failure). */
+size_t _bal_resolve_addrs(int flags, int addr_fam, int type, const char* host,
+    const char* port, bal_sockaddr* out, size_t max);
+
+/** Resolves host/port through the resolver cache into a bal_addrlist. */
+bool _bal_resolve_addrlist(int flags, int addr_fam, int type, const char* host,
+    const char* port, bal_addrlist* out);
+
+/** Discards a cache's entries and statistics, then applies a new size limit
+ * and TTLs (msec). */
+bool _bal_cache_configure(bal_cache* c, size_t max, uint32_t ttl, uint32_t neg_ttl);
+
+/** Looks up `key`. On BAL_CACHE_HIT, copies up to `*len` bytes of the value into
+ * `data` and sets `*len` to its full size; on BAL_CACHE_NEGATIVE, copies the
+ * stored error into `err`. */
+int _bal_cache_get(bal_cache* c, const char* key, void* data, size_t* len,
+    bal_thread_error_info* err);
+
+/** Inserts or replaces `key`. Records a negative entry if `err` is non-NULL. */
+void _bal_cache_put(bal_cache* c, const char* key, const void* data, size_t len,
+    const bal_thread_error_info* err);
+
+/** Discards every entry in a cache (statistics are retained). */
+void _bal_cache_flush(bal_cache* c);
+
+/** Retrieves a snapshot of a cache's statistics. */
+void _bal_cache_get_stats(bal_cache* c, bal_cache_stats* out);
+
+/** Discards every entry and deallocates the hash table. */
+void _bal_cache_destroy(bal_cache* c);
+
+/** Creates/initializes a condition variable. */
+bool _bal_cond_create(bal_condition* cond);
+
+/** Waits on a condition variable; `mutex` must be locked exactly once. */
+bool _bal_cond_wait(bal_condition* cond, bal_mutex* mutex);
+
+/** Wakes one thread waiting on a condition variable. */
+bool _bal_cond_signal(bal_condition* cond);
+
+/** Wakes all threads waiting on a condition variable. */
+bool _bal_cond_broadcast(bal_condition* cond);
+
+/** Destroys a condition variable. */
+bool _bal_cond_destroy(bal_condition* cond);
+
 /** Creates a new list. */
 bool _bal_list_create(bal_list** lst);
 
@@ -125,17 +304,163 @@ void _bal_set_boolean(bool* boolean, bool value);
 /** Runs the specified function exactly once. */
 bool _bal_once(bal_once* once, bal_once_fn func);
 
+/** Returns a monotonic clock reading, in milliseconds. */
+uint64_t _bal_monotonic_msec(void);
+
+/** Returns a monotonic clock reading, in nanoseconds. */
+uint64_t _bal_monotonic_nsec(void);
+
 /** Converts an addrinfo linked-list into a bal_addrlist. */
 bool _bal_addrinfo_to_addrlist(struct addrinfo* ai, bal_addrlist* out);
 
+/** Initializes an empty bal_addrlist with room for `count` (zeroed) addresses. */
+bool _bal_addrlist_alloc(bal_addrlist* al, size_t count);
+
+/** Returns the storage in use by a bal_addrlist. */
+static inline
+bal_sockaddr* _bal_addrlist_data(bal_addrlist* al)
+{
+    return NULL != al->heap ? al->heap : al->addrs;
+}
+
 /** Uses the best-avaiable string copying routine. */
 void _bal_strcpy(char* dest, size_t destsz, const char* src, size_t srcsz);
 
-# if defined(BAL_DBGLOG)
-/** Returns the current thread identifier (used by _bal_dbglog). */
+# if defined(BAL_DBGLOG) || defined(__HAVE_BAL_TRACE__)
+/** Returns the current thread identifier (used by _bal_dbglog and tracing). */
 pid_t _bal_gettid(void);
 # endif
 
+# if defined(BAL_DBGLOG)
+
+/** Writes one (already formatted) debug log message to stdout. */
+void _bal_log_write(pid_t tid, const char* func, const char* file, uint32_t line,
+    const char* msg);
+
+#  if defined(__HAVE_ASYNC_DBGLOG__)
+/** Queues a debug log message for the log thread without formatting it.
+ * Returns false if it must be logged synchronously instead. */
+bool _bal_log_enqueue(const char* func, const char* file, uint32_t line,
+    const char* format, va_list args);
+
+/** Captures a format string's arguments into a log record. Returns false if
+ * the format uses something that cannot be captured (e.g. '*' or %n). */
+bool _bal_log_capture(bal_log_record* rec, const char* format, va_list args);
+
+/** Formats a captured log record into `buf`; returns the length written. */
+size_t _bal_log_format(const bal_log_record* rec, char* buf, size_t size);
+
+/** Waits (for a bounded time) until the log thread has written everything
+ * queued so far. */
+void _bal_log_flush(void);
+
+/** Retrieves the number of messages written by the log thread, and the number
+ * dropped because a thread's queue was full. */
+void _bal_log_get_stats(uint64_t* written, uint64_t* dropped);
+#  endif
+# endif
+
+/** calloc, malloc and realloc, counted in the library-wide statistics. */
+void* _bal_calloc(size_t count, size_t size);
+void* _bal_malloc(size_t size);
+void* _bal_realloc(void* ptr, size_t size);
+
+/** Allocates a socket's statistics counters. */
+bool _bal_sockstats_create(bal_socket* s);
+
+/** Frees a socket's statistics counters. */
+void _bal_sockstats_destroy(bal_socket* s);
+
+/** Invokes a socket's callback, updating statistics (and the trace). */
+void _bal_invoke_callback(bal_socket* s, bal_descriptor sd, uint32_t events);
+
+/** Adds a sample to one of the BAL_HIST_* histograms. */
+void _bal_hist_record(int which, uint64_t value);
+
+/** Counts a send by `s` that returned `ret` (call before the error is handled). */
+void _bal_count_send(const bal_socket* s, ssize_t ret);
+
+/** Counts a receive by `s` that returned `ret` (call before the error is handled). */
+void _bal_count_recv(const bal_socket* s, ssize_t ret);
+
+# if !defined(__cplusplus)
+/** Adds to a statistics counter. */
+static inline
+void _bal_count(bal_counter* c, uint64_t n)
+{
+#  if defined(__HAVE_STDATOMICS__)
+    atomic_fetch_add_explicit(c, n, memory_order_relaxed);
+#  else
+    *c += n;
+#  endif
+}
+
+/** Reads a statistics counter. */
+static inline
+uint64_t _bal_counter_get(const bal_counter* c)
+{
+#  if defined(__HAVE_STDATOMICS__)
+    return atomic_load_explicit((bal_counter*)c, memory_order_relaxed);
+#  else
+    return *c;
+#  endif
+}
+# endif
+
+# if defined(__HAVE_BAL_TRACE__)
+/** Appends an event to the calling thread's trace ring. */
+void _bal_trace_record(uint8_t type, bal_descriptor sd, uint32_t arg, uint64_t start,
+    uint64_t end);
+
+/** Names the calling thread in trace output (`name` must be static storage). */
+void _bal_trace_name_thread(const char* name);
+
+#  define _bal_trace_begin(var) uint64_t var = _bal_monotonic_nsec()
+#  define _bal_trace_end(var, type, sd, arg) \
+    _bal_trace_record(type, sd, arg, var, _bal_monotonic_nsec())
+#  define _bal_trace_instant(type, sd, arg) \
+    _bal_trace_record(type, sd, arg, _bal_monotonic_nsec(), 0U)
+#  define _bal_trace_span(type, sd, arg, start, end) \
+    _bal_trace_record(type, sd, arg, start, end)
+# else
+#  define _bal_trace_begin(var)
+#  define _bal_trace_end(var, type, sd, arg)
+#  define _bal_trace_instant(type, sd, arg)
+#  define _bal_trace_span(type, sd, arg, start, end)
+#  define _bal_trace_name_thread(name)
+# endif
+
+# if defined(__HAVE_BAL_LOCKPROF__) && !defined(__cplusplus)
+/** Counts an acquisition of a lock site's mutex that began waiting at `start`;
+ * returns the time it was acquired. */
+uint64_t _bal_lockprof_acquired(bal_locksite* site, uint64_t start);
+
+/** Counts a release of a lock site's mutex that was acquired at `acquired`. */
+void _bal_lockprof_released(bal_locksite* site, uint64_t acquired);
+# endif
+
+/*
+ * USDT probes (provider "libbal"; e.g. `bpftrace -e 'usdt:./libbal.so:libbal:*'`):
+ *
+ *   send__entry(sd, len)          send__return(sd, ret)
+ *   recv__entry(sd, len)          recv__return(sd, ret)
+ *   socket__register(sd, mask)    socket__remove(sd)
+ *   dispatch(sd, events)          callback__return(sd, events, nsec)
+ *   accept(listener sd, sd)       connect__done(sd, connected)
+ *   error(code, os code, func, line)
+ */
+# if defined(__HAVE_USDT__)
+#  define _bal_probe1(name, a) DTRACE_PROBE1(libbal, name, a)
+#  define _bal_probe2(name, a, b) DTRACE_PROBE2(libbal, name, a, b)
+#  define _bal_probe3(name, a, b, c) DTRACE_PROBE3(libbal, name, a, b, c)
+#  define _bal_probe4(name, a, b, c, d) DTRACE_PROBE4(libbal, name, a, b, c, d)
+# else
+#  define _bal_probe1(name, a)
+#  define _bal_probe2(name, a, b)
+#  define _bal_probe3(name, a, b, c)
+#  define _bal_probe4(name, a, b, c, d)
+# endif
+
 # if defined(__WIN__)
 /** Initializes static data at initialization time. */
 BOOL CALLBACK _bal_static_once_init_func(PINIT_ONCE ponce, PVOID param, PVOID* ctx);
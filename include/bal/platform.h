@@ -83,6 +83,8 @@
 
 #  if defined(__linux__)
 #   include <sys/syscall.h>
+#   include <linux/sockios.h>
+#   define __HAVE_SIOCOUTQ__
 #  elif defined(__sun)
 #   include <sys/filio.h>
 #   include <stropts.h>
@@ -101,6 +103,7 @@
 #  include <sys/ioctl.h>
 #  include <netinet/in.h>
 #  include <arpa/inet.h>
+#  include <net/if.h>
 #  include <fcntl.h>
 #  include <netdb.h>
 #  include <unistd.h>
@@ -111,6 +114,14 @@
 #  include <sched.h>
 #  include <poll.h>
 
+#  if defined(__linux__)
+#   include <time.h>
+#   include <linux/net_tstamp.h>
+#   include <linux/errqueue.h>
+#   define __HAVE_SO_TIMESTAMPING__
+#   define __HAVE_SENDMMSG__
+#  endif
+
 #  if !defined(__STDC_NO_ATOMICS__) && !defined(__cplusplus)
 #   include <stdatomic.h>
 #   define __HAVE_STDATOMICS__
@@ -157,6 +168,7 @@ typedef void (*bal_once_fn)(void);
 typedef void* bal_threadret;
 
 #  define BAL_SOCKET_SPEC "%d"
+#  define BAL_BADSOCKET -1
 #  define BAL_TID_SPEC "%x"
 
 /** The one-time initializer. */
@@ -244,6 +256,7 @@ typedef ULONG nfds_t;
 typedef unsigned bal_threadret;
 
 #  define BAL_SOCKET_SPEC "%llu"
+#  define BAL_BADSOCKET INVALID_SOCKET
 #  define BAL_TID_SPEC "%x"
 
 /** The one-time initializer. */
@@ -298,16 +311,99 @@ typedef unsigned bal_threadret;
 # define BAL_EVT_INVALID  0x00000100U
 # define BAL_EVT_OOBREAD  0x00000200U
 # define BAL_EVT_OOBWRITE 0x00000400U
-# define BAL_EVT_ALL      0x000007ffU /**< Includes all available event types. */
+# define BAL_EVT_WRITE_HIGH 0x00000800U /**< Send queue reached the high watermark. */
+# define BAL_EVT_WRITE_LOW  0x00001000U /**< Send queue drained to the low watermark. */
+# define BAL_EVT_TXTIME     0x00002000U /**< Transmit timestamps are available. */
+# define BAL_EVT_ALL      0x00003fffU /**< Includes all available event types. */
+# define BAL_EVT_COUNT    14          /**< Number of event types (bits in BAL_EVT_ALL). */
 # define BAL_EVT_NORMAL   0x000001bdU /**< Excludes write, oob [r/w], priority. */
 # define BAL_EVT_CLIENT   0x000001bfU /**< Excludes oob [r/w], priority. */
 
 # define BAL_S_CONNECT    0x00000001U
 # define BAL_S_LISTEN     0x00000002U
 # define BAL_S_CLOSE      0x00000004U
+# define BAL_S_RESOLVE    0x00000008U /**< Awaiting resolution (bal_connect_async). */
 
 # define BAL_MAGIC        0x45004500U
 
+# define BAL_FRAME_NONE   0 /**< No framing; BAL_EVT_READ signals readability. */
+# define BAL_FRAME_LENGTH 1 /**< Fixed-size header containing a length field. */
+# define BAL_FRAME_VARINT 2 /**< Unsigned LEB128 (varint) length prefix. */
+# define BAL_FRAME_DELIM  3 /**< Frames terminated by a delimiter sequence. */
+
+# define BAL_FRAME_MAXDELIM 8       /**< Longest supported frame delimiter. */
+# define BAL_FRAME_BUFSIZE  4096    /**< Initial framed receive buffer size. */
+# define BAL_FRAME_DEFMAX   1048576 /**< Default maximum frame size. */
+
+# define BAL_COALESCE_BUFSIZE 4096  /**< Initial write coalescing buffer size. */
+# define BAL_COALESCE_MAX     65536 /**< Most bytes held back by write coalescing. */
+
+# define BAL_WATERMARK_POLL_MSEC 10 /**< Poll interval while above a high watermark. */
+
+# define BAL_ARENA_CHUNK 8192 /**< Default per-socket arena chunk size (see bal_arena_alloc). */
+# define BAL_ARENA_ALIGN 16   /**< Alignment of every arena allocation (a power of 2). */
+
+# define BAL_POOL_MAX_IDLE  8  /**< Default idle connections kept per destination. */
+# define BAL_POOL_MAX_TOTAL 32 /**< Default connections allowed per destination. */
+
+# define BAL_TS_RX_SOFTWARE 0x00000001U /**< Kernel receive timestamps. */
+# define BAL_TS_RX_HARDWARE 0x00000002U /**< NIC receive timestamps. */
+# define BAL_TS_TX_SOFTWARE 0x00000004U /**< Kernel transmit timestamps. */
+# define BAL_TS_TX_HARDWARE 0x00000008U /**< NIC transmit timestamps. */
+# define BAL_TS_QUEUELEN    16          /**< Transmit timestamps held per socket. */
+
+# define BAL_RESOLVER_THREADS 2 /**< Threads in the asynchronous resolver pool. */
+
+# define BAL_ADDRLIST_INLINE 4 /**< Addresses a bal_addrlist holds without allocating. */
+
+# define BAL_RACE_DELAY_MSEC 250 /**< Connection Attempt Delay (RFC 8305, section 5). */
+# define BAL_RACE_MAXADDRS   16  /**< Most addresses raced by bal_connect_race. */
+
+# define BAL_SENDMMSG_BATCH 64 /**< Datagrams per sendmmsg call in bal_sendto_dests. */
+
+# define BAL_RESCACHE_MAXENTRIES 256 /**< Default resolver cache size. */
+# define BAL_RESCACHE_TTL        60  /**< Default resolver cache TTL, in seconds. */
+# define BAL_RESCACHE_NEGTTL     5   /**< Default TTL of failed lookups, in seconds. */
+# define BAL_RESCACHE_MAXADDRS   16  /**< Most addresses cached per lookup. */
+
+# define BAL_RDNSCACHE_MAXENTRIES 256 /**< Default reverse lookup cache size. */
+# define BAL_RDNSCACHE_TTL        300 /**< Default reverse lookup cache TTL, in seconds. */
+# define BAL_RDNSCACHE_NEGTTL     30  /**< Default TTL of failed reverse lookups, in seconds. */
+
+/** Buffer size sufficient for any string produced by bal_format_addr. */
+# define BAL_ADDRSTRLEN (INET6_ADDRSTRLEN + 20)
+
+# define BAL_CACHE_MISS     0 /**< bal_cache lookup: no usable entry. */
+# define BAL_CACHE_HIT      1 /**< bal_cache lookup: positive entry. */
+# define BAL_CACHE_NEGATIVE 2 /**< bal_cache lookup: negative entry. */
+
+# define BAL_DBGLOG_MAXMSG    1024 /**< Longest debug log message; longer ones are truncated. */
+# define BAL_DBGLOG_RINGSIZE  128  /**< Async log records queued per thread (a power of 2). */
+# define BAL_DBGLOG_MAXARGS   12   /**< Most arguments captured by one async log record. */
+# define BAL_DBGLOG_STRBYTES  256  /**< Bytes of string arguments one async log record holds. */
+# define BAL_DBGLOG_IDLE_MSEC 2    /**< How long the async log thread sleeps when idle. */
+
+# define BAL_IO_OK         0 /**< bal_try_send/recv: everything sent, or data received. */
+# define BAL_IO_PARTIAL    1 /**< bal_try_send: only part of the buffer was sent. */
+# define BAL_IO_WOULDBLOCK 2 /**< Nothing could be transferred without blocking. */
+# define BAL_IO_EOF        3 /**< bal_try_recv: the peer closed the connection. */
+# define BAL_IO_ERROR      4 /**< The operation failed (see bal_get_error). */
+
+# define BAL_TRACE_POLL     1 /**< Trace event: one call to poll, start to finish. */
+# define BAL_TRACE_DISPATCH 2 /**< Trace event: events for one socket being processed. */
+# define BAL_TRACE_CALLBACK 3 /**< Trace event: a socket's callback being invoked. */
+# define BAL_TRACE_ACCEPT   4 /**< Trace event: a connection was accepted. */
+# define BAL_TRACE_CONNECT  5 /**< Trace event: a connection attempt was started. */
+# define BAL_TRACE_CLOSE    6 /**< Trace event: a socket was closed. */
+
+# define BAL_TRACE_RINGSIZE 4096 /**< Trace records kept per thread (a power of 2). */
+
+# define BAL_HIST_CALLBACK 0 /**< bal_get_histogram: how long callbacks take. */
+# define BAL_HIST_LOOPLAG  1 /**< bal_get_histogram: how late poll returns after a timeout. */
+# define BAL_HIST_COUNT    2 /**< Number of histograms. */
+# define BAL_HIST_SUBBITS  3 /**< Histogram buckets per power of 2 (log2): 12.5% precision. */
+# define BAL_HIST_BUCKETS  ((64 - BAL_HIST_SUBBITS + 1) << BAL_HIST_SUBBITS) /**< Per histogram. */
+
 # if defined(__MACOS__)
 #  undef __HAVE_SO_ACCEPTCONN__
 # else
@@ -351,6 +447,36 @@ typedef unsigned bal_threadret;
 #  error "unable to resolve thread local attribute; please contact the author."
 # endif
 
+/* the asynchronous debug log backend is lock-free, so it needs C11 atomics. */
+# if defined(BAL_DBGLOG) && defined(BAL_DBGLOG_ASYNC) && defined(__HAVE_STDATOMICS__)
+#  define __HAVE_ASYNC_DBGLOG__
+# endif
+
+/* event tracing publishes each thread's records with C11 atomics, too. */
+# if defined(BAL_TRACE) && defined(__HAVE_STDATOMICS__)
+#  define __HAVE_BAL_TRACE__
+# endif
+
+/* the lock profiler registers lock sites and updates their counters atomically. */
+# if defined(BAL_LOCKPROF) && defined(__HAVE_STDATOMICS__)
+#  define __HAVE_BAL_LOCKPROF__
+# endif
+
+/* USDT (SystemTap/bpftrace) probes are compiled in wherever sys/sdt.h exists;
+ * each is a single nop until a tracer attaches. define BAL_NO_USDT to omit them. */
+# if defined(__linux__) && !defined(BAL_NO_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#   include <sys/sdt.h>
+#   define __HAVE_USDT__
+#  endif
+# endif
+
+# if defined(__AVX2__)
+#  define __HAVE_AVX2__
+# elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define __HAVE_SSE2__
+# endif
+
 # if (defined(__clang__) || defined(__GNUC__)) && defined(__FILE_NAME__)
 #  define __file__ __FILE_NAME__
 # elif defined(__BASE_FILE__)
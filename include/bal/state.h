@@ -37,6 +37,11 @@ extern volatile bool _bal_async_poll_init;
 # endif
 
 extern bal_as_container _bal_as_container;
+extern bal_resolver _bal_resolver;
+extern bal_cache _bal_rescache;
+extern bal_cache _bal_rdnscache;
+extern bal_counters _bal_stats;
+extern bal_watchdog _bal_watchdog;
 extern bal_state _bal_state;
 
 #endif /* !_BAL_STATE_H_INCLUDED */
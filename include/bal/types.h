@@ -33,6 +33,24 @@ typedef struct sockaddr_storage bal_sockaddr;
 
 struct bal_socket; /* forward declaration. */
 
+/** A statistics counter, updated without ordering guarantees. */
+# if defined(__HAVE_STDATOMICS__)
+typedef atomic_uint_fast64_t bal_counter;
+# else
+typedef volatile uint_fast64_t bal_counter;
+# endif
+
+/** Per-socket statistics counters. */
+typedef struct {
+    bal_counter sends;       /**< Successful send calls. */
+    bal_counter bytes_sent;  /**< Bytes sent (or accepted for coalescing). */
+    bal_counter send_wouldblock; /**< Send calls that would have blocked. */
+    bal_counter recvs;       /**< Successful receive calls. */
+    bal_counter bytes_recv;  /**< Bytes received. */
+    bal_counter recv_wouldblock; /**< Receive calls that would have blocked. */
+    bal_counter events;      /**< Events delivered to the socket's callback. */
+} bal_sockcounters;
+
 /** bal_async_poll callback. */
 typedef void (*bal_async_cb)(struct bal_socket*, uint32_t);
 
@@ -43,27 +61,222 @@ typedef bool (*bal_list_iter_cb)(bal_descriptor /*key*/,
 /** Worker thread callback. */
 typedef bal_threadret (*bal_thread_cb)(void*);
 
+struct _bal_addrlist; /* forward declaration. */
+
+/** bal_resolve_async callback. `addrs` is NULL if resolution failed (call
+ * bal_get_error for the reason), and is only valid until the callback returns. */
+typedef void (*bal_resolve_cb)(struct _bal_addrlist* /*addrs*/, void* /*ctx*/);
+
+/** bal_pool_checkout_async callback. `s` is the checked-out connection, or NULL
+ * if none could be opened (call bal_get_error for the reason). */
+typedef void (*bal_pool_cb)(struct bal_socket* /*s*/, void* /*ctx*/);
+
+/** Message framing configuration (see bal_set_framing). */
+typedef struct {
+    int mode;                /**< One of the BAL_FRAME_* modes. */
+    size_t max_frame;        /**< Largest acceptable frame (0 = BAL_FRAME_DEFMAX). */
+    struct {                 /**< BAL_FRAME_LENGTH settings. */
+        uint8_t header_len;  /**< Total size of the header, in bytes. */
+        uint8_t field_off;   /**< Offset of the length field within the header. */
+        uint8_t field_len;   /**< Size of the length field (1, 2, 4 or 8). */
+        bool big_endian;     /**< Whether the length field is big-endian. */
+        bool inclusive;      /**< Whether the length includes the header. */
+    } length;
+    struct {                 /**< BAL_FRAME_DELIM settings. */
+        uint8_t bytes[BAL_FRAME_MAXDELIM]; /**< The delimiter sequence. */
+        uint8_t len;         /**< Length of the delimiter sequence. */
+    } delim;
+} bal_framing;
+
+/** A view of one complete frame within a socket's receive buffer. Only valid
+ * for the duration of the BAL_EVT_READ callback that delivered it. */
+typedef struct {
+    const uint8_t* data;     /**< Frame payload (header/delimiter excluded). */
+    size_t len;              /**< Length of the payload, in bytes. */
+    size_t hdr_len;          /**< Bytes preceding `data` (header or prefix). */
+} bal_frame;
+
+/** Per-socket framed receive state. */
+typedef struct {
+    bal_framing cfg;         /**< Framing configuration. */
+    uint8_t* buf;            /**< Receive buffer. */
+    size_t cap;              /**< Capacity of `buf`. */
+    size_t start;            /**< Offset of the first unconsumed byte. */
+    size_t end;              /**< Offset one past the last received byte. */
+    size_t scanned;          /**< Bytes past `start` known to lack a delimiter. */
+    bal_frame cur;           /**< The frame currently being delivered. */
+    bool active;             /**< Whether `cur` is valid. */
+    bool failed;             /**< Set after a malformed/oversized frame. */
+} bal_framer;
+
+/** The outcome of bal_try_send/bal_try_recv. */
+typedef struct {
+    int status;              /**< One of the BAL_IO_* values. */
+    size_t bytes;            /**< Bytes transferred (0 unless OK/PARTIAL). */
+} bal_io_result;
+
+/** A kernel or hardware packet timestamp (see bal_enable_timestamping). */
+typedef struct {
+    int64_t sec;             /**< Seconds since the epoch. */
+    int32_t nsec;            /**< Nanoseconds. */
+    uint32_t id;             /**< Transmit: the kernel's byte/datagram counter. */
+    uint32_t source;         /**< The BAL_TS_* flag it came from (0 = none). */
+} bal_timestamp;
+
+/** Per-socket packet timestamping state. */
+typedef struct {
+    uint32_t flags;          /**< BAL_TS_* flags in effect. */
+    bal_timestamp tx[BAL_TS_QUEUELEN]; /**< Pending transmit timestamps. */
+    size_t head;             /**< Index of the oldest entry in `tx`. */
+    size_t count;            /**< Number of entries in `tx`. */
+} bal_tsqueue;
+
+/** Per-socket write coalescing state. */
+typedef struct _bal_coalescer {
+    bal_descriptor sd;       /**< Descriptor the coalesced data is bound for. */
+    uint8_t* buf;            /**< Outbound data awaiting a flush. */
+    size_t cap;              /**< Capacity of `buf`. */
+    size_t off;              /**< Offset of the first unsent byte. */
+    size_t len;              /**< Offset one past the last buffered byte. */
+    int error;               /**< Deferred OS error from a failed flush. */
+    bool enabled;            /**< Whether sends from callbacks are coalesced. */
+    bool queued;             /**< Whether this is linked into the flush queue. */
+    struct _bal_coalescer* next; /**< Next entry in the flush queue. */
+} bal_coalescer;
+
+/** A poll(2) descriptor entry. */
+# if defined(__WIN__)
+typedef WSAPOLLFD bal_pollfd;
+# else
+typedef struct pollfd bal_pollfd;
+# endif
+
+/** Happy Eyeballs (RFC 8305) connection race state. */
+typedef struct _bal_race {
+    struct bal_socket* s;    /**< Receives the winning descriptor. */
+    bal_sockaddr addrs[BAL_RACE_MAXADDRS]; /**< Candidates, address families interleaved. */
+    bal_descriptor sds[BAL_RACE_MAXADDRS]; /**< In-flight attempt per candidate, or BAL_BADSOCKET. */
+    size_t naddrs;           /**< Number of candidates. */
+    size_t cursor;           /**< Next candidate to attempt. */
+    size_t inflight;         /**< Attempts currently in progress. */
+    uint64_t next_at;        /**< Monotonic time (msec) of the next staggered attempt. */
+    int error;               /**< OS error from the most recent failed attempt. */
+    bool lost;               /**< Set once every candidate has failed. */
+    struct _bal_race* next;  /**< Next entry in the race queue. */
+} bal_race;
+
+/** A block of memory in a socket's arena; allocations follow the header. */
+typedef struct _bal_arena_chunk {
+    struct _bal_arena_chunk* next; /**< Next (older) chunk. */
+    size_t size;             /**< Usable bytes. */
+    size_t used;             /**< Bytes handed out. */
+} bal_arena_chunk;
+
+/** A socket's bump-pointer arena (see bal_arena_alloc). */
+typedef struct {
+    bal_arena_chunk* head;   /**< The chunk being allocated from, then older ones. */
+    size_t chunk_size;       /**< Usable bytes in each regular chunk. */
+} bal_arena;
+
 typedef struct bal_socket {
-    bal_descriptor sd;     /**< Socket descriptor. */
-    int addr_fam;          /**< Address family (e.g. AF_INET). */
-    int type;              /**< Socket type (e.g., SOCK_STREAM). */
-    int proto;             /**< Protocol (e.g., IPPROTO_TCP). */
-    uintptr_t user_data;   /**< Any user-supplied data that is desired. */
-    struct {               /**< Internal socket state data. */
-        uint32_t mask;     /**< Async I/O event mask. */
-        uint32_t bits;     /**< State bitmask. */
-        bal_async_cb proc; /**< Async I/O event callback. */
+    bal_descriptor sd;      /**< Socket descriptor. */
+    int addr_fam;           /**< Address family (e.g. AF_INET). */
+    int type;               /**< Socket type (e.g., SOCK_STREAM). */
+    int proto;              /**< Protocol (e.g., IPPROTO_TCP). */
+    uintptr_t user_data;    /**< Any user-supplied data that is desired. */
+    struct {                /**< Internal socket state data. */
+        uint32_t mask;      /**< Async I/O event mask. */
+        uint32_t bits;      /**< State bitmask. */
+        bal_async_cb proc;  /**< Async I/O event callback. */
+        bal_framer* framer; /**< Message framing state (NULL if unframed). */
+        bal_coalescer* coalesce; /**< Write coalescing state (NULL if unused). */
+        bal_tsqueue* tstamp; /**< Packet timestamping state (NULL if unused). */
+        bal_race* race;     /**< Connection race state (NULL unless racing). */
+        bal_sockcounters* stats; /**< Statistics (see bal_get_socket_stats). */
+        bal_arena* arena;   /**< Per-socket arena (NULL until first used). */
+        struct _bal_pool_dest* pool; /**< Pool destination (NULL unless pooled). */
+        struct {            /**< Send queue watermarks (see bal_set_watermarks). */
+            size_t low;     /**< Queued bytes at or below which BAL_EVT_WRITE_LOW fires. */
+            size_t high;    /**< Queued bytes at or above which BAL_EVT_WRITE_HIGH fires. */
+            bool pause_read; /**< Whether to stop reading while above `high`. */
+            bool above;     /**< Whether the high watermark has been reached. */
+            bool paused;    /**< Whether BAL_EVT_READ was removed from the mask. */
+        } wm;
     } state;
 } bal_socket;
 
-typedef struct _bal_addr {
-    bal_sockaddr addr;
-    struct _bal_addr* next;
-} bal_addr;
+/** A destination resolved once by bal_dest_prepare and reused for any number
+ * of sends. Treat as opaque and immutable. */
+typedef struct {
+    bal_sockaddr addr;       /**< The resolved address. */
+    socklen_t len;           /**< Length of `addr`, in bytes. */
+} bal_dest;
 
+/** Connection pool configuration (see bal_pool_create). Limits apply to each
+ * destination separately. */
 typedef struct {
-    bal_addr* addr;
-    bal_addr* iter;
+    size_t max_idle;         /**< Idle connections kept (0 = BAL_POOL_MAX_IDLE). */
+    size_t max_total;        /**< Connections open, idle or not (0 = BAL_POOL_MAX_TOTAL). */
+    uint32_t idle_ttl_sec;   /**< Idle connections older than this are closed (0 = never). */
+} bal_pool_cfg;
+
+/** Connection pool statistics (see bal_pool_get_stats). */
+typedef struct {
+    uint64_t created;        /**< Connections opened. */
+    uint64_t reused;         /**< Checkouts satisfied by an idle connection. */
+    uint64_t stale;          /**< Idle connections discarded (closed by the peer or expired). */
+    uint64_t waits;          /**< Asynchronous checkouts that waited for a free slot. */
+    uint64_t failures;       /**< Checkouts that failed. */
+    size_t idle;             /**< Idle connections held. */
+    size_t busy;             /**< Connections checked out or being opened. */
+} bal_pool_stats;
+
+/** A checkout waiting for, or being handed, a connection. */
+typedef struct _bal_pool_req {
+    bal_pool_cb cb;          /**< Completion callback. */
+    void* ctx;               /**< Passed to `cb`. */
+    struct _bal_pool_dest* dest; /**< The destination. */
+    struct bal_socket* s;    /**< The connection, once one is assigned. */
+    bool fresh;              /**< Whether `s` is being opened (vs. taken from idle). */
+    struct _bal_pool_req* next;
+} bal_pool_req;
+
+/** An idle pooled connection. */
+typedef struct {
+    struct bal_socket* s;    /**< The connection. */
+    uint64_t since;          /**< Monotonic time (msec) at which it was checked in. */
+} bal_pool_idle;
+
+/** The connections a pool holds for one host and port. Outlives its pool while
+ * connections checked out from it remain open. */
+typedef struct _bal_pool_dest {
+    struct bal_pool* pool;   /**< Owning pool (NULL once it has been destroyed). */
+    char* host;              /**< Host name or address (owned). */
+    char* port;              /**< Service name or port (owned). */
+    bal_pool_idle* idle;     /**< Idle connections, most recently used last. */
+    size_t nidle;            /**< Entries in `idle`. */
+    size_t total;            /**< Connections attributed to this destination. */
+    bal_pool_req* pending;   /**< Checkouts that have been assigned a connection. */
+    bal_pool_req* waiters;   /**< Checkouts waiting for a free slot (FIFO). */
+    bal_pool_req* waiters_tail; /**< Last entry in `waiters`. */
+    struct _bal_pool_dest* next;
+} bal_pool_dest;
+
+/** A client connection pool, keyed by destination. Guarded by the async I/O
+ * mutex, since connections are handed over on the event thread. */
+typedef struct bal_pool {
+    bal_pool_cfg cfg;        /**< Limits (defaults applied). */
+    bal_pool_dest* dests;    /**< Destinations seen so far. */
+    bal_pool_stats stats;    /**< Running statistics (`idle` and `busy` are computed). */
+} bal_pool;
+
+/** A list of addresses, stored contiguously. Short lists fit in `addrs`;
+ * longer ones are held in a single heap block. */
+typedef struct _bal_addrlist {
+    bal_sockaddr* heap;      /**< Storage for more than BAL_ADDRLIST_INLINE addresses. */
+    size_t count;            /**< Number of addresses. */
+    size_t iter;             /**< Index of the next address to enumerate. */
+    bal_sockaddr addrs[BAL_ADDRLIST_INLINE]; /**< Inline storage for short lists. */
 } bal_addrlist;
 
 typedef struct {
@@ -79,20 +292,169 @@ typedef struct {
     char message[BAL_MAXERRORFMT];
 } bal_error;
 
-/** The internal error type. */
+/** The internal error type. Only codes and the location are recorded; messages
+ * are produced on demand by bal_get_error/bal_get_error_ext. */
 typedef struct {
     int code;
     struct {
         const char* func;
-        const char* file;
+        const char* file;        /**< As given by __FILE__ (the path is trimmed later). */
         uint32_t line;
     } loc;
     struct {
         int code;
-        char msg[BAL_MAXERROR];
+        bool gai;                /**< Whether `code` is a getaddrinfo (EAI_*) error. */
     } os;
 } bal_thread_error_info;
 
+/** A queued asynchronous name resolution request. */
+typedef struct _bal_resolve_req {
+    char* host;              /**< Host name or address (owned). */
+    char* port;              /**< Service name or port (owned, may be NULL). */
+    int addr_fam;            /**< Address family hint. */
+    int type;                /**< Socket type hint. */
+    bal_resolve_cb cb;       /**< Completion callback (bal_resolve_async). */
+    void* ctx;               /**< Passed to `cb`. */
+    struct bal_socket* s;    /**< Socket to connect (bal_connect_async). */
+    bal_descriptor sd;       /**< Descriptor of `s` when the request was made. */
+    bal_addrlist addrs;      /**< The result. */
+    bool ok;                 /**< Whether resolution succeeded. */
+    bal_thread_error_info err; /**< The resolver thread's error, if it failed. */
+    struct _bal_resolve_req* next;
+} bal_resolve_req;
+
+/** Asynchronous name resolution thread pool. */
+typedef struct {
+    bal_mutex mutex;         /**< Guards everything below. */
+    bal_condition cond;      /**< Signaled when requests are queued (or on exit). */
+    bal_thread threads[BAL_RESOLVER_THREADS]; /**< Resolver threads. */
+    size_t nthreads;         /**< Number of running resolver threads. */
+    bal_resolve_req* pending; /**< Requests awaiting a thread (FIFO). */
+    bal_resolve_req* pending_tail; /**< Last entry in `pending`. */
+    bal_resolve_req* done;   /**< Completed requests awaiting delivery. */
+    bool die;                /**< Set when the threads should exit. */
+} bal_resolver;
+
+/** An entry in a bal_cache. */
+typedef struct _bal_cache_entry {
+    char* key;               /**< Lookup key (owned). */
+    uint32_t hash;           /**< Hash of `key`. */
+    void* data;              /**< Cached value (owned; NULL if negative). */
+    size_t len;              /**< Size of `data`, in bytes. */
+    bool negative;           /**< Whether this entry records a failed lookup. */
+    bal_thread_error_info err; /**< The error to report for a negative entry. */
+    uint64_t expires;        /**< Monotonic time (msec) at which the entry expires. */
+    struct _bal_cache_entry* chain; /**< Next entry in the same hash bucket. */
+    struct _bal_cache_entry* prev;  /**< Previous entry in LRU order. */
+    struct _bal_cache_entry* next;  /**< Next entry in LRU order. */
+} bal_cache_entry;
+
+/** Cache statistics. */
+typedef struct {
+    uint64_t hits;           /**< Lookups answered by a positive entry. */
+    uint64_t negative_hits;  /**< Lookups answered by a negative entry. */
+    uint64_t misses;         /**< Lookups that found nothing (or an expired entry). */
+    uint64_t evictions;      /**< Entries discarded to stay within the size limit. */
+    uint64_t expirations;    /**< Entries discarded because they outlived their TTL. */
+    size_t entries;          /**< Entries currently held. */
+} bal_cache_stats;
+
+/** Library-wide statistics (see bal_get_stats). */
+typedef struct {
+    uint64_t sockets;        /**< Sockets currently registered for asynchronous I/O. */
+    uint64_t events[BAL_EVT_COUNT]; /**< Events dispatched, indexed by BAL_EVT_* bit
+                              * number (e.g. [0] is BAL_EVT_READ). */
+    uint64_t polls;          /**< Times the event thread returned from poll. */
+    uint64_t poll_nsec;      /**< Time spent waiting in poll, in nanoseconds. */
+    uint64_t callbacks;      /**< Callbacks invoked. */
+    uint64_t callback_nsec;  /**< Time spent in callbacks, in nanoseconds. */
+    uint64_t slow_callbacks; /**< Callbacks that exceeded the budget (see
+                              * bal_set_callback_budget). */
+    uint64_t allocs;         /**< Memory (re)allocations made. */
+    uint64_t alloc_bytes;    /**< Bytes requested by those allocations. */
+} bal_stats;
+
+/** Per-socket statistics (see bal_get_socket_stats). */
+typedef struct {
+    uint64_t sends;          /**< Successful send calls. */
+    uint64_t bytes_sent;     /**< Bytes sent (or accepted for coalescing). */
+    uint64_t send_wouldblock; /**< Send calls that would have blocked. */
+    uint64_t recvs;          /**< Successful receive calls. */
+    uint64_t bytes_recv;     /**< Bytes received. */
+    uint64_t recv_wouldblock; /**< Receive calls that would have blocked. */
+    uint64_t events;         /**< Events delivered to the socket's callback. */
+} bal_socket_stats;
+
+/** A snapshot of a latency histogram, in nanoseconds (see bal_get_histogram). */
+typedef struct {
+    uint64_t counts[BAL_HIST_BUCKETS]; /**< Samples per bucket; bucket n holds values
+                              * from bal_histogram_bucket_min(n) up to the next
+                              * bucket's minimum. */
+    uint64_t total;          /**< Number of samples. */
+    uint64_t sum;            /**< Sum of all samples. */
+    uint64_t max;            /**< Largest sample. */
+} bal_histogram;
+
+/** Contention statistics for one lock site (see bal_get_lock_stats). A lock site
+ * is a place in the library that locks a mutex, named for its function. */
+typedef struct {
+    const char* site;        /**< The lock site's name (static storage). */
+    uint64_t acquisitions;   /**< Times the mutex was locked there. */
+    uint64_t wait_nsec;      /**< Time spent waiting to lock it, in nanoseconds. */
+    uint64_t max_wait_nsec;  /**< Longest wait. */
+    uint64_t hold_nsec;      /**< Time spent holding it, in nanoseconds. */
+    uint64_t max_hold_nsec;  /**< Longest hold. */
+} bal_lock_stats;
+
+/** Latency histogram counters. */
+typedef struct {
+    bal_counter counts[BAL_HIST_BUCKETS]; /**< Samples per bucket. */
+    bal_counter total;       /**< Number of samples. */
+    bal_counter sum;         /**< Sum of all samples. */
+    bal_counter max;         /**< Largest sample. */
+} bal_histcounters;
+
+/** Called from the event thread after a callback runs longer than the budget set by
+ * bal_set_callback_budget: the socket's descriptor, the events it was given, how
+ * long it took (in nanoseconds), and the context pointer. The socket may no longer
+ * exist. */
+typedef void (*bal_slow_cb)(bal_descriptor /*sd*/, uint32_t /*events*/,
+    uint64_t /*nsec*/, void* /*ctx*/);
+
+/** Slow callback watchdog settings (guarded by the async I/O mutex). */
+typedef struct {
+    uint64_t budget;         /**< Longest acceptable callback, in nsec (0 = no limit). */
+    bal_slow_cb cb;          /**< Called for each slower callback (may be NULL). */
+    void* ctx;               /**< Passed to `cb`. */
+} bal_watchdog;
+
+/** Library-wide statistics counters. */
+typedef struct {
+    bal_counter events[BAL_EVT_COUNT]; /**< Events dispatched, by bit number. */
+    bal_counter polls;       /**< Returns from poll. */
+    bal_counter poll_nsec;   /**< Time spent in poll. */
+    bal_counter callbacks;   /**< Callbacks invoked. */
+    bal_counter callback_nsec; /**< Time spent in callbacks. */
+    bal_counter slow_callbacks; /**< Callbacks that exceeded the budget. */
+    bal_histcounters hists[BAL_HIST_COUNT]; /**< Latency histograms (BAL_HIST_*). */
+    bal_counter allocs;      /**< Memory (re)allocations. */
+    bal_counter alloc_bytes; /**< Bytes requested by allocations. */
+} bal_counters;
+
+/** A bounded, thread-safe key/value cache with LRU eviction and per-entry
+ * expiration. */
+typedef struct {
+    bal_mutex mutex;         /**< Guards everything below. */
+    bal_cache_entry** buckets; /**< Hash table (allocated on first insertion). */
+    size_t nbuckets;         /**< Number of buckets (a power of two). */
+    size_t max;              /**< Most entries held; 0 disables the cache. */
+    uint32_t ttl;            /**< Lifetime of positive entries, in msec. */
+    uint32_t neg_ttl;        /**< Lifetime of negative entries, in msec. */
+    bal_cache_entry* head;   /**< Most recently used entry. */
+    bal_cache_entry* tail;   /**< Least recently used entry. */
+    bal_cache_stats stats;   /**< Running statistics. */
+} bal_cache;
+
 /* Node type for bal_list. */
 typedef struct _bal_list_node {
     bal_descriptor key;
@@ -105,6 +467,7 @@ typedef struct _bal_list_node {
 typedef struct {
     bal_list_node* head;
     bal_list_node* iter;
+    size_t count;
 } bal_list;
 
 /* Iteration callback. Returns false to stop iteration. */
@@ -127,8 +490,84 @@ typedef struct {
 # else
     volatile bool die;
 # endif
+    bal_coalescer* flushq; /** Coalesced writes awaiting a flush. */
+    bal_race* raceq;      /** Sockets with a connection race in progress. */
+    bal_descriptor wake[2]; /** Read/write ends used to interrupt poll. */
 } bal_as_container;
 
+# if defined(__HAVE_ASYNC_DBGLOG__) && !defined(__cplusplus)
+/** A captured debug log argument. */
+typedef union {
+    intmax_t i;              /**< Signed integers (and %c). */
+    uintmax_t u;             /**< Unsigned integers. */
+    double d;                /**< Floating point. */
+    const void* p;           /**< %p. */
+    size_t str;              /**< %s: offset into bal_log_record.strs. */
+} bal_log_arg;
+
+/** A debug log message, captured by the logging thread and formatted later
+ * by the log thread. */
+typedef struct {
+    const char* func;        /**< Function name (static storage). */
+    const char* file;        /**< File name (static storage). */
+    const char* format;      /**< Format string (static storage), or NULL if
+                              * the message was formatted into `strs`. */
+    uint32_t line;           /**< Line number. */
+    size_t nargs;            /**< Number of entries in `args`. */
+    bal_log_arg args[BAL_DBGLOG_MAXARGS]; /**< The arguments, in order. */
+    char strs[BAL_DBGLOG_STRBYTES]; /**< Copies of string arguments. */
+} bal_log_record;
+
+/** A single-producer/single-consumer queue of log records, owned by one
+ * thread and drained by the log thread. */
+typedef struct _bal_log_ring {
+    atomic_size_t head;      /**< Next record to consume (log thread). */
+    atomic_size_t tail;      /**< Next record to fill (owning thread). */
+    atomic_uint_fast64_t dropped; /**< Records discarded because the ring was full. */
+    uint_fast64_t reported;  /**< Drops already reported (log thread). */
+    atomic_bool orphaned;    /**< Set when the owning thread exits. */
+    pid_t tid;               /**< The owning thread's identifier. */
+    struct _bal_log_ring* next; /**< Next ring in the registry. */
+    bal_log_record recs[BAL_DBGLOG_RINGSIZE];
+} bal_log_ring;
+# endif
+
+# if defined(__HAVE_BAL_TRACE__) && !defined(__cplusplus)
+/** One trace event. Whether it has a duration depends upon its type. */
+typedef struct {
+    uint64_t ts;             /**< When the event began (monotonic nanoseconds). */
+    uint32_t dur;            /**< How long it lasted, in nanoseconds. */
+    uint32_t arg;            /**< BAL_EVT_* bits, the result of poll, or the listener. */
+    uint32_t sd;             /**< Socket descriptor involved, if any. */
+    uint8_t type;            /**< BAL_TRACE_* event type. */
+} bal_trace_record;
+
+/** The trace events recorded by one thread; once full, the oldest records are
+ * overwritten. */
+typedef struct _bal_trace_ring {
+    atomic_uint_fast64_t count; /**< Records written so far (owning thread). */
+    atomic_bool orphaned;    /**< Set when the owning thread exits. */
+    pid_t tid;               /**< The owning thread's identifier. */
+    const char* name;        /**< The owning thread's name (static storage), or NULL. */
+    struct _bal_trace_ring* next; /**< Next ring in the registry. */
+    bal_trace_record recs[BAL_TRACE_RINGSIZE];
+} bal_trace_ring;
+# endif
+
+# if defined(__HAVE_BAL_LOCKPROF__) && !defined(__cplusplus)
+/** Contention counters for one lock site (static storage, registered on first use). */
+typedef struct _bal_locksite {
+    const char* name;        /**< The lock site's name. */
+    atomic_bool registered;  /**< Set once the site is in the registry. */
+    bal_counter acquisitions; /**< Times the mutex was locked. */
+    bal_counter wait;        /**< Nanoseconds spent waiting to lock it. */
+    bal_counter max_wait;    /**< Longest wait. */
+    bal_counter hold;        /**< Nanoseconds spent holding it. */
+    bal_counter max_hold;    /**< Longest hold. */
+    struct _bal_locksite* next; /**< Next site in the registry. */
+} bal_locksite;
+# endif
+
 typedef struct {
     bal_mutex mutex;
 # if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
@@ -28,9 +28,7 @@
 using namespace std;
 using namespace bal;
 using namespace bal::common;
-using namespace bal::server;
-
-static client_map _clients;
+using namespace bal::sample;
 
 int main(int argc, char** argv)
 {
@@ -44,92 +42,9 @@ int main(int argc, char** argv)
             throw bal::exception("failed to initialize bal::common");
         }
 
-        string send_buffer;
         initializer balinit;
-
-        auto client_on_read = [&send_buffer](scoped_socket* sock)
-        {
-            constexpr size_t buf_size = 2048;
-            std::array<char, buf_size> buf {};
-
-            if (ssize_t read = sock->recv(buf.data(), buf.size() - 1, 0); read > 0) {
-                PRINT_SD("read %ld bytes: '%s'", sock->get_descriptor(), read, buf.data());
-                send_buffer = "You said '";
-                send_buffer += buf.data();
-                send_buffer += "'; acknowledged.";
-                sock->want_write_events(true);
-            } else if (-1 == read) {
-                const auto err = sock->get_error(false);
-                PRINT_SD("read error %d (%s)!", sock->get_descriptor(), err.code,
-                    err.message.c_str());
-            } else {
-                PRINT_SD("read EOF", sock->get_descriptor());
-            }
-
-            return true;
-        };
-
-        auto client_on_write = [&send_buffer](scoped_socket* sock)
-        {
-            if (!send_buffer.empty()) {
-                if (ssize_t sent = sock->send(send_buffer.data(), send_buffer.size(),
-                    MSG_NOSIGNAL); sent > 0) {
-                    PRINT_SD("wrote %ld bytes", sock->get_descriptor(), sent);
-                } else {
-                    const auto err = sock->get_error(false);
-                    PRINT_SD("write error %d (%s)!", sock->get_descriptor(), err.code,
-                        err.message.c_str());
-                }
-                send_buffer.clear();
-            }
-
-            sock->want_write_events(false);
-            return true;
-        };
-
-        auto client_on_close = [](scoped_socket* sock)
-        {
-            on_client_disconnect(sock->get(), false);
-            sock->close();
-            return false;
-        };
-
-        auto client_on_error = [](scoped_socket* sock)
-        {
-            on_client_disconnect(sock->get(), true);
-            sock->close();
-            return false;
-        };
-
-        scoped_socket main_sock {AF_INET, SOCK_STREAM, IPPROTO_TCP};
-        main_sock.on_incoming_conn = [=](scoped_socket* sock)
-        {
-            scoped_socket client_sock;
-            address client_addr {};
-            sock->accept(client_sock, client_addr);
-
-            client_sock.on_read  = client_on_read;
-            client_sock.on_write = client_on_write;
-            client_sock.on_close = client_on_close;
-            client_sock.on_error = client_on_error;
-
-            client_sock.async_poll(BAL_EVT_NORMAL);
-
-            address_info addrinfo = client_addr.get_address_info();
-            PRINT("got connection from %s %s:%s on " BAL_SOCKET_SPEC " (0x%" PRIxPTR ");"
-                " now have %zu client(s)", addrinfo.get_type().c_str(),
-                addrinfo.get_addr().c_str(), addrinfo.get_port().c_str(),
-                client_sock.get_descriptor(), bit_cast<uintptr_t>(client_sock.get()),
-                _clients.size() + 1);
-
-            _clients[client_sock.get_descriptor()] = std::move(client_sock);
-            return true;
-        };
-
-        main_sock.set_reuseaddr(1);
-        main_sock.bind_all(portnum);
-        main_sock.async_poll(BAL_EVT_NORMAL);
-        main_sock.listen(SOMAXCONN);
+        ack_handler::server_type srv;
+        srv.start("0.0.0.0", portnum);
 
         PRINT("listening on %s; ctrl+c to exit...", portnum);
 
@@ -138,10 +53,10 @@ int main(int argc, char** argv)
             bal_thread_yield();
         } while (should_run());
 
-        if (!_clients.empty()) {
-            PRINT("closing/destroying %zu socket(s)...", _clients.size());
-            _clients.clear();
+        if (const auto count = srv.get_connection_count(); count > 0U) {
+            PRINT("closing %zu connection(s)...", count);
         }
+        srv.stop();
 
         return EXIT_SUCCESS;
     } catch (bal::exception& ex) {
@@ -150,30 +65,28 @@ int main(int argc, char** argv)
     }
 }
 
-scoped_socket* bal::server::get_existing_client(bal_descriptor sd)
+void bal::sample::ack_handler::on_connect(server_type::connection& conn)
 {
-    if (const auto it = _clients.find(sd); it != _clients.end()) {
-        return &it->second;
-    }
-
-    return nullptr;
+    PRINT("got connection from %s (id %" PRIx64 ")", conn.get_peer().to_string().c_str(),
+        conn.get_id());
 }
 
-void bal::server::rem_existing_client(bal_descriptor sd)
+void bal::sample::ack_handler::on_data(server_type::connection& conn,
+    std::span<const std::byte> data)
 {
-    if (_clients.erase(sd) > 0) {
-        PRINT("now have %zu client(s)", _clients.size());
-    }
+    const string_view text(reinterpret_cast<const char*>(data.data()), data.size());
+    PRINT("read %zu bytes from %s: '%.*s'", data.size(), conn.get_peer().to_string().c_str(),
+        static_cast<int>(text.size()), text.data());
+
+    _reads++;
+    string reply = "You said '";
+    reply += text;
+    reply += "'; acknowledged (#" + to_string(_reads) + ").";
+    conn.send(reply);
 }
 
-void bal::server::on_client_disconnect(const bal_socket* s, bool error)
+void bal::sample::ack_handler::on_disconnect(server_type::connection& conn)
 {
-    if (error) {
-        const auto code = bal_get_sock_error(s);
-        PRINT_SD("connection closed with error: %d!", s->sd, code);
-    } else {
-        PRINT_SD("connection closed", s->sd);
-    }
-
-    rem_existing_client(s->sd);
+    PRINT("connection from %s closed after %zu read(s)", conn.get_peer().to_string().c_str(),
+        _reads);
 }
@@ -27,16 +27,23 @@
 # define _BAL_SERVER_HH_INCLUDED
 
 # include "balcommon.hh"
-# include <utility>
-# include <map>
+# include <span>
 
-namespace bal::server
+namespace bal::sample
 {
-    using client_map = std::map<bal_descriptor, scoped_socket>;
+    /** Per-connection state: acknowledges everything a client sends. */
+    class ack_handler
+    {
+    public:
+        using server_type = bal::server<ack_handler>;
 
-    scoped_socket* get_existing_client(bal_descriptor sd);
-    void rem_existing_client(bal_descriptor sd);
-    void on_client_disconnect(const bal_socket* s, bool error);
-} // !namespace bal::server
+        void on_connect(server_type::connection& conn);
+        void on_data(server_type::connection& conn, std::span<const std::byte> data);
+        void on_disconnect(server_type::connection& conn);
+
+    private:
+        size_t _reads = 0U;
+    };
+} // !namespace bal::sample
 
 #endif // !_BAL_SERVER_HH_INCLUDED
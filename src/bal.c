@@ -111,6 +111,13 @@ bool bal_cleanup(void)
         cleanup = false;
     }
 
+    _bal_cache_destroy(&_bal_rescache);
+    _bal_cache_destroy(&_bal_rdnscache);
+
+#if defined(__HAVE_ASYNC_DBGLOG__)
+    _bal_log_flush();
+#endif
+
 #if defined(__HAVE_STDATOMICS__)
     atomic_store(&_bal_state.magic, 0U);
 #else
@@ -153,12 +160,18 @@ bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask)
     _BAL_LOCK_MUTEX(&_bal_as_container.mutex, aspoll);
 
     if (0U == mask) {
-        /* this thread holds the mutex for the list, so it can remove an iterator. */
+        /* this thread holds the mutex for the list, so it can remove an iterator.
+         * not finding s is no misuse (the event thread removes sockets that close
+         * or become invalid on its own), and by then its descriptor may belong to
+         * another socket, which must stay. */
         bal_socket* d = NULL;
-        bool success  = _bal_list_remove(_bal_as_container.lst, s->sd, &d);
-        BAL_ASSERT(NULL != d && s == d);
+        bool success  = _bal_list_find(_bal_as_container.lst, s->sd, &d) && s == d &&
+                        _bal_list_remove(_bal_as_container.lst, s->sd, &d);
 
         if (success) {
+            _bal_probe1(socket__remove, s->sd);
+            /* a pending bal_connect_async won't be completed now. */
+            bal_setbitslow(&s->state.bits, BAL_S_RESOLVE);
             /* The iterator is kaput, but s is still allocated. Since this is a
              * removal request (mask = 0), don't close or delete the socket. */
             _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list", s->sd, d);
@@ -183,6 +196,7 @@ bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask)
                 retval  = success;
             }
             if (success) {
+                _bal_probe2(socket__register, s->sd, mask);
                 _bal_dbglog("added socket "BAL_SOCKET_SPEC" to list (%p"
                             ", mask = %08"PRIx32")", s->sd, s, s->state.mask);
             } else {
@@ -203,13 +217,16 @@ bool bal_create(bal_socket** s, uintptr_t user_data, int addr_fam, int type, int
     bool retval = false;
 
     if (_bal_okptrptr(s)) {
-        *s = calloc(1, sizeof(bal_socket));
+        *s = _bal_calloc(1, sizeof(bal_socket));
         if (!_bal_okptrnf(*s)) {
             _bal_handlelasterr();
+        } else if (!_bal_sockstats_create(*s)) {
+            _bal_safefree(s);
         } else {
             (*s)->sd = socket(addr_fam, type, proto);
             if (-1 == (*s)->sd) {
                 _bal_handlelasterr();
+                _bal_sockstats_destroy(*s);
                 _bal_safefree(s);
             } else {
                 (*s)->addr_fam  = addr_fam;
@@ -270,6 +287,7 @@ void bal_destroy(bal_socket** s)
             bool removed  = _bal_list_remove(_bal_as_container.lst, (*s)->sd, &d);
 
             if (removed) {
+                _bal_probe1(socket__remove, (*s)->sd);
                 BAL_ASSERT(*s == d);
                 _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list",
                     (*s)->sd, *s);
@@ -283,6 +301,14 @@ void bal_destroy(bal_socket** s)
             _bal_dbglog("freeing socket "BAL_SOCKET_SPEC" (%p)", (*s)->sd, *s);
         }
 
+        _bal_framer_destroy(&(*s)->state.framer);
+        _bal_coalescer_destroy(&(*s)->state.coalesce);
+        _bal_tstamp_destroy(&(*s)->state.tstamp);
+        _bal_race_destroy(&(*s)->state.race);
+        _bal_arena_destroy(&(*s)->state.arena);
+        _bal_pool_release(*s);
+        _bal_sockstats_destroy(*s);
+
         memset(*s, 0, sizeof(bal_socket));
         _bal_safefree(s);
 
@@ -296,6 +322,23 @@ bool bal_close(bal_socket** s, bool destroy)
     bool retval = false;
 
     if (_bal_okptrptr(s) && _bal_oksock(*s)) {
+        /* give anything sent by a callback just before closing a chance to go
+         * out; whatever would block at this point is discarded, so that the
+         * event thread doesn't later send it on a closed (or reused)
+         * descriptor. */
+        if (NULL != (*s)->state.coalesce) {
+            _BAL_MUTEX_COUNTER_INIT(closecoalesce);
+            _BAL_LOCK_MUTEX(&_bal_as_container.mutex, closecoalesce);
+            if (_bal_coalescer_pending((*s)->state.coalesce))
+                (void)bal_flush(*s);
+            _bal_coalescer_discard((*s)->state.coalesce);
+            _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, closecoalesce);
+            _BAL_MUTEX_COUNTER_CHECK(closecoalesce);
+        }
+
+        /* attempts still racing to connect are abandoned. */
+        _bal_race_cancel(*s);
+
 #if defined(__WIN__)
         if (SOCKET_ERROR == closesocket((*s)->sd)) {
             _bal_handlelasterr();
@@ -308,8 +351,9 @@ bool bal_close(bal_socket** s, bool destroy)
         else {
             _bal_dbglog("closed socket "BAL_SOCKET_SPEC" (%p, mask = %08"PRIx32")",
                 (*s)->sd, *s, (*s)->state.mask);
+            _bal_trace_instant(BAL_TRACE_CLOSE, (*s)->sd, 0U);
             bal_setbitshigh(&(*s)->state.bits, BAL_S_CLOSE);
-            bal_setbitslow(&(*s)->state.bits, BAL_S_CONNECT | BAL_S_LISTEN);
+            bal_setbitslow(&(*s)->state.bits, BAL_S_CONNECT | BAL_S_LISTEN | BAL_S_RESOLVE);
             retval = true;
         }
 
@@ -325,6 +369,9 @@ bool bal_shutdown(bal_socket* s, int how)
     bool retval = false;
 
     if (_bal_oksock(s)) {
+        if (BAL_SHUT_RD != how && _bal_coalescer_pending(s->state.coalesce))
+            (void)bal_flush(s);
+
         if (-1 == shutdown(s->sd, how)) {
             _bal_handlelasterr();
         } else {
@@ -350,14 +397,10 @@ bool bal_connect(bal_socket* s, const char* host, const char* port)
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okstr(host) && _bal_okstr(port)) {
-        struct addrinfo* ai = NULL;
-        if (_bal_get_addrinfo(0, s->addr_fam, s->type, host, port, &ai)) {
-            bal_addrlist al = {NULL, NULL};
-            if (_bal_addrinfo_to_addrlist(ai, &al)) {
-                retval = bal_connect_addrlist(s, &al);
-                bal_free_addrlist(&al);
-            }
-            freeaddrinfo(ai);
+        bal_addrlist al = {0};
+        if (_bal_resolve_addrlist(0, s->addr_fam, s->type, host, port, &al)) {
+            retval = bal_connect_addrlist(s, &al);
+            bal_free_addrlist(&al);
         }
     }
 
@@ -377,6 +420,7 @@ bool bal_connect_addrlist(bal_socket* s, bal_addrlist* al)
 #else
             if (!ret || EAGAIN == errno || EINPROGRESS == errno) {
 #endif
+                _bal_trace_instant(BAL_TRACE_CONNECT, s->sd, 0U);
                 bal_setbitshigh(&s->state.mask, BAL_EVT_WRITE);
                 bal_setbitshigh(&s->state.bits, BAL_S_CONNECT);
                 retval = true;
@@ -395,9 +439,17 @@ ssize_t bal_send(const bal_socket* s, const void* data, bal_iolen len, int flags
     ssize_t sent = -1;
 
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
-        sent = send(s->sd, data, len, flags);
-        if (-1 == sent)
-            _bal_handlelasterr();
+        _bal_probe2(send__entry, s->sd, len);
+        if (NULL != s->state.coalesce) {
+            sent = _bal_coalescer_send(s, data, len, flags);
+            _bal_count_send(s, sent);
+        } else {
+            sent = send(s->sd, data, len, flags);
+            _bal_count_send(s, sent);
+            if (-1 == sent)
+                _bal_handlelastioerr();
+        }
+        _bal_probe2(send__return, s->sd, sent);
     }
 
     return sent;
@@ -408,14 +460,63 @@ ssize_t bal_recv(const bal_socket* s, void* data, bal_iolen len, int flags)
     ssize_t read = -1;
 
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
+        _bal_probe2(recv__entry, s->sd, len);
         read = recv(s->sd, data, len, flags);
+        _bal_count_recv(s, read);
         if (0 >= read)
-            _bal_handlelasterr();
+            _bal_handlelastioerr();
+        _bal_probe2(recv__return, s->sd, read);
     }
 
     return read;
 }
 
+bal_io_result bal_try_send(const bal_socket* s, const void* data, bal_iolen len, int flags)
+{
+    bal_io_result res = {BAL_IO_ERROR, 0U};
+
+    if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
+        /* the coalescer records its own errors. */
+        _bal_probe2(send__entry, s->sd, len);
+        bool coalesce = NULL != s->state.coalesce;
+        ssize_t sent  = coalesce ? _bal_coalescer_send(s, data, len, flags)
+                                 : send(s->sd, data, len, flags);
+        _bal_count_send(s, sent);
+        _bal_probe2(send__return, s->sd, sent);
+        if (sent >= 0) {
+            res.bytes  = (size_t)sent;
+            res.status = (size_t)sent < (size_t)len ? BAL_IO_PARTIAL : BAL_IO_OK;
+        } else {
+            res.status = _bal_io_failed(!coalesce);
+        }
+    }
+
+    return res;
+}
+
+bal_io_result bal_try_recv(const bal_socket* s, void* data, bal_iolen len, int flags)
+{
+    bal_io_result res = {BAL_IO_ERROR, 0U};
+
+    if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
+        _bal_probe2(recv__entry, s->sd, len);
+        ssize_t read = recv(s->sd, data, len, flags);
+        _bal_count_recv(s, read);
+        _bal_probe2(recv__return, s->sd, read);
+        if (read > 0) {
+            res.bytes  = (size_t)read;
+            res.status = BAL_IO_OK;
+        } else if (0 == read) {
+            /* an empty datagram is not the end of anything. */
+            res.status = SOCK_STREAM == s->type ? BAL_IO_EOF : BAL_IO_OK;
+        } else {
+            res.status = _bal_io_failed(true);
+        }
+    }
+
+    return res;
+}
+
 ssize_t bal_sendto(const bal_socket* s, const char* host, const char* port,
     const void* data, bal_iolen len, int flags)
 {
@@ -423,13 +524,10 @@ ssize_t bal_sendto(const bal_socket* s, const char* host, const char* port,
 
     if (_bal_oksock(s) && _bal_okstr(host) && _bal_okstr(port) &&
         _bal_okptr(data) && _bal_oklen(len)) {
-        struct addrinfo* ai = NULL;
-        int gai_flags = AI_NUMERICSERV;
-        bool get = _bal_get_addrinfo(gai_flags, PF_UNSPEC, SOCK_DGRAM, host, port, &ai);
-        if (get && NULL != ai) {
-            sent = bal_sendto_addr(s, (const bal_sockaddr*)ai->ai_addr, data, len, flags);
-            freeaddrinfo(ai);
-        }
+        bal_sockaddr sa = {0};
+        if (0U != _bal_resolve_addrs(AI_NUMERICSERV, PF_UNSPEC, SOCK_DGRAM, host,
+            port, &sa, 1))
+            sent = bal_sendto_addr(s, &sa, data, len, flags);
     }
 
     return sent;
@@ -442,8 +540,9 @@ ssize_t bal_sendto_addr(const bal_socket* s, const bal_sockaddr* sa, const void*
 
     if (_bal_oksock(s) && _bal_okptr(sa) && _bal_okptr(data) && _bal_oklen(len)) {
         sent = sendto(s->sd, data, len, flags, (const struct sockaddr*)sa, _BAL_SASIZE(*sa));
+        _bal_count_send(s, sent);
         if (-1 == sent)
-            _bal_handlelasterr();
+            _bal_handlelastioerr();
     }
 
    return sent;
@@ -457,8 +556,9 @@ ssize_t bal_recvfrom(const bal_socket* s, void* data, bal_iolen len, int flags,
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
         socklen_t sasize = sizeof(bal_sockaddr);
         read = recvfrom(s->sd, data, len, flags, (struct sockaddr*)res, &sasize);
+        _bal_count_recv(s, read);
         if (0 >= read)
-            _bal_handlelasterr();
+            _bal_handlelastioerr();
     }
 
     return read;
@@ -469,22 +569,31 @@ bool bal_bind(const bal_socket* s, const char* addr, const char* srv)
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okstr(addr) && _bal_okstr(srv)) {
-        struct addrinfo* ai = NULL;
-        bool get = _bal_get_addrinfo(AI_NUMERICHOST, s->addr_fam, s->type, addr, srv, &ai);
-        if (get && NULL != ai) {
-            struct addrinfo* cur = ai;
-            do {
-                int ret = bind(s->sd, (const struct sockaddr*)cur->ai_addr, cur->ai_addrlen);
-                if (0 == ret) {
-                    retval = true;
-                    break;
-                } else {
-                    _bal_handlelasterr();
-                }
-                cur = cur->ai_next;
-            } while (NULL != cur);
-
-            freeaddrinfo(ai);
+        bal_sockaddr sa = {0};
+        if (_bal_parse_addr(addr, srv, &sa) && s->addr_fam == sa.ss_family) {
+            /* literal address and port; no need for getaddrinfo. */
+            int ret = bind(s->sd, (const struct sockaddr*)&sa, _BAL_SASIZE(sa));
+            if (0 != ret)
+                _bal_handlelasterr();
+            retval = 0 == ret;
+        } else {
+            struct addrinfo* ai = NULL;
+            bool get = _bal_get_addrinfo(AI_NUMERICHOST, s->addr_fam, s->type, addr, srv, &ai);
+            if (get && NULL != ai) {
+                struct addrinfo* cur = ai;
+                do {
+                    int ret = bind(s->sd, (const struct sockaddr*)cur->ai_addr, cur->ai_addrlen);
+                    if (0 == ret) {
+                        retval = true;
+                        break;
+                    } else {
+                        _bal_handlelasterr();
+                    }
+                    cur = cur->ai_next;
+                } while (NULL != cur);
+
+                freeaddrinfo(ai);
+            }
         }
     }
 
@@ -496,14 +605,26 @@ bool bal_bindall(const bal_socket* s, const char* srv)
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okstr(srv)) {
-        struct addrinfo* ai = NULL;
-        int flags = AI_PASSIVE | AI_NUMERICHOST;
-        bool get = _bal_get_addrinfo(flags, s->addr_fam, s->type, NULL, srv, &ai);
-        if (get && NULL != ai) {
-            int ret = bind(s->sd, (const struct sockaddr*)ai->ai_addr, ai->ai_addrlen);
+        bal_sockaddr sa = {0};
+        const char* any = PF_INET6 == s->addr_fam ? "::" : "0.0.0.0";
+        if ((PF_INET == s->addr_fam || PF_INET6 == s->addr_fam) &&
+            _bal_parse_addr(any, srv, &sa)) {
+            /* numeric port; no need for getaddrinfo. */
+            int ret = bind(s->sd, (const struct sockaddr*)&sa, _BAL_SASIZE(sa));
             if (0 != ret)
                 _bal_handlelasterr();
             retval = 0 == ret;
+        } else {
+            struct addrinfo* ai = NULL;
+            int flags = AI_PASSIVE | AI_NUMERICHOST;
+            bool get = _bal_get_addrinfo(flags, s->addr_fam, s->type, NULL, srv, &ai);
+            if (get && NULL != ai) {
+                int ret = bind(s->sd, (const struct sockaddr*)ai->ai_addr, ai->ai_addrlen);
+                if (0 != ret)
+                    _bal_handlelasterr();
+                retval = 0 == ret;
+                freeaddrinfo(ai);
+            }
         }
     }
 
@@ -532,9 +653,11 @@ bool bal_accept(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr)
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okptrptr(res) && _bal_okptr(resaddr)) {
-        *res = calloc(1, sizeof(bal_socket));
+        *res = _bal_calloc(1, sizeof(bal_socket));
         if (!_bal_okptrnf(*res)) {
             _bal_handlelasterr();
+        } else if (!_bal_sockstats_create(*res)) {
+            _bal_safefree(res);
         } else {
             socklen_t sasize = sizeof(bal_sockaddr);
             bal_descriptor sd = accept(s->sd, (struct sockaddr*)resaddr, &sasize);
@@ -544,8 +667,11 @@ bool bal_accept(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr)
                 (*res)->type     = s->type;
                 (*res)->proto    = s->proto;
                 retval           = true;
+                _bal_trace_instant(BAL_TRACE_ACCEPT, sd, (uint32_t)s->sd);
+                _bal_probe2(accept, s->sd, sd);
             } else {
                 _bal_handlelasterr();
+                _bal_sockstats_destroy(*res);
                 _bal_safefree(res);
             }
         }
@@ -856,12 +982,7 @@ bool bal_resolve_host(const char* host, bal_addrlist* out)
     bool retval = false;
 
     if (_bal_okstr(host) && _bal_okptr(out)) {
-        struct addrinfo* ai = NULL;
-        bool get = _bal_get_addrinfo(0, PF_UNSPEC, SOCK_STREAM, host, NULL, &ai);
-        if (get && NULL != ai) {
-            retval = _bal_addrinfo_to_addrlist(ai, out);
-            freeaddrinfo(ai);
-        }
+        retval = _bal_resolve_addrlist(0, PF_UNSPEC, SOCK_STREAM, host, NULL, out);
     }
 
     return retval;
@@ -917,17 +1038,20 @@ bool bal_get_addrstrings(const bal_sockaddr* in, bool dns, bal_addrstrings* out)
 
     if (_bal_okptr(in) && _bal_okptr(out)) {
         memset(out, 0, sizeof(bal_addrstrings));
-        bool get = _bal_getnameinfo(_BAL_NI_NODNS, in, out->addr, out->port);
-        if (get) {
-            if (dns && _bal_getnameinfo(_BAL_NI_DNS, in, out->host, out->port))
+        uint16_t port = PF_INET6 == in->ss_family
+            ? ((const struct sockaddr_in6*)in)->sin6_port
+            : ((const struct sockaddr_in*)in)->sin_port;
+        if (0U != _bal_format_ipaddr(in, out->addr, sizeof(out->addr)) &&
+            0U != _bal_format_port(ntohs(port), out->port, sizeof(out->port))) {
+            if (dns && !_bal_reverse_lookup(in, out->addr, out->host, sizeof(out->host)))
                 _bal_strcpy(out->host, NI_MAXHOST, BAL_UNKNOWN, sizeof(BAL_UNKNOWN));
-            if (PF_INET == ((const struct sockaddr*)in)->sa_family)
+            if (PF_INET == in->ss_family)
                 out->type = BAL_AS_IPV4;
-            else if (PF_INET6 == ((const struct sockaddr*)in)->sa_family)
-                out->type = BAL_AS_IPV6;
             else
-                out->type = BAL_UNKNOWN;
+                out->type = BAL_AS_IPV6;
             retval = true;
+        } else {
+            (void)_bal_seterror(_BAL_E_INVALIDARG);
         }
     }
 
@@ -939,7 +1063,7 @@ bool bal_reset_addrlist(bal_addrlist* addrs)
     bool retval = false;
 
     if (_bal_okptr(addrs)) {
-        addrs->iter = addrs->addr;
+        addrs->iter = 0;
         retval = true;
     }
 
@@ -950,10 +1074,9 @@ const bal_sockaddr* bal_enum_addrlist(bal_addrlist* addrs)
 {
     const bal_sockaddr* r = NULL;
 
-    if (_bal_okptr(addrs) && _bal_okptr(addrs->addr)) {
-        if (NULL != addrs->iter) {
-            r        = &addrs->iter->addr;
-            addrs->iter = addrs->iter->next;
+    if (_bal_okptr(addrs)) {
+        if (addrs->iter < addrs->count) {
+            r = &_bal_addrlist_data(addrs)[addrs->iter++];
         } else {
             bal_reset_addrlist(addrs);
         }
@@ -962,22 +1085,20 @@ const bal_sockaddr* bal_enum_addrlist(bal_addrlist* addrs)
     return r;
 }
 
+size_t bal_count_addrlist(const bal_addrlist* addrs)
+{
+    return _bal_okptr(addrs) ? addrs->count : 0U;
+}
+
 bool bal_free_addrlist(bal_addrlist* addrs)
 {
     bool retval = false;
 
     if (_bal_okptr(addrs)) {
-        bal_addr* a = NULL;
-        addrs->iter = addrs->addr;
-
-        while (NULL != addrs->iter) {
-            a = addrs->iter->next;
-            _bal_safefree(&addrs->iter);
-            addrs->iter = a;
-        }
-
-        addrs->addr = NULL;
-        retval   = true;
+        _bal_safefree(&addrs->heap);
+        addrs->count = 0;
+        addrs->iter  = 0;
+        retval       = true;
     }
 
     return retval;
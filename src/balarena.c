@@ -0,0 +1,177 @@
+/*
+ * balarena.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+/** Bytes reserved for a chunk's header, keeping its allocations aligned. */
+#define _BAL_ARENA_HDRSIZE \
+    ((sizeof(bal_arena_chunk) + BAL_ARENA_ALIGN - 1) & ~((size_t)BAL_ARENA_ALIGN - 1))
+
+static bool _bal_arena_create(bal_socket* s, size_t chunk_size);
+static bal_arena_chunk* _bal_arena_new_chunk(size_t size);
+
+/**
+ * Exported functions
+ */
+
+bool bal_set_arena(bal_socket* s, size_t chunk_size)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    if (0 == chunk_size)
+        chunk_size = BAL_ARENA_CHUNK;
+
+    if (NULL == s->state.arena)
+        return _bal_arena_create(s, chunk_size);
+
+    /* chunks already allocated are kept until the next reset. */
+    s->state.arena->chunk_size = chunk_size;
+    return true;
+}
+
+void* bal_arena_alloc(bal_socket* s, size_t size)
+{
+    if (!_bal_oksock(s))
+        return NULL;
+
+    if (0 == size || size > SIZE_MAX - _BAL_ARENA_HDRSIZE - BAL_ARENA_ALIGN) {
+        (void)_bal_seterror(_BAL_E_INVALIDARG);
+        return NULL;
+    }
+
+    if (NULL == s->state.arena && !_bal_arena_create(s, BAL_ARENA_CHUNK))
+        return NULL;
+
+    bal_arena* a = s->state.arena;
+    size_t need  = (size + BAL_ARENA_ALIGN - 1) & ~((size_t)BAL_ARENA_ALIGN - 1);
+    bal_arena_chunk* c = a->head;
+
+    if (NULL == c || c->size - c->used < need) {
+        if (need > a->chunk_size) {
+            /* too big for a regular chunk: it gets one of its own, placed behind
+             * the current chunk so that allocation continues there. */
+            bal_arena_chunk* big = _bal_arena_new_chunk(need);
+            if (NULL == big)
+                return NULL;
+
+            big->used = need;
+            if (NULL != c) {
+                big->next = c->next;
+                c->next   = big;
+            } else {
+                a->head = big;
+            }
+            return (uint8_t*)big + _BAL_ARENA_HDRSIZE;
+        }
+
+        c = _bal_arena_new_chunk(a->chunk_size);
+        if (NULL == c)
+            return NULL;
+
+        c->next = a->head;
+        a->head = c;
+    }
+
+    void* ptr = (uint8_t*)c + _BAL_ARENA_HDRSIZE + c->used;
+    c->used  += need;
+    return ptr;
+}
+
+bool bal_arena_reset(bal_socket* s)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    bal_arena* a = s->state.arena;
+    if (NULL == a)
+        return true;
+
+    /* keep one regular chunk for reuse, and free the rest. */
+    bal_arena_chunk* keep = NULL;
+    bal_arena_chunk* c    = a->head;
+    while (NULL != c) {
+        bal_arena_chunk* next = c->next;
+        if (NULL == keep && c->size == a->chunk_size) {
+            keep       = c;
+            keep->used = 0;
+            keep->next = NULL;
+        } else {
+            _bal_safefree(&c);
+        }
+        c = next;
+    }
+
+    a->head = keep;
+    return true;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_arena_destroy(bal_arena** a)
+{
+    if (_bal_okptrptrnf(a) && NULL != *a) {
+        bal_arena_chunk* c = (*a)->head;
+        while (NULL != c) {
+            bal_arena_chunk* next = c->next;
+            _bal_safefree(&c);
+            c = next;
+        }
+        _bal_safefree(a);
+    }
+}
+
+/**
+ * Static functions
+ */
+
+static bool _bal_arena_create(bal_socket* s, size_t chunk_size)
+{
+    bal_arena* a = _bal_calloc(1, sizeof(bal_arena));
+    if (!_bal_okptrnf(a))
+        return _bal_handlelasterr();
+
+    a->chunk_size  = chunk_size;
+    s->state.arena = a;
+    return true;
+}
+
+static bal_arena_chunk* _bal_arena_new_chunk(size_t size)
+{
+    bal_arena_chunk* c = _bal_malloc(_BAL_ARENA_HDRSIZE + size);
+    if (!_bal_okptrnf(c)) {
+        (void)_bal_handlelasterr();
+        return NULL;
+    }
+
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
@@ -0,0 +1,298 @@
+/*
+ * balcache.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+static uint32_t _bal_cache_hash(const char* key, size_t* len);
+static bal_cache_entry* _bal_cache_find(bal_cache* c, const char* key, size_t len,
+    uint32_t hash);
+static void _bal_cache_unlink(bal_cache* c, bal_cache_entry* e);
+static void _bal_cache_push_front(bal_cache* c, bal_cache_entry* e);
+static void _bal_cache_remove(bal_cache* c, bal_cache_entry* e);
+static void _bal_cache_free_entry(bal_cache_entry** e);
+
+/**
+ * Internal functions
+ */
+
+bool _bal_cache_configure(bal_cache* c, size_t max, uint32_t ttl, uint32_t neg_ttl)
+{
+    _BAL_MUTEX_COUNTER_INIT(cacheconf);
+    _BAL_LOCK_MUTEX(&c->mutex, cacheconf);
+
+    _bal_cache_flush(c);
+    _bal_safefree(&c->buckets);
+    c->nbuckets = 0;
+    c->max      = max;
+    c->ttl      = ttl;
+    c->neg_ttl  = neg_ttl;
+    memset(&c->stats, 0, sizeof(bal_cache_stats));
+
+    _BAL_UNLOCK_MUTEX(&c->mutex, cacheconf);
+    _BAL_MUTEX_COUNTER_CHECK(cacheconf);
+
+    return true;
+}
+
+int _bal_cache_get(bal_cache* c, const char* key, void* data, size_t* len,
+    bal_thread_error_info* err)
+{
+    int retval    = BAL_CACHE_MISS;
+    size_t keylen = 0;
+    uint32_t hash = _bal_cache_hash(key, &keylen);
+
+    _BAL_MUTEX_COUNTER_INIT(cacheget);
+    _BAL_LOCK_MUTEX(&c->mutex, cacheget);
+
+    if (0U != c->max) {
+        bal_cache_entry* e = _bal_cache_find(c, key, keylen, hash);
+        if (NULL != e && e->expires <= _bal_monotonic_msec()) {
+            _bal_cache_remove(c, e);
+            c->stats.expirations++;
+            e = NULL;
+        }
+
+        if (NULL == e) {
+            c->stats.misses++;
+        } else {
+            _bal_cache_unlink(c, e);
+            _bal_cache_push_front(c, e);
+
+            if (e->negative) {
+                c->stats.negative_hits++;
+                if (NULL != err)
+                    memcpy(err, &e->err, sizeof(bal_thread_error_info));
+                retval = BAL_CACHE_NEGATIVE;
+            } else {
+                c->stats.hits++;
+                memcpy(data, e->data, *len < e->len ? *len : e->len);
+                *len   = e->len;
+                retval = BAL_CACHE_HIT;
+            }
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&c->mutex, cacheget);
+    _BAL_MUTEX_COUNTER_CHECK(cacheget);
+
+    return retval;
+}
+
+void _bal_cache_put(bal_cache* c, const char* key, const void* data, size_t len,
+    const bal_thread_error_info* err)
+{
+    size_t keylen = 0;
+    uint32_t hash = _bal_cache_hash(key, &keylen);
+
+    _BAL_MUTEX_COUNTER_INIT(cacheput);
+    _BAL_LOCK_MUTEX(&c->mutex, cacheput);
+
+    uint32_t ttl = NULL != err ? c->neg_ttl : c->ttl;
+    bool ok      = 0U != c->max && 0U != ttl;
+
+    if (ok && NULL == c->buckets) {
+        size_t nbuckets = 16;
+        while (nbuckets < c->max)
+            nbuckets <<= 1;
+        c->buckets = _bal_calloc(nbuckets, sizeof(bal_cache_entry*));
+        ok         = _bal_okptrnf(c->buckets);
+        if (ok)
+            c->nbuckets = nbuckets;
+    }
+
+    bal_cache_entry* e = NULL;
+    if (ok) {
+        /* a concurrent lookup of the same key may have raced us here. */
+        e = _bal_cache_find(c, key, keylen, hash);
+        if (NULL != e)
+            _bal_cache_remove(c, e);
+
+        e = _bal_calloc(1, sizeof(bal_cache_entry));
+        if (_bal_okptrnf(e)) {
+            e->key  = _bal_calloc(keylen + 1, sizeof(char));
+            e->data = NULL != err || 0U == len ? NULL : _bal_malloc(len);
+            if (!_bal_okptrnf(e->key) || (NULL == err && 0U != len && NULL == e->data))
+                _bal_cache_free_entry(&e);
+        }
+    }
+
+    if (NULL != e) {
+        memcpy(e->key, key, keylen);
+        e->hash     = hash;
+        e->negative = NULL != err;
+        e->expires  = _bal_monotonic_msec() + ttl;
+        if (e->negative) {
+            memcpy(&e->err, err, sizeof(bal_thread_error_info));
+        } else {
+            if (0U != len)
+                memcpy(e->data, data, len);
+            e->len = len;
+        }
+
+        while (c->stats.entries >= c->max && NULL != c->tail) {
+            bool expired = c->tail->expires <= _bal_monotonic_msec();
+            _bal_cache_remove(c, c->tail);
+            if (expired) {
+                c->stats.expirations++;
+            } else {
+                c->stats.evictions++;
+            }
+        }
+
+        size_t bucket      = hash & (c->nbuckets - 1);
+        e->chain           = c->buckets[bucket];
+        c->buckets[bucket] = e;
+        _bal_cache_push_front(c, e);
+        c->stats.entries++;
+    }
+
+    _BAL_UNLOCK_MUTEX(&c->mutex, cacheput);
+    _BAL_MUTEX_COUNTER_CHECK(cacheput);
+}
+
+void _bal_cache_flush(bal_cache* c)
+{
+    _BAL_MUTEX_COUNTER_INIT(cacheflush);
+    _BAL_LOCK_MUTEX(&c->mutex, cacheflush);
+
+    while (NULL != c->head)
+        _bal_cache_remove(c, c->head);
+
+    _BAL_UNLOCK_MUTEX(&c->mutex, cacheflush);
+    _BAL_MUTEX_COUNTER_CHECK(cacheflush);
+}
+
+void _bal_cache_get_stats(bal_cache* c, bal_cache_stats* out)
+{
+    _BAL_MUTEX_COUNTER_INIT(cachestats);
+    _BAL_LOCK_MUTEX(&c->mutex, cachestats);
+    memcpy(out, &c->stats, sizeof(bal_cache_stats));
+    _BAL_UNLOCK_MUTEX(&c->mutex, cachestats);
+    _BAL_MUTEX_COUNTER_CHECK(cachestats);
+}
+
+void _bal_cache_destroy(bal_cache* c)
+{
+    _BAL_MUTEX_COUNTER_INIT(cachedestroy);
+    _BAL_LOCK_MUTEX(&c->mutex, cachedestroy);
+
+    _bal_cache_flush(c);
+    _bal_safefree(&c->buckets);
+    c->nbuckets = 0;
+
+    _BAL_UNLOCK_MUTEX(&c->mutex, cachedestroy);
+    _BAL_MUTEX_COUNTER_CHECK(cachedestroy);
+}
+
+/**
+ * Static functions
+ */
+
+static uint32_t _bal_cache_hash(const char* key, size_t* len)
+{
+    /* FNV-1a. */
+    uint32_t hash = 2166136261U;
+    const char* cur = key;
+
+    while ('\0' != *cur) {
+        hash ^= (uint8_t)*cur++;
+        hash *= 16777619U;
+    }
+
+    *len = (size_t)(cur - key);
+    return hash;
+}
+
+static bal_cache_entry* _bal_cache_find(bal_cache* c, const char* key, size_t len,
+    uint32_t hash)
+{
+    if (NULL == c->buckets)
+        return NULL;
+
+    bal_cache_entry* e = c->buckets[hash & (c->nbuckets - 1)];
+    while (NULL != e) {
+        if (e->hash == hash && 0 == strncmp(e->key, key, len + 1))
+            break;
+        e = e->chain;
+    }
+
+    return e;
+}
+
+static void _bal_cache_unlink(bal_cache* c, bal_cache_entry* e)
+{
+    if (NULL != e->prev) {
+        e->prev->next = e->next;
+    } else {
+        c->head = e->next;
+    }
+
+    if (NULL != e->next) {
+        e->next->prev = e->prev;
+    } else {
+        c->tail = e->prev;
+    }
+
+    e->prev = NULL;
+    e->next = NULL;
+}
+
+static void _bal_cache_push_front(bal_cache* c, bal_cache_entry* e)
+{
+    e->prev = NULL;
+    e->next = c->head;
+
+    if (NULL != c->head)
+        c->head->prev = e;
+    c->head = e;
+
+    if (NULL == c->tail)
+        c->tail = e;
+}
+
+static void _bal_cache_remove(bal_cache* c, bal_cache_entry* e)
+{
+    bal_cache_entry** link = &c->buckets[e->hash & (c->nbuckets - 1)];
+    while (NULL != *link && *link != e)
+        link = &(*link)->chain;
+
+    if (NULL != *link)
+        *link = e->chain;
+
+    _bal_cache_unlink(c, e);
+    _bal_cache_free_entry(&e);
+    c->stats.entries--;
+}
+
+static void _bal_cache_free_entry(bal_cache_entry** e)
+{
+    if (NULL != e && NULL != *e) {
+        _bal_safefree(&(*e)->key);
+        _bal_safefree(&(*e)->data);
+        _bal_safefree(e);
+    }
+}
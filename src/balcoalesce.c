@@ -0,0 +1,293 @@
+/*
+ * balcoalesce.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+static bool _bal_coalescer_append(bal_coalescer* c, const void* data, size_t len);
+static void _bal_coalescer_enqueue(bal_coalescer* c);
+static void _bal_coalescer_raise(bal_coalescer* c);
+
+/**
+ * Exported functions
+ */
+
+bool bal_set_coalescing(bal_socket* s, bool enable)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    /* merging datagrams would change their boundaries. */
+    if (enable && SOCK_STREAM != s->type)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bool retval = true;
+
+    _BAL_MUTEX_COUNTER_INIT(coalesce);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, coalesce);
+
+    bal_coalescer* c = s->state.coalesce;
+    if (enable) {
+        if (NULL == c) {
+            c = _bal_calloc(1, sizeof(bal_coalescer));
+            if (!_bal_okptrnf(c)) {
+                retval = _bal_handlelasterr();
+            } else {
+                c->sd             = s->sd;
+                s->state.coalesce = c;
+            }
+        }
+        if (retval) {
+            c->enabled = true;
+            _bal_dbglog("enabled write coalescing on socket "BAL_SOCKET_SPEC, s->sd);
+        }
+    } else if (NULL != c) {
+        /* anything already buffered still goes out (in order) via the event
+         * thread; the state itself is released along with the socket. */
+        c->enabled = false;
+        if (!_bal_coalescer_pending(c)) {
+            _bal_safefree(&c->buf);
+            c->cap = c->off = c->len = 0;
+        }
+        _bal_dbglog("disabled write coalescing on socket "BAL_SOCKET_SPEC, s->sd);
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, coalesce);
+    _BAL_MUTEX_COUNTER_CHECK(coalesce);
+
+    return retval;
+}
+
+bool bal_flush(const bal_socket* s)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    bool retval = true;
+
+    _BAL_MUTEX_COUNTER_INIT(flush);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, flush);
+
+    bal_coalescer* c = s->state.coalesce;
+    if (NULL != c && (0 != c->error || !_bal_coalescer_flush(c))) {
+        retval   = _bal_handleerr(c->error);
+        c->error = 0;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, flush);
+    _BAL_MUTEX_COUNTER_CHECK(flush);
+
+    return retval;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_coalescer_destroy(bal_coalescer** c)
+{
+    if (NULL == c || NULL == *c)
+        return;
+
+    _bal_coalescer_discard(*c);
+    _bal_safefree(&(*c)->buf);
+    _bal_safefree(c);
+}
+
+void _bal_coalescer_discard(bal_coalescer* c)
+{
+    if (NULL == c)
+        return;
+
+    if (c->queued) {
+        bal_coalescer** link = &_bal_as_container.flushq;
+        while (NULL != *link && c != *link)
+            link = &(*link)->next;
+        if (NULL != *link)
+            *link = c->next;
+        c->next   = NULL;
+        c->queued = false;
+    }
+
+    c->off = c->len = 0;
+}
+
+ssize_t _bal_coalescer_send(const bal_socket* s, const void* data, bal_iolen len,
+    int flags)
+{
+    ssize_t sent     = -1;
+    bal_coalescer* c = s->state.coalesce;
+
+    /* recursive: this is already held when called from a callback. */
+    _BAL_MUTEX_COUNTER_INIT(coalsend);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, coalsend);
+
+    if (0 != c->error) {
+        /* report a failure from an earlier flush to the next sender. */
+        _bal_coalescer_raise(c);
+    } else if (c->enabled && 0 == (flags & ~MSG_NOSIGNAL) && _bal_in_dispatch()) {
+        bool flushed = true;
+        if (c->len - c->off + (size_t)len > BAL_COALESCE_MAX) {
+            flushed = _bal_coalescer_flush(c);
+            if (!flushed)
+                _bal_coalescer_raise(c);
+        }
+
+        size_t pending = c->len - c->off;
+        if (flushed) {
+            if (0 == pending && (size_t)len > BAL_COALESCE_MAX) {
+                /* too large to be worth holding back. */
+                sent = send(s->sd, data, len, flags);
+                if (-1 == sent)
+                    _bal_handlelastioerr();
+            } else if (pending + (size_t)len > BAL_COALESCE_MAX) {
+                /* the peer isn't keeping up; apply back-pressure. */
+                (void)_bal_setlasterror(_BAL_EWOULDBLOCK);
+            } else if (_bal_coalescer_append(c, data, len)) {
+                _bal_coalescer_enqueue(c);
+                sent = (ssize_t)len;
+            }
+        }
+    } else {
+        /* not coalescing this send, but it must not overtake earlier ones. */
+        if (_bal_coalescer_pending(c) && !_bal_coalescer_flush(c)) {
+            _bal_coalescer_raise(c);
+        } else if (_bal_coalescer_pending(c)) {
+            (void)_bal_setlasterror(_BAL_EWOULDBLOCK);
+        } else {
+            sent = send(s->sd, data, len, flags);
+            if (-1 == sent)
+                _bal_handlelastioerr();
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, coalsend);
+    _BAL_MUTEX_COUNTER_CHECK(coalsend);
+
+    return sent;
+}
+
+bool _bal_coalescer_flush(bal_coalescer* c)
+{
+    while (c->off < c->len) {
+        /* a dead peer must not take the event thread down with SIGPIPE. */
+        ssize_t ret = send(c->sd, (const char*)&c->buf[c->off],
+            (bal_iolen)(c->len - c->off), MSG_NOSIGNAL);
+        if (ret > 0) {
+            c->off += (size_t)ret;
+            continue;
+        }
+
+        int err = _bal_lasterror();
+#if !defined(__WIN__)
+        if (-1 == ret && EINTR == err)
+            continue;
+#endif
+        if (-1 == ret && _bal_wouldblock(err))
+            return true;
+
+        /* the connection is unusable; drop what's left. */
+        c->error = 0 != err ? err : _BAL_EWOULDBLOCK;
+        c->off   = c->len = 0;
+        return false;
+    }
+
+    c->off = c->len = 0;
+    return true;
+}
+
+void _bal_coalescer_flush_all(void)
+{
+    bal_coalescer** link = &_bal_as_container.flushq;
+
+    while (NULL != *link) {
+        bal_coalescer* c = *link;
+        (void)_bal_coalescer_flush(c);
+
+        if (_bal_coalescer_pending(c)) {
+            /* would block; stays queued, and the event thread polls for
+             * writability until it drains. */
+            link = &c->next;
+        } else {
+            *link     = c->next;
+            c->next   = NULL;
+            c->queued = false;
+            if (!c->enabled) {
+                _bal_safefree(&c->buf);
+                c->cap = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Static functions
+ */
+
+static bool _bal_coalescer_append(bal_coalescer* c, const void* data, size_t len)
+{
+    if (c->off > 0 && c->len + len > c->cap) {
+        memmove(c->buf, &c->buf[c->off], c->len - c->off);
+        c->len -= c->off;
+        c->off  = 0;
+    }
+
+    if (c->len + len > c->cap) {
+        size_t cap = 0U == c->cap ? BAL_COALESCE_BUFSIZE : c->cap;
+        while (cap < c->len + len)
+            cap *= 2;
+
+        uint8_t* buf = _bal_realloc(c->buf, cap);
+        if (!_bal_okptrnf(buf))
+            return _bal_handlelasterr();
+
+        c->buf = buf;
+        c->cap = cap;
+    }
+
+    memcpy(&c->buf[c->len], data, len);
+    c->len += len;
+    return true;
+}
+
+static void _bal_coalescer_enqueue(bal_coalescer* c)
+{
+    if (!c->queued) {
+        c->next   = _bal_as_container.flushq;
+        c->queued = true;
+        _bal_as_container.flushq = c;
+    }
+}
+
+static void _bal_coalescer_raise(bal_coalescer* c)
+{
+    /* callers classify the failure by the last error (see _bal_io_failed), so
+     * it has to be the saved one, not whatever was left over. */
+    (void)_bal_setlasterror(c->error);
+    (void)_bal_handleerr(c->error);
+    c->error = 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * baldest.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+/**
+ * Exported functions
+ */
+
+bool bal_dest_prepare(const char* host, const char* port, bal_dest* dest)
+{
+    if (!_bal_okstr(host) || !_bal_okstr(port) || !_bal_okptr(dest))
+        return false;
+
+    memset(dest, 0, sizeof(bal_dest));
+    if (0U == _bal_resolve_addrs(AI_NUMERICSERV, PF_UNSPEC, SOCK_DGRAM, host, port,
+        &dest->addr, 1))
+        return false;
+
+    dest->len = (socklen_t)_BAL_SASIZE(dest->addr);
+    return true;
+}
+
+ssize_t bal_sendto_dest(const bal_socket* s, const bal_dest* dest, const void* data,
+    bal_iolen len, int flags)
+{
+    ssize_t sent = -1;
+
+    if (_bal_oksock(s) && _bal_okptr(dest) && _bal_okptr(data) && _bal_oklen(len)) {
+        sent = sendto(s->sd, data, len, flags, (const struct sockaddr*)&dest->addr,
+            dest->len);
+        _bal_count_send(s, sent);
+        if (-1 == sent)
+            _bal_handlelastioerr();
+    }
+
+    return sent;
+}
+
+ssize_t bal_sendto_dests(const bal_socket* s, const bal_dest* dests, size_t count,
+    const void* data, bal_iolen len, int flags)
+{
+    if (!_bal_oksock(s) || !_bal_okptr(dests) || !_bal_okptr(data) || !_bal_oklen(len))
+        return -1;
+
+    if (0U == count) {
+        (void)_bal_seterror(_BAL_E_INVALIDARG);
+        return -1;
+    }
+
+    size_t sent = 0;
+
+#if defined(__HAVE_SENDMMSG__)
+    struct mmsghdr msgs[BAL_SENDMMSG_BATCH];
+    struct iovec iov = {(void*)data, len};
+
+    while (sent < count) {
+        size_t batch = count - sent;
+        if (batch > BAL_SENDMMSG_BATCH)
+            batch = BAL_SENDMMSG_BATCH;
+
+        memset(msgs, 0, batch * sizeof(struct mmsghdr));
+        for (size_t n = 0; n < batch; n++) {
+            msgs[n].msg_hdr.msg_name    = (void*)&dests[sent + n].addr;
+            msgs[n].msg_hdr.msg_namelen = dests[sent + n].len;
+            msgs[n].msg_hdr.msg_iov     = &iov;
+            msgs[n].msg_hdr.msg_iovlen  = 1;
+        }
+
+        int ret = sendmmsg(s->sd, msgs, (unsigned int)batch, flags);
+        if (-1 == ret) {
+            _bal_count_send(s, -1);
+            _bal_handlelastioerr();
+            break;
+        }
+
+        for (int n = 0; n < ret; n++)
+            _bal_count_send(s, (ssize_t)len);
+
+        sent += (size_t)ret;
+        if ((size_t)ret < batch)
+            break;
+    }
+#else
+    for (; sent < count; sent++) {
+        ssize_t ret = sendto(s->sd, data, len, flags,
+            (const struct sockaddr*)&dests[sent].addr, dests[sent].len);
+        _bal_count_send(s, ret);
+        if (-1 == ret) {
+            _bal_handlelastioerr();
+            break;
+        }
+    }
+#endif
+
+    return 0U == sent ? -1 : (ssize_t)sent;
+}
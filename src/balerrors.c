@@ -33,7 +33,7 @@
 
 /** Container for information about the last error that occurred on this thread. */
 static _bal_thread_local bal_thread_error_info _bal_tei = {
-    _BAL_E_NOERROR, {BAL_UNKNOWN, BAL_UNKNOWN, 0U}, {0, BAL_UNKNOWN}
+    _BAL_E_NOERROR, {BAL_UNKNOWN, BAL_UNKNOWN, 0U}, {0, false}
 };
 
 /** The string used to format error messages generated by libbal when
@@ -67,9 +67,14 @@ static const struct {
     {_BAL_E_INTERNAL,   "An internal error has occurred"},
     {_BAL_E_UNAVAIL,    "Feature is disabled or unavailable"},
     {_BAL_E_PLATFORM,   BAL_ERRFMTPFORM},
+    {_BAL_E_BADFRAME,   "Malformed or oversized message frame"},
+    {_BAL_E_POOLFULL,   "Connection pool limit reached"},
     {_BAL_E_UNKNOWN,    "An unknown error has occurred"}
 };
 
+static void _bal_format_os_error(int code, bool gai, char* msg, size_t size);
+static const char* _bal_trim_path(const char* file);
+
 int _bal_get_error(bal_error* err, bool extended)
 {
     int retval = -1;
@@ -79,26 +84,26 @@ int _bal_get_error(bal_error* err, bool extended)
         err->code = _bal_err_code(_BAL_E_UNKNOWN);
         for (size_t n = 0; n < _bal_countof(bal_errors); n++) {
             if (bal_errors[n].code == _bal_tei.code) {
-                char* heap_msg = NULL;
+                /* OS messages are looked up here rather than when the error
+                 * occurs, since most errors are never retrieved. */
+                char os_msg[BAL_MAXERROR + 33] = {0};
                 if (_BAL_E_PLATFORM == bal_errors[n].code) {
-                    heap_msg = calloc(BAL_MAXERROR + 33, sizeof(char));
-                    if (NULL != heap_msg) {
-                        _bal_snprintf_trunc(heap_msg, BAL_MAXERROR + 33, bal_errors[n].msg,
-                            _bal_tei.os.code, _bal_okstrnf(_bal_tei.os.msg)
-                                ? _bal_tei.os.msg : BAL_UNKNOWN);
-                    }
+                    char msg[BAL_MAXERROR] = {0};
+                    _bal_format_os_error(_bal_tei.os.code, _bal_tei.os.gai, msg,
+                        sizeof(msg));
+                    _bal_snprintf_trunc(os_msg, sizeof(os_msg), bal_errors[n].msg,
+                        _bal_tei.os.code, _bal_okstrnf(msg) ? msg : BAL_UNKNOWN);
                 }
 
+                const char* msg = _bal_okstrnf(os_msg) ? os_msg : bal_errors[n].msg;
                 if (extended) {
                     _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMTEXT,
-                        _bal_tei.loc.func, _bal_tei.loc.file, _bal_tei.loc.line,
-                        _bal_okptrnf(heap_msg) ? heap_msg : bal_errors[n].msg);
+                        _bal_tei.loc.func, _bal_trim_path(_bal_tei.loc.file),
+                        _bal_tei.loc.line, msg);
                 } else {
-                    _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMT,
-                        _bal_okptrnf(heap_msg) ? heap_msg : bal_errors[n].msg);
+                    _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMT, msg);
                 }
 
-                _bal_safefree(&heap_msg);
                 retval = err->code = _bal_err_code(bal_errors[n].code);
                 break;
             }
@@ -108,44 +113,44 @@ int _bal_get_error(bal_error* err, bool extended)
     return retval;
 }
 
+void _bal_save_error(bal_thread_error_info* out)
+{
+    if (_bal_okptrnf(out))
+        *out = _bal_tei;
+}
+
+void _bal_restore_error(const bal_thread_error_info* in)
+{
+    if (_bal_okptrnf(in))
+        _bal_tei = *in;
+}
+
 bool __bal_set_error(int code, const char* func, const char* file, uint32_t line)
 {
     if (_bal_is_error(code)) {
-        _bal_tei.code = code;
+        _bal_tei.code     = code;
         _bal_tei.loc.func = func;
-#if defined(__WIN__)
-        const char* last_slash = StrRChrA(file, NULL, '\\');
-        if (NULL == last_slash)
-              last_slash = StrRChrA(file, NULL, '/');
-#else
-        const char* last_slash = strrchr(file, '/');
-#endif
-        if (NULL != last_slash)
-            file = last_slash + 1;
-
         _bal_tei.loc.file = file;
         _bal_tei.loc.line = line;
+        _bal_probe4(error, code, _BAL_E_PLATFORM == code ? _bal_tei.os.code : 0, func,
+            line);
     }
 
 #if defined(BAL_DBGLOG) && defined(BAL_DBGLOG_SETERROR)
     if (0 != code) {
         bal_error err = {0};
-        __bal_dbglog(func, file, line, "%d (%s)",
+        __bal_dbglog(func, _bal_trim_path(file), line, "%d (%s)",
             _bal_get_error(&err, false), err.message);
     }
 #endif
     return false;
 }
 
-void __bal_set_os_error(int code, const char* message, const char* func,
-    const char* file, uint32_t line)
+void __bal_set_os_error(int code, bool gai, const char* func, const char* file,
+    uint32_t line)
 {
     _bal_tei.os.code = code;
-    _bal_tei.os.msg[0] = '\0';
-
-    if (_bal_okstrnf(message))
-        _bal_strcpy(_bal_tei.os.msg, BAL_MAXERROR, message,
-            strnlen(message, BAL_MAXERROR));
+    _bal_tei.os.gai  = gai;
 
     (void)__bal_set_error(_BAL_E_PLATFORM, func, file, line);
 }
@@ -153,16 +158,43 @@ void __bal_set_os_error(int code, const char* message, const char* func,
 bool __bal_handle_error(int code, const char* func, const char* file,
     uint32_t line, bool gai)
 {
-    char msg[BAL_MAXERROR] = {0};
+    __bal_set_os_error(code, gai, func, file, line);
+    return false;
+}
+
+#if defined(BAL_DBGLOG)
+void __bal_dbglog(const char* func, const char* file, uint32_t line,
+    const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+# if defined(__HAVE_ASYNC_DBGLOG__)
+    /* formatting and output happen on the log thread. */
+    bool queued = _bal_log_enqueue(func, file, line, format, args);
+# else
+    bool queued = false;
+# endif
+
+    if (!queued) {
+        char msg[BAL_DBGLOG_MAXMSG];
+        (void)vsnprintf(msg, sizeof(msg), format, args);
+        _bal_log_write(_bal_gettid(), func, file, line, msg);
+    }
+
+    va_end(args);
+}
+#endif
+
+static void _bal_format_os_error(int code, bool gai, char* msg, size_t size)
+{
 #if defined(__WIN__)
     BAL_UNUSED(gai);
 
     DWORD flags = FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS |
                     FORMAT_MESSAGE_MAX_WIDTH_MASK;
-    DWORD fmt = FormatMessageA(flags, NULL, (DWORD)code, 0UL, msg,
-        BAL_MAXERROR, NULL);
+    DWORD fmt = FormatMessageA(flags, NULL, (DWORD)code, 0UL, msg, (DWORD)size, NULL);
 
-    assert(0UL != fmt);
     if (fmt > 0UL) {
         if (msg[fmt - 1] == '\n' || msg[fmt - 1] == ' ')
             msg[fmt - 1] = '\0';
@@ -170,24 +202,24 @@ bool __bal_handle_error(int code, const char* func, const char* file,
 #else
     if (gai) {
         const char* tmp = gai_strerror(code);
-        _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+        _bal_strcpy(msg, size, tmp, strnlen(tmp, size));
     } else {
         int finderr = -1;
 # if defined(__HAVE_XSI_STRERROR_R__)
-        finderr = strerror_r(code, msg, BAL_MAXERROR);
+        finderr = strerror_r(code, msg, size);
 #  if defined(__HAVE_XSI_STRERROR_R_ERRNO__)
         if (finderr == -1)
             finderr = errno;
 #  endif
 # elif defined(__HAVE_GNU_STRERROR_R__)
-        const char* tmp = strerror_r(code, msg, BAL_MAXERROR);
+        const char* tmp = strerror_r(code, msg, size);
         if (tmp != msg)
-            _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+            _bal_strcpy(msg, size, tmp, strnlen(tmp, size));
 # elif defined(__HAVE_STRERROR_S__)
-        finderr = (int)strerror_s(msg, BAL_MAXERROR, code);
+        finderr = (int)strerror_s(msg, size, code);
 # else
         const char* tmp = strerror(code);
-        _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+        _bal_strcpy(msg, size, tmp, strnlen(tmp, size));
 # endif
 # if defined(__HAVE_XSI_STRERROR_R__) || defined(__HAVE_STRERROR_S__)
         BAL_ASSERT_UNUSED(finderr, 0 == finderr);
@@ -196,56 +228,20 @@ bool __bal_handle_error(int code, const char* func, const char* file,
 # endif
     }
 #endif
-
-    __bal_set_os_error(code, msg, func, file, line);
-    return false;
 }
 
-#if defined(BAL_DBGLOG)
-void __bal_dbglog(const char* func, const char* file, uint32_t line,
-    const char* format, ...)
+static const char* _bal_trim_path(const char* file)
 {
-    va_list args;
-    va_list args2;
-    va_start(args, format);
-    va_copy(args2, args);
-
-    int prnt_len = vsnprintf(NULL, 0, format, args);
+    if (NULL == file)
+        return BAL_UNKNOWN;
 
-    va_end(args);
-    BAL_ASSERT(prnt_len > 0);
-
-    char* buf = calloc(prnt_len + 1, sizeof(char));
-    BAL_ASSERT(NULL != buf);
-
-    if (buf) {
-        char prefix[256] = {0};
-        int len = snprintf(prefix, 256, "["BAL_TID_SPEC"] %s (%s:%"PRIu32"): ",
-            _bal_gettid(), func, file, line);
-        BAL_ASSERT_UNUSED(len, len > 0 && len < 256);
-
-        (void)vsnprintf(buf, prnt_len + 1, format, args2);
-        va_end(args2);
-
-        const char* color = "0";
-# if defined(__WIN__)
-        if (NULL != StrStrIA(buf, "error") || NULL != StrStrIA(buf, "assert"))
-            color = "91";
-        else if (NULL != StrStrIA(buf, "warn"))
-            color = "33";
-# else
-        if (NULL != strcasestr(buf, "error") || NULL != strcasestr(buf, "assert"))
-            color = "91";
-        else if (NULL != strcasestr(buf, "warn"))
-            color = "33";
-# endif
-# if defined(BAL_DBGLOG_WARNERR_ONLY)
-        /* if this macro is defined, only log warnings and errors. */
-        if (strncmp("0", color, 2) < 0)
-# endif
-            (void)printf("\x1b[%sm%s%s\x1b[0m\n", color, prefix, buf);
+#if defined(__WIN__)
+    const char* last_slash = StrRChrA(file, NULL, '\\');
+    if (NULL == last_slash)
+          last_slash = StrRChrA(file, NULL, '/');
+#else
+    const char* last_slash = strrchr(file, '/');
+#endif
 
-        _bal_safefree(&buf);
-    }
+    return NULL != last_slash ? last_slash + 1 : file;
 }
-#endif
@@ -0,0 +1,404 @@
+/*
+ * balframing.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+#if defined(__HAVE_AVX2__)
+# include <immintrin.h>
+#elif defined(__HAVE_SSE2__)
+# include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+# include <intrin.h>
+#endif
+
+/**
+ * Exported functions
+ */
+
+bool bal_set_framing(bal_socket* s, const bal_framing* cfg)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    bool remove = NULL == cfg || BAL_FRAME_NONE == cfg->mode;
+    if (!remove && !_bal_framing_valid(cfg))
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bool retval = true;
+
+    /* the event thread reads from the framer while dispatching. */
+    _BAL_MUTEX_COUNTER_INIT(framing);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, framing);
+
+    if (remove) {
+        _bal_framer_destroy(&s->state.framer);
+    } else if (NULL != s->state.framer) {
+        /* keep any buffered data; the new rules apply to it from here on. */
+        s->state.framer->cfg     = *cfg;
+        s->state.framer->scanned = 0;
+        s->state.framer->failed  = false;
+    } else {
+        bal_framer* f = _bal_calloc(1, sizeof(bal_framer));
+        if (!_bal_okptrnf(f)) {
+            retval = _bal_handlelasterr();
+        } else {
+            f->buf = _bal_calloc(BAL_FRAME_BUFSIZE, sizeof(uint8_t));
+            if (!_bal_okptrnf(f->buf)) {
+                retval = _bal_handlelasterr();
+                _bal_safefree(&f);
+            } else {
+                f->cfg = *cfg;
+                f->cap = BAL_FRAME_BUFSIZE;
+                s->state.framer = f;
+                _bal_dbglog("enabled framing (mode = %d) on socket "BAL_SOCKET_SPEC,
+                    cfg->mode, s->sd);
+            }
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, framing);
+    _BAL_MUTEX_COUNTER_CHECK(framing);
+
+    return retval;
+}
+
+bool bal_get_frame(const bal_socket* s, bal_frame* out)
+{
+    bool retval = false;
+
+    if (_bal_oksock(s) && _bal_okptr(out)) {
+        if (NULL != s->state.framer && s->state.framer->active) {
+            *out   = s->state.framer->cur;
+            retval = true;
+        } else {
+            (void)_bal_seterror(_BAL_E_INVALIDARG);
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Internal functions
+ */
+
+bool _bal_framing_valid(const bal_framing* cfg)
+{
+    if (!_bal_okptr(cfg))
+        return false;
+
+    if (BAL_FRAME_LENGTH == cfg->mode) {
+        uint8_t flen = cfg->length.field_len;
+        return (1 == flen || 2 == flen || 4 == flen || 8 == flen) &&
+            cfg->length.header_len >= cfg->length.field_off + flen;
+    } else if (BAL_FRAME_VARINT == cfg->mode) {
+        return true;
+    } else if (BAL_FRAME_DELIM == cfg->mode) {
+        return cfg->delim.len > 0 && cfg->delim.len <= BAL_FRAME_MAXDELIM;
+    }
+
+    return false;
+}
+
+void _bal_framer_destroy(bal_framer** f)
+{
+    if (_bal_okptrptrnf(f) && NULL != *f) {
+        _bal_safefree(&(*f)->buf);
+        _bal_safefree(f);
+    }
+}
+
+/** Returns the largest frame payload the framer will accept. */
+static inline
+size_t _bal_framer_maxframe(const bal_framer* f)
+{
+    return 0 != f->cfg.max_frame ? f->cfg.max_frame : BAL_FRAME_DEFMAX;
+}
+
+/** Returns the largest the receive buffer is allowed to grow. */
+static inline
+size_t _bal_framer_limit(const bal_framer* f)
+{
+    size_t overhead = 0;
+    if (BAL_FRAME_LENGTH == f->cfg.mode)
+        overhead = f->cfg.length.header_len;
+    else if (BAL_FRAME_VARINT == f->cfg.mode)
+        overhead = 10;
+    else if (BAL_FRAME_DELIM == f->cfg.mode)
+        overhead = f->cfg.delim.len;
+    return _bal_framer_maxframe(f) + overhead;
+}
+
+/** Marks the framer as failed and records the error. */
+static inline
+bool _bal_framer_fail(bal_framer* f)
+{
+    f->failed = true;
+    return _bal_seterror(_BAL_E_BADFRAME);
+}
+
+/** Decodes an unsigned integer of `len` bytes. */
+static inline
+uint64_t _bal_read_uint(const uint8_t* p, size_t len, bool big_endian)
+{
+    uint64_t val = 0;
+
+    for (size_t n = 0; n < len; n++)
+        val = (val << 8) | p[big_endian ? n : len - 1 - n];
+
+    return val;
+}
+
+uint32_t _bal_framer_recv(bal_socket* s)
+{
+    bal_framer* f = s->state.framer;
+    if (f->failed)
+        return 0U;
+
+    if (f->end == f->cap) {
+        size_t limit = _bal_framer_limit(f);
+        if (f->cap >= limit) {
+            (void)_bal_framer_fail(f);
+            return BAL_EVT_ERROR;
+        }
+
+        size_t newcap = f->cap * 2 < limit ? f->cap * 2 : limit;
+        uint8_t* newbuf = _bal_realloc(f->buf, newcap);
+        if (!_bal_okptrnf(newbuf)) {
+            _bal_handlelasterr();
+            return BAL_EVT_ERROR;
+        }
+
+        f->buf = newbuf;
+        f->cap = newcap;
+    }
+
+    ssize_t rcv = recv(s->sd, (void*)(f->buf + f->end), (bal_iolen)(f->cap - f->end), 0);
+    _bal_count_recv(s, rcv);
+    if (rcv > 0) {
+        f->end += (size_t)rcv;
+        return 0U;
+    }
+
+    if (0 == rcv)
+        return BAL_EVT_CLOSE;
+
+    int err = _bal_lasterror();
+    if (_bal_wouldblock(err))
+        return 0U;
+
+    (void)_bal_handleerr(err);
+    return BAL_EVT_ERROR;
+}
+
+bool _bal_framer_next(bal_framer* f, bal_frame* out)
+{
+    if (f->failed)
+        return false;
+
+    const uint8_t* base = f->buf + f->start;
+    size_t avail        = f->end - f->start;
+    size_t max          = _bal_framer_maxframe(f);
+    size_t hdr          = 0;
+    uint64_t len        = 0;
+
+    if (BAL_FRAME_LENGTH == f->cfg.mode) {
+        hdr = f->cfg.length.header_len;
+        if (avail < hdr)
+            return false;
+
+        len = _bal_read_uint(base + f->cfg.length.field_off, f->cfg.length.field_len,
+            f->cfg.length.big_endian);
+        if (f->cfg.length.inclusive) {
+            if (len < hdr)
+                return _bal_framer_fail(f);
+            len -= hdr;
+        }
+    } else if (BAL_FRAME_VARINT == f->cfg.mode) {
+        bool done = false;
+        for (unsigned shift = 0; hdr < avail && !done; shift += 7) {
+            uint8_t b = base[hdr++];
+            if (63 == shift && b > 1)
+                return _bal_framer_fail(f);
+            len |= (uint64_t)(b & 0x7f) << shift;
+            done = 0 == (b & 0x80);
+            if (!done && 10 == hdr)
+                return _bal_framer_fail(f);
+        }
+        if (!done)
+            return false;
+    } else if (BAL_FRAME_DELIM == f->cfg.mode) {
+        size_t dlen = f->cfg.delim.len;
+        const uint8_t* hit = _bal_find_delim(base + f->scanned, avail - f->scanned,
+            f->cfg.delim.bytes, dlen);
+        if (NULL == hit) {
+            if (avail >= max + dlen)
+                return _bal_framer_fail(f);
+            /* a delimiter may yet begin within the last dlen - 1 bytes. */
+            f->scanned = avail >= dlen ? avail - dlen + 1 : 0;
+            return false;
+        }
+
+        size_t plen = (size_t)(hit - base);
+        if (plen > max)
+            return _bal_framer_fail(f);
+
+        out->data    = base;
+        out->len     = plen;
+        out->hdr_len = 0;
+        f->start    += plen + dlen;
+        f->scanned   = 0;
+        return true;
+    } else {
+        return false;
+    }
+
+    if (len > max)
+        return _bal_framer_fail(f);
+
+    if (avail - hdr < len)
+        return false;
+
+    out->data    = base + hdr;
+    out->len     = (size_t)len;
+    out->hdr_len = hdr;
+    f->start    += hdr + (size_t)len;
+    return true;
+}
+
+void _bal_framer_compact(bal_framer* f)
+{
+    if (0 == f->start)
+        return;
+
+    size_t remain = f->end - f->start;
+    if (remain > 0)
+        memmove(f->buf, f->buf + f->start, remain);
+
+    f->start = 0;
+    f->end   = remain;
+}
+
+bool _bal_dispatch_frames(bal_descriptor sd, bal_socket* s)
+{
+    bal_framer* f   = s->state.framer;
+    bal_frame frame = {0};
+
+    while (_bal_framer_next(f, &frame)) {
+        f->cur    = frame;
+        f->active = true;
+
+        if (_bal_okptrnf(s->state.proc))
+            _bal_invoke_callback(s, sd, BAL_EVT_READ);
+
+        /* the callback may have destroyed or deregistered the socket, or
+         * removed its framing; in any of those cases, stop here. */
+        bal_socket* d = NULL;
+        if (!_bal_list_find(_bal_as_container.lst, sd, &d) || d != s)
+            return false;
+
+        if (s->state.framer != f)
+            return true;
+
+        f->active = false;
+    }
+
+    if (f->failed) {
+        /* stop reading; the stream can't be resynchronized. */
+        bal_setbitslow(&s->state.mask, BAL_EVT_READ);
+    } else {
+        _bal_framer_compact(f);
+    }
+
+    return true;
+}
+
+/** Returns the number of trailing zero bits in a non-zero value. */
+static inline
+unsigned _bal_ctz32(uint32_t val)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx = 0;
+    (void)_BitScanForward(&idx, val);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz(val);
+#endif
+}
+
+/** memchr, but 16 or 32 bytes at a time where SSE2/AVX2 are available. */
+static inline
+const uint8_t* _bal_scan_byte(const uint8_t* p, size_t len, uint8_t c)
+{
+#if defined(__HAVE_AVX2__)
+    const __m256i needle32 = _mm256_set1_epi8((char)c);
+    while (len >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(const void*)p);
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32));
+        if (0U != bits)
+            return p + _bal_ctz32(bits);
+        p   += 32;
+        len -= 32;
+    }
+#endif
+#if defined(__HAVE_AVX2__) || defined(__HAVE_SSE2__)
+    const __m128i needle16 = _mm_set1_epi8((char)c);
+    while (len >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(const void*)p);
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16));
+        if (0U != bits)
+            return p + _bal_ctz32(bits);
+        p   += 16;
+        len -= 16;
+    }
+#endif
+    return 0 == len ? NULL : memchr(p, c, len);
+}
+
+const uint8_t* _bal_find_delim(const uint8_t* buf, size_t len, const uint8_t* delim,
+    size_t dlen)
+{
+    if (0 == dlen || len < dlen)
+        return NULL;
+
+    const uint8_t* cur  = buf;
+    const uint8_t* last = buf + (len - dlen); /* last place a delimiter can begin. */
+
+    while (cur <= last) {
+        const uint8_t* hit = _bal_scan_byte(cur, (size_t)(last - cur) + 1, delim[0]);
+        if (NULL == hit)
+            return NULL;
+        if (1 == dlen || 0 == memcmp(hit + 1, delim + 1, dlen - 1))
+            return hit;
+        cur = hit + 1;
+    }
+
+    return NULL;
+}
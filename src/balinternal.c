@@ -28,6 +28,9 @@
 #include "bal/state.h"
 #include "bal.h"
 
+/** Set on the event thread while it is dispatching callbacks. */
+static _bal_thread_local bool _bal_dispatching = false;
+
 /**
  * Internal functions
  */
@@ -58,6 +61,12 @@ bool _bal_init_asyncpoll(void)
         return _bal_handlelasterr();
     }
 
+    /* without it, the event thread still works, but only notices work
+     * queued by other threads (e.g., resolved names) every poll interval. */
+    if (!_bal_wakeup_create()) {
+        _bal_dbglog("warning: failed to create wakeup descriptors");
+    }
+
 #if defined(__WIN__)
     _bal_as_container.thread = _beginthreadex(NULL, 0U, &_bal_eventthread, NULL,
         0U, NULL);
@@ -88,6 +97,7 @@ bool _bal_cleanup_asyncpoll(void)
 
     _bal_set_boolean(&_bal_as_container.die, true);
     _bal_set_boolean(&_bal_async_poll_init, false);
+    _bal_wakeup_signal();
 
     _bal_dbglog("joining async I/O thread...");
 
@@ -111,6 +121,21 @@ bool _bal_cleanup_asyncpoll(void)
             key, val);
     }
 
+    _bal_resolver_cleanup();
+    _bal_wakeup_destroy();
+
+    /* connection races still in progress are abandoned too. */
+    while (NULL != _bal_as_container.raceq)
+        _bal_race_destroy(&_bal_as_container.raceq->s->state.race);
+
+    /* anything left unflushed at this point is abandoned. */
+    while (NULL != _bal_as_container.flushq) {
+        bal_coalescer* c         = _bal_as_container.flushq;
+        _bal_as_container.flushq = c->next;
+        c->next                  = NULL;
+        c->queued                = false;
+    }
+
     bool destroy = _bal_list_destroy(&_bal_as_container.lst);
     BAL_ASSERT(destroy);
     _bal_eqland(cleanup, destroy);
@@ -156,6 +181,23 @@ bool _bal_getnameinfo(int flags, const bal_sockaddr* in, char* host, char* port)
     return retval;
 }
 
+int _bal_io_failed(bool record)
+{
+    int err = _bal_lasterror();
+
+#if defined(__WIN__)
+    if (_bal_wouldblock(err) || WSAEINTR == err)
+#else
+    if (_bal_wouldblock(err) || EINTR == err)
+#endif
+        return BAL_IO_WOULDBLOCK;
+
+    if (record)
+        (void)_bal_handleerr(err);
+
+    return BAL_IO_ERROR;
+}
+
 bool _bal_is_pending_conn(const bal_socket* s)
 {
     return _bal_oksock(s) && bal_isbitset(s->state.bits, BAL_S_CONNECT);
@@ -206,6 +248,7 @@ uint32_t _bal_on_pending_conn_io(bal_socket* s, uint32_t* events)
             retval = BAL_EVT_CONNECT;
         }
 
+        _bal_probe2(connect__done, s->sd, BAL_EVT_CONNECT == retval);
         bal_setbitslow(&s->state.mask, BAL_EVT_WRITE);
         bal_setbitslow(&s->state.bits, BAL_S_CONNECT);
     }
@@ -283,47 +326,106 @@ short _bal_mask_to_pollflags(uint32_t mask)
 bal_threadret _bal_eventthread(void* ctx)
 {
     BAL_UNUSED(ctx);
-    static const int poll_timeout = 500;
+    static const int idle_timeout = 500;
+    _bal_trace_name_thread("bal event thread");
 
     while (!_bal_get_boolean(&_bal_as_container.die)) {
-        size_t count       = 0;
-#if defined(__WIN__)
-        WSAPOLLFD* fds     = NULL;
-#else
-        struct pollfd* fds = NULL;
-#endif
+        size_t count    = 0;
+        bal_pollfd* fds = NULL;
         _BAL_MUTEX_COUNTER_INIT(eventthread);
         _BAL_LOCK_MUTEX(&_bal_as_container.mutex, eventthread);
 
-        count = _bal_list_count(_bal_as_container.lst);
-        if (count > 0) {
-            fds = calloc(count, sizeof(struct pollfd));
+        /* connection race attempts follow the sockets; the wakeup descriptor,
+         * if present, is always polled last. */
+        int race_timeout = idle_timeout;
+        size_t racing    = _bal_race_prepare(&race_timeout);
+        count            = _bal_list_count(_bal_as_container.lst);
+        bool wake        = BAL_BADSOCKET != _bal_as_container.wake[0];
+        size_t nfds      = count + racing + (wake ? 1U : 0U);
+
+        if (nfds > 0) {
+            fds = _bal_calloc(nfds, sizeof(bal_pollfd));
             BAL_ASSERT(NULL != fds);
 
             if (_bal_okptrnf(fds)) {
                 size_t offset      = 0;
                 bal_descriptor key = 0;
                 bal_socket* val    = NULL;
+                uint32_t* wmevts   = NULL;
+                int poll_timeout   = race_timeout;
 
                 _bal_list_reset_iterator(_bal_as_container.lst);
                 while (_bal_list_iterate(_bal_as_container.lst, &key, &val)) {
-                    fds[offset].fd     = key;
+                    /* this may pause/resume reads, so it precedes the mask. */
+                    uint32_t wm = _bal_watermark_check(val);
+                    if (0U != wm && NULL == wmevts)
+                        wmevts = _bal_calloc(count, sizeof(uint32_t));
+                    if (0U != wm && NULL != wmevts)
+                        wmevts[offset] = wm;
+                    /* the kernel doesn't signal a draining send queue, so look
+                     * more often until the low watermark is reached. */
+                    if (val->state.wm.above)
+                        poll_timeout = BAL_WATERMARK_POLL_MSEC;
+
+                    /* a racing socket's own descriptor is replaced by the
+                     * winning attempt, and a resolving one isn't connecting
+                     * yet; until then, poll ignores it. */
+                    fds[offset].fd     = NULL == val->state.race &&
+                        !bal_isbitset(val->state.bits, BAL_S_RESOLVE) ? key : BAL_BADSOCKET;
                     fds[offset].events = _bal_mask_to_pollflags(val->state.mask);
+                    /* wake up when coalesced data that would block can move. */
+                    if (_bal_coalescer_pending(val->state.coalesce))
+                        bal_setbitshigh(&fds[offset].events, POLLWRNORM);
                     offset++;
                 }
 
+                if (NULL != wmevts) {
+                    _bal_dispatching = true;
+                    for (size_t n = 0; n < count; n++) {
+                        bal_socket* s = NULL;
+                        if (0U != wmevts[n] &&
+                            _bal_list_find(_bal_as_container.lst, fds[n].fd, &s) &&
+                            _bal_oksock(s) && bal_bitsinmask(s, wmevts[n]) &&
+                            _bal_okptr(s->state.proc))
+                            _bal_invoke_callback(s, fds[n].fd, wmevts[n]);
+                    }
+                    _bal_dispatching = false;
+                    _bal_safefree(&wmevts);
+                }
+
+                size_t nrace = _bal_race_fill(&fds[count], racing);
+                size_t waker = count + nrace;
+                nfds         = waker + (wake ? 1U : 0U);
+
+                if (wake) {
+                    fds[waker].fd     = _bal_as_container.wake[0];
+                    fds[waker].events = POLLRDNORM;
+                }
+
                 /* relinquish the mutex during poll; this gives other threads
                  * a chance to obtain the lock and do some work. */
                 _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, eventthread);
+                uint64_t poll_start = _bal_monotonic_nsec();
 #if defined(__WIN__)
-                int res = WSAPoll(fds, (nfds_t)count, poll_timeout);
+                int res = WSAPoll(fds, (nfds_t)nfds, poll_timeout);
 #else
-                int res = poll(fds, (nfds_t)count, poll_timeout);
+                int res = poll(fds, (nfds_t)nfds, poll_timeout);
 #endif
+                uint64_t poll_end = _bal_monotonic_nsec();
+                _bal_count(&_bal_stats.polls, 1U);
+                _bal_count(&_bal_stats.poll_nsec, poll_end - poll_start);
+                if (0 == res) {
+                    /* timed out: how much later than asked for did poll return? */
+                    uint64_t due = poll_start + ((uint64_t)poll_timeout * 1000000ULL);
+                    _bal_hist_record(BAL_HIST_LOOPLAG, poll_end > due ? poll_end - due : 0U);
+                }
+                _bal_trace_span(BAL_TRACE_POLL, BAL_BADSOCKET, (uint32_t)res, poll_start,
+                    poll_end);
                 /* get the mutex back. */
                 _BAL_LOCK_MUTEX(&_bal_as_container.mutex, eventthread);
 
                 if (res > 0) {
+                    _bal_dispatching = true;
                     for (size_t n = 0; n < count; n++) {
                         bal_socket* s = NULL;
                         bool found    = _bal_list_find(_bal_as_container.lst,
@@ -331,14 +433,34 @@ bal_threadret _bal_eventthread(void* ctx)
 
                         if (found && _bal_oksock(s)) {
                             uint32_t events = _bal_pollflags_to_events(fds[n].revents);
-                            if (0U != events)
+                            if (0U != events) {
+                                _bal_probe2(dispatch, fds[n].fd, events);
+                                _bal_trace_begin(dispatch_start);
                                 _bal_dispatch_events(fds[n].fd, s, events);
+                                _bal_trace_end(dispatch_start, BAL_TRACE_DISPATCH,
+                                    fds[n].fd, events);
+                            }
                         }
                     }
+                    _bal_dispatching = false;
+
+                    if (wake && 0 != fds[waker].revents)
+                        _bal_wakeup_drain();
                 } else if (-1 == res) {
                     _bal_handlelasterr();
                 }
 
+                /* connection race outcomes (a race can be lost without any
+                 * poll event), and names resolved by the resolver threads. */
+                _bal_dispatching = true;
+                _bal_race_dispatch(&fds[count], res > 0 ? nrace : 0U);
+                _bal_resolver_dispatch();
+                _bal_dispatching = false;
+
+                /* everything sent by this batch of callbacks goes out now. */
+                if (NULL != _bal_as_container.flushq)
+                    _bal_coalescer_flush_all();
+
                 _bal_safefree(&fds);
             }
          }
@@ -346,7 +468,7 @@ bal_threadret _bal_eventthread(void* ctx)
         _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, eventthread);
         _BAL_MUTEX_COUNTER_CHECK(eventthread);
 
-        if (0 == count)
+        if (0 == nfds)
             bal_sleep_msec(100);
         bal_thread_yield();
     }
@@ -358,6 +480,11 @@ bal_threadret _bal_eventthread(void* ctx)
 #endif
 }
 
+bool _bal_in_dispatch(void)
+{
+    return _bal_dispatching;
+}
+
 void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
 {
     BAL_ASSERT(NULL != s);
@@ -366,12 +493,22 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
     }
 
     uint32_t _events = 0U;
+    bool framed      = false;
 
 #if defined(BAL_DBGLOG_ASYNC_IO)
     _bal_dbglog("events %08"PRIx32" for socket "BAL_SOCKET_SPEC " (mask = %08"
         PRIx32")", events, sd, s->state.mask);
 #endif
 
+    /* POLLERR also means the error queue is non-empty, which is where transmit
+     * timestamps arrive; only report an error if it wasn't one of those. */
+    if (NULL != s->state.tstamp && bal_isbitset(events, BAL_EVT_ERROR) &&
+        0U != _bal_tstamp_drain(s)) {
+        bal_setbitslow(&events, BAL_EVT_ERROR);
+        if (bal_bitsinmask(s, BAL_EVT_TXTIME))
+            bal_setbitshigh(&_events, BAL_EVT_TXTIME);
+    }
+
     if (bal_isbitset(events, BAL_EVT_READ) && bal_bitsinmask(s, BAL_EVT_READ)) {
         if (bal_is_listening(s)) {
             bal_setbitshigh(&_events, BAL_EVT_ACCEPT);
@@ -385,6 +522,11 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
              * Just do that here, and translate it to a close event instead. */
             bal_setbitshigh(&_events, BAL_EVT_CLOSE);
 #endif
+        } else if (NULL != s->state.framer) {
+            /* framed sockets get one BAL_EVT_READ per complete frame (below);
+             * EOF and errors encountered while reading are reported as usual. */
+            bal_setbitshigh(&events, _bal_framer_recv(s));
+            framed = true;
         } else {
             bal_setbitshigh(&_events, BAL_EVT_READ);
         }
@@ -419,8 +561,16 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
     bool closed  = bal_isbitset(events, BAL_EVT_CLOSE);
     bool invalid = bal_isbitset(events, BAL_EVT_INVALID);
 
+    if (framed) {
+        if (!_bal_dispatch_frames(sd, s))
+            return;
+        if (NULL != s->state.framer && s->state.framer->failed &&
+            bal_bitsinmask(s, BAL_EVT_ERROR))
+            bal_setbitshigh(&_events, BAL_EVT_ERROR);
+    }
+
     if (0U != _events && _bal_okptr(s->state.proc))
-        s->state.proc(s, _events);
+        _bal_invoke_callback(s, sd, _events);
 
     if (closed || invalid) {
         /* if the callback did the right thing, it has called bal_close and
@@ -431,6 +581,7 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
         bool removed  = _bal_list_remove(_bal_as_container.lst, sd, &d);
 
         if (removed) {
+            _bal_probe1(socket__remove, sd);
             _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list"
                         " (closed/invalid)", sd, s);
         } else {
@@ -440,12 +591,44 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
     }
 }
 
+void _bal_invoke_callback(bal_socket* s, bal_descriptor sd, uint32_t events)
+{
+    for (uint32_t n = 0U; n < BAL_EVT_COUNT; n++) {
+        if (bal_isbitset(events, 1U << n))
+            _bal_count(&_bal_stats.events[n], 1U);
+    }
+
+    /* the callback may destroy the socket. */
+    if (NULL != s->state.stats)
+        _bal_count(&s->state.stats->events, 1U);
+
+    uint64_t start = _bal_monotonic_nsec();
+    s->state.proc(s, events);
+    uint64_t end = _bal_monotonic_nsec();
+    uint64_t dur = end - start;
+
+    _bal_count(&_bal_stats.callbacks, 1U);
+    _bal_count(&_bal_stats.callback_nsec, dur);
+    _bal_hist_record(BAL_HIST_CALLBACK, dur);
+    _bal_trace_span(BAL_TRACE_CALLBACK, sd, events, start, end);
+    _bal_probe3(callback__return, sd, events, dur);
+
+    /* callbacks run with the async I/O mutex held, which guards the watchdog. */
+    if (0U != _bal_watchdog.budget && dur > _bal_watchdog.budget) {
+        _bal_count(&_bal_stats.slow_callbacks, 1U);
+        _bal_dbglog("warning: callback for socket "BAL_SOCKET_SPEC" (events %08"PRIx32
+            ") took %"PRIu64" nsec", sd, events, dur);
+        if (NULL != _bal_watchdog.cb)
+            _bal_watchdog.cb(sd, events, dur, _bal_watchdog.ctx);
+    }
+}
+
 bool _bal_list_create(bal_list** lst)
 {
     bool retval = _bal_okptr(lst);
 
     if (retval) {
-        *lst = calloc(1, sizeof(bal_list));
+        *lst = _bal_calloc(1, sizeof(bal_list));
         retval = NULL != *lst;
     }
 
@@ -458,7 +641,7 @@ bool _bal_list_create_node(bal_list_node** node, bal_descriptor key,
     bool ok = _bal_okptrptr(node);
 
     if (ok) {
-        *node = calloc(1, sizeof(bal_list_node));
+        *node = _bal_calloc(1, sizeof(bal_list_node));
         if (*node) {
             (*node)->key = key;
             (*node)->val = val;
@@ -486,6 +669,8 @@ bool _bal_list_add(bal_list* lst, bal_descriptor key, bal_socket* val)
             if (ok)
                 node->next->prev = node;
         }
+        if (ok)
+            lst->count++;
     }
 
     return ok;
@@ -510,19 +695,7 @@ bool _bal_list_empty(const bal_list* lst)
 
 size_t _bal_list_count(bal_list* lst)
 {
-    size_t count = 0;
-
-    if (!_bal_list_empty(lst)) {
-        bal_descriptor key = 0;
-        bal_socket* val    = NULL;
-
-        _bal_list_reset_iterator(lst);
-        while (_bal_list_iterate(lst, &key, &val)) {
-            count++;
-        }
-    }
-
-    return count;
+    return _bal_list_empty(lst) ? 0U : lst->count;
 }
 
 bool _bal_list_iterate(bal_list* lst, bal_descriptor* key, bal_socket** val)
@@ -582,6 +755,7 @@ bool _bal_list_remove(bal_list* lst, bal_descriptor key, bal_socket** val)
                     lst->iter = lst->iter->prev;
                 *val = node->val;
                 ok   = _bal_list_destroy_node(&node);
+                lst->count--;
                 break;
             }
             node = node->next;
@@ -604,7 +778,8 @@ bool _bal_list_remove_all(bal_list* lst)
             node = next;
         }
 
-        lst->head = NULL;
+        lst->head  = NULL;
+        lst->count = 0U;
     }
 
     return ok;
@@ -741,6 +916,197 @@ bool _bal_mutex_destroy(bal_mutex* mutex)
 }
 #endif /* !__WIN__ */
 
+#if !defined(__WIN__) /* pthread condition variable implementation. */
+bool _bal_cond_create(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        int op = pthread_cond_init(cond, NULL);
+        return 0 == op ? true : _bal_handleerr(op);
+    }
+    return false;
+}
+
+bool _bal_cond_wait(bal_condition* cond, bal_mutex* mutex)
+{
+    if (_bal_okptr(cond) && _bal_okptr(mutex)) {
+        int op = pthread_cond_wait(cond, mutex);
+        return 0 == op ? true : _bal_handleerr(op);
+    }
+    return false;
+}
+
+bool _bal_cond_signal(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        int op = pthread_cond_signal(cond);
+        return 0 == op ? true : _bal_handleerr(op);
+    }
+    return false;
+}
+
+bool _bal_cond_broadcast(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        int op = pthread_cond_broadcast(cond);
+        return 0 == op ? true : _bal_handleerr(op);
+    }
+    return false;
+}
+
+bool _bal_cond_destroy(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        int op = pthread_cond_destroy(cond);
+        return 0 == op ? true : _bal_handleerr(op);
+    }
+    return false;
+}
+#else /* __WIN__ */
+bool _bal_cond_create(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        InitializeConditionVariable(cond);
+        return true;
+    }
+    return false;
+}
+
+bool _bal_cond_wait(bal_condition* cond, bal_mutex* mutex)
+{
+    if (_bal_okptr(cond) && _bal_okptr(mutex)) {
+        if (!SleepConditionVariableCS(cond, mutex, INFINITE))
+            return _bal_handleerr((int)GetLastError());
+        return true;
+    }
+    return false;
+}
+
+bool _bal_cond_signal(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        WakeConditionVariable(cond);
+        return true;
+    }
+    return false;
+}
+
+bool _bal_cond_broadcast(bal_condition* cond)
+{
+    if (_bal_okptr(cond)) {
+        WakeAllConditionVariable(cond);
+        return true;
+    }
+    return false;
+}
+
+bool _bal_cond_destroy(bal_condition* cond)
+{
+    /* Windows condition variables need no cleanup. */
+    return _bal_okptr(cond);
+}
+#endif /* !__WIN__ */
+
+#if !defined(__WIN__) /* self-pipe wakeup implementation. */
+bool _bal_wakeup_create(void)
+{
+    int fds[2] = {-1, -1};
+    if (-1 == pipe(fds))
+        return _bal_handlelasterr();
+
+    for (size_t n = 0; n < 2; n++) {
+        int flags = fcntl(fds[n], F_GETFL);
+        if (-1 == flags || -1 == fcntl(fds[n], F_SETFL, flags | O_NONBLOCK) ||
+            -1 == fcntl(fds[n], F_SETFD, FD_CLOEXEC)) {
+            (void)_bal_handlelasterr();
+            (void)close(fds[0]);
+            (void)close(fds[1]);
+            return false;
+        }
+    }
+
+    _bal_as_container.wake[0] = fds[0];
+    _bal_as_container.wake[1] = fds[1];
+    return true;
+}
+
+void _bal_wakeup_destroy(void)
+{
+    for (size_t n = 0; n < 2; n++) {
+        if (BAL_BADSOCKET != _bal_as_container.wake[n]) {
+            (void)close(_bal_as_container.wake[n]);
+            _bal_as_container.wake[n] = BAL_BADSOCKET;
+        }
+    }
+}
+
+void _bal_wakeup_signal(void)
+{
+    if (BAL_BADSOCKET != _bal_as_container.wake[1]) {
+        /* if the pipe is full, a wakeup is already pending. */
+        char b = 0;
+        ssize_t ret = write(_bal_as_container.wake[1], &b, sizeof(b));
+        BAL_UNUSED(ret);
+    }
+}
+
+void _bal_wakeup_drain(void)
+{
+    char buf[64];
+    while (0 < read(_bal_as_container.wake[0], buf, sizeof(buf)))
+        ;
+}
+#else /* __WIN__ */
+bool _bal_wakeup_create(void)
+{
+    /* WSAPoll only takes sockets, so use a UDP socket connected to itself. */
+    SOCKET sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (INVALID_SOCKET == sd)
+        return _bal_handlelasterr();
+
+    struct sockaddr_in sin = {0};
+    int sinlen             = sizeof(sin);
+    u_long nonblock        = 1;
+    sin.sin_family         = AF_INET;
+    sin.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    if (SOCKET_ERROR == bind(sd, (struct sockaddr*)&sin, sizeof(sin)) ||
+        SOCKET_ERROR == getsockname(sd, (struct sockaddr*)&sin, &sinlen) ||
+        SOCKET_ERROR == connect(sd, (struct sockaddr*)&sin, sinlen) ||
+        SOCKET_ERROR == ioctlsocket(sd, FIONBIO, &nonblock)) {
+        (void)_bal_handlelasterr();
+        (void)closesocket(sd);
+        return false;
+    }
+
+    _bal_as_container.wake[0] = sd;
+    _bal_as_container.wake[1] = sd;
+    return true;
+}
+
+void _bal_wakeup_destroy(void)
+{
+    if (BAL_BADSOCKET != _bal_as_container.wake[0])
+        (void)closesocket(_bal_as_container.wake[0]);
+    _bal_as_container.wake[0] = BAL_BADSOCKET;
+    _bal_as_container.wake[1] = BAL_BADSOCKET;
+}
+
+void _bal_wakeup_signal(void)
+{
+    if (BAL_BADSOCKET != _bal_as_container.wake[1]) {
+        char b = 0;
+        (void)send(_bal_as_container.wake[1], &b, sizeof(b), 0);
+    }
+}
+
+void _bal_wakeup_drain(void)
+{
+    char buf[64];
+    while (0 < recv(_bal_as_container.wake[0], buf, sizeof(buf), 0))
+        ;
+}
+#endif /* !__WIN__ */
+
 #if defined(__HAVE_STDATOMICS__)
 bool _bal_get_boolean(const atomic_bool* boolean)
 {
@@ -784,30 +1150,73 @@ bool _bal_once(bal_once* once, bal_once_fn func)
 #endif
 }
 
+uint64_t _bal_monotonic_msec(void)
+{
+#if defined(__WIN__)
+    return (uint64_t)GetTickCount64();
+#else
+    struct timespec ts = {0};
+    int get = clock_gettime(CLOCK_MONOTONIC, &ts);
+    BAL_ASSERT_UNUSED(get, 0 == get);
+    return ((uint64_t)ts.tv_sec * 1000ULL) + ((uint64_t)ts.tv_nsec / 1000000ULL);
+#endif
+}
+
+uint64_t _bal_monotonic_nsec(void)
+{
+#if defined(__WIN__)
+    static LARGE_INTEGER freq = {0};
+    if (0LL == freq.QuadPart)
+        (void)QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now = {0};
+    (void)QueryPerformanceCounter(&now);
+    uint64_t ticks = (uint64_t)now.QuadPart;
+    uint64_t hz    = (uint64_t)freq.QuadPart;
+    return ((ticks / hz) * 1000000000ULL) + (((ticks % hz) * 1000000000ULL) / hz);
+#else
+    struct timespec ts = {0};
+    int get = clock_gettime(CLOCK_MONOTONIC, &ts);
+    BAL_ASSERT_UNUSED(get, 0 == get);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 bool _bal_addrinfo_to_addrlist(struct addrinfo* ai, bal_addrlist* out)
 {
     if (_bal_okptr(ai) && _bal_okptr(out)) {
-        struct addrinfo* cur = ai;
-        bal_addr** a         = &out->addr;
-
-        do {
-            *a = calloc(1, sizeof(bal_addr));
-            if (!_bal_okptrnf(*a))
-                return _bal_handlelasterr();
+        size_t count = 0;
+        for (const struct addrinfo* cur = ai; NULL != cur; cur = cur->ai_next)
+            count++;
 
-            memcpy(&(*a)->addr, cur->ai_addr, cur->ai_addrlen);
+        if (!_bal_addrlist_alloc(out, count))
+            return false;
 
-            a   = &(*a)->next;
-            cur = cur->ai_next;
-        } while (NULL != cur);
+        bal_sockaddr* data = _bal_addrlist_data(out);
+        for (const struct addrinfo* cur = ai; NULL != cur; cur = cur->ai_next, data++) {
+            size_t len = (size_t)cur->ai_addrlen;
+            memcpy(data, cur->ai_addr, len < sizeof(bal_sockaddr) ? len : sizeof(bal_sockaddr));
+        }
 
-        bal_reset_addrlist(out);
         return true;
     }
 
     return false;
 }
 
+bool _bal_addrlist_alloc(bal_addrlist* al, size_t count)
+{
+    memset(al, 0, sizeof(bal_addrlist));
+
+    if (count > BAL_ADDRLIST_INLINE) {
+        al->heap = _bal_calloc(count, sizeof(bal_sockaddr));
+        if (!_bal_okptrnf(al->heap))
+            return _bal_handlelasterr();
+    }
+
+    al->count = count;
+    return true;
+}
+
 void _bal_strcpy(char* dest, size_t destsz, const char* src, size_t srcsz)
 {
     if (_bal_okptr(dest) && _bal_oklen(destsz) && _bal_okstr(src) &&
@@ -835,7 +1244,7 @@ void _bal_strcpy(char* dest, size_t destsz, const char* src, size_t srcsz)
     }
 }
 
-#if defined(BAL_DBGLOG)
+#if defined(BAL_DBGLOG) || defined(__HAVE_BAL_TRACE__)
 pid_t _bal_gettid(void)
 {
     pid_t tid = 0;
@@ -880,6 +1289,18 @@ void _bal_static_once_init_func(void)
 
     create = _bal_mutex_create(&_bal_as_container.mutex);
     BAL_ASSERT_UNUSED(create, create);
+
+    create = _bal_mutex_create(&_bal_resolver.mutex);
+    BAL_ASSERT_UNUSED(create, create);
+
+    create = _bal_cond_create(&_bal_resolver.cond);
+    BAL_ASSERT_UNUSED(create, create);
+
+    create = _bal_mutex_create(&_bal_rescache.mutex);
+    BAL_ASSERT_UNUSED(create, create);
+
+    create = _bal_mutex_create(&_bal_rdnscache.mutex);
+    BAL_ASSERT_UNUSED(create, create);
 #if defined(__HAVE_STDATOMICS__)
     atomic_init(&_bal_state.magic, 0U);
     atomic_init(&_bal_async_poll_init, false);
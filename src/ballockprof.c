@@ -0,0 +1,133 @@
+/*
+ * ballockprof.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+#if defined(__HAVE_BAL_LOCKPROF__)
+/* registry of every lock site used so far (lock-free: pushed, never unlinked). */
+static _Atomic(bal_locksite*) _bal_locksites = NULL;
+
+static void _bal_lockprof_max(bal_counter* c, uint64_t value);
+#endif /* !__HAVE_BAL_LOCKPROF__ */
+
+/**
+ * Exported functions
+ */
+
+bool bal_get_lock_stats(bal_lock_stats* out, size_t* count)
+{
+#if !defined(__HAVE_BAL_LOCKPROF__)
+    BAL_UNUSED(out);
+    BAL_UNUSED(count);
+    return _bal_seterror(_BAL_E_UNAVAIL);
+#else
+    if (!_bal_okptr(count) || (0 != *count && !_bal_okptr(out)))
+        return false;
+
+    /* fills in as many sites as there is room for, and reports how many exist. */
+    size_t sites = 0;
+    for (bal_locksite* site = atomic_load(&_bal_locksites); NULL != site;
+        site = site->next) {
+        if (sites < *count) {
+            bal_lock_stats* st = &out[sites];
+            st->site           = site->name;
+            st->acquisitions   = _bal_counter_get(&site->acquisitions);
+            st->wait_nsec      = _bal_counter_get(&site->wait);
+            st->max_wait_nsec  = _bal_counter_get(&site->max_wait);
+            st->hold_nsec      = _bal_counter_get(&site->hold);
+            st->max_hold_nsec  = _bal_counter_get(&site->max_hold);
+        }
+        sites++;
+    }
+
+    *count = sites;
+    return true;
+#endif
+}
+
+bool bal_reset_lock_stats(void)
+{
+#if !defined(__HAVE_BAL_LOCKPROF__)
+    return _bal_seterror(_BAL_E_UNAVAIL);
+#else
+    for (bal_locksite* site = atomic_load(&_bal_locksites); NULL != site;
+        site = site->next) {
+        atomic_store_explicit(&site->acquisitions, 0U, memory_order_relaxed);
+        atomic_store_explicit(&site->wait, 0U, memory_order_relaxed);
+        atomic_store_explicit(&site->max_wait, 0U, memory_order_relaxed);
+        atomic_store_explicit(&site->hold, 0U, memory_order_relaxed);
+        atomic_store_explicit(&site->max_hold, 0U, memory_order_relaxed);
+    }
+
+    return true;
+#endif
+}
+
+#if defined(__HAVE_BAL_LOCKPROF__)
+/**
+ * Internal functions
+ */
+
+uint64_t _bal_lockprof_acquired(bal_locksite* site, uint64_t start)
+{
+    uint64_t now = _bal_monotonic_nsec();
+
+    if (!atomic_load_explicit(&site->registered, memory_order_acquire) &&
+        !atomic_exchange(&site->registered, true)) {
+        bal_locksite* head = atomic_load(&_bal_locksites);
+        do {
+            site->next = head;
+        } while (!atomic_compare_exchange_weak(&_bal_locksites, &head, site));
+    }
+
+    _bal_count(&site->acquisitions, 1U);
+    _bal_count(&site->wait, now - start);
+    _bal_lockprof_max(&site->max_wait, now - start);
+
+    return now;
+}
+
+void _bal_lockprof_released(bal_locksite* site, uint64_t acquired)
+{
+    uint64_t held = _bal_monotonic_nsec() - acquired;
+
+    _bal_count(&site->hold, held);
+    _bal_lockprof_max(&site->max_hold, held);
+}
+
+/**
+ * Static functions
+ */
+
+static void _bal_lockprof_max(bal_counter* c, uint64_t value)
+{
+    /* updated with the site's mutex held, but bal_reset_lock_stats doesn't take it. */
+    uint_fast64_t cur = atomic_load_explicit(c, memory_order_relaxed);
+    while (value > cur && !atomic_compare_exchange_weak_explicit(c, &cur, value,
+        memory_order_relaxed, memory_order_relaxed));
+}
+#endif /* !__HAVE_BAL_LOCKPROF__ */
@@ -0,0 +1,483 @@
+/*
+ * ballog.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#if defined(BAL_DBGLOG)
+# if defined(__HAVE_ASYNC_DBGLOG__)
+/* registry of every thread's ring (lock-free: pushed, never unlinked). */
+static _Atomic(bal_log_ring*) _bal_log_rings = NULL;
+
+/* the calling thread's ring. */
+static _bal_thread_local bal_log_ring* _bal_log_ring_tls = NULL;
+
+static atomic_bool _bal_log_started  = false;
+static atomic_bool _bal_log_running  = false;
+static atomic_bool _bal_log_die      = false;
+static atomic_uint_fast64_t _bal_log_written = 0U;
+static bal_thread _bal_log_thread    = BAL_THREAD_INIT;
+
+#  if defined(__WIN__)
+static DWORD _bal_log_fls = FLS_OUT_OF_INDEXES;
+#  else
+static pthread_key_t _bal_log_key;
+#  endif
+
+static bal_log_ring* _bal_log_get_ring(void);
+static bool _bal_log_drain(void);
+static bool _bal_log_start(void);
+static void _bal_log_stop(void);
+#  if defined(__WIN__)
+static void WINAPI _bal_log_thread_exit(void* ctx);
+static unsigned __stdcall _bal_log_thread_func(void* ctx);
+#  else
+static void _bal_log_thread_exit(void* ctx);
+static void* _bal_log_thread_func(void* ctx);
+#  endif
+# endif /* !__HAVE_ASYNC_DBGLOG__ */
+
+/**
+ * Internal functions
+ */
+
+void _bal_log_write(pid_t tid, const char* func, const char* file, uint32_t line,
+    const char* msg)
+{
+    const char* color = "0";
+# if defined(__WIN__)
+    if (NULL != StrStrIA(msg, "error") || NULL != StrStrIA(msg, "assert"))
+        color = "91";
+    else if (NULL != StrStrIA(msg, "warn"))
+        color = "33";
+# else
+    if (NULL != strcasestr(msg, "error") || NULL != strcasestr(msg, "assert"))
+        color = "91";
+    else if (NULL != strcasestr(msg, "warn"))
+        color = "33";
+# endif
+# if defined(BAL_DBGLOG_WARNERR_ONLY)
+    /* if this macro is defined, only log warnings and errors. */
+    if (strncmp("0", color, 2) < 0)
+# endif
+        (void)printf("\x1b[%sm["BAL_TID_SPEC"] %s (%s:%"PRIu32"): %s\x1b[0m\n", color,
+            tid, func, file, line, msg);
+}
+
+# if defined(__HAVE_ASYNC_DBGLOG__)
+bool _bal_log_enqueue(const char* func, const char* file, uint32_t line,
+    const char* format, va_list args)
+{
+    bal_log_ring* ring = _bal_log_get_ring();
+    if (NULL == ring)
+        return false;
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail - head >= BAL_DBGLOG_RINGSIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1U, memory_order_relaxed);
+        return true;
+    }
+
+    bal_log_record* rec = &ring->recs[tail & (BAL_DBGLOG_RINGSIZE - 1U)];
+    rec->func = func;
+    rec->file = file;
+    rec->line = line;
+
+    va_list capture;
+    va_copy(capture, args);
+    bool captured = _bal_log_capture(rec, format, capture);
+    va_end(capture);
+
+    if (!captured) {
+        /* not something the log thread can reproduce; format it now. */
+        rec->format = NULL;
+        rec->nargs  = 0U;
+        (void)vsnprintf(rec->strs, sizeof(rec->strs), format, args);
+    }
+
+    atomic_store_explicit(&ring->tail, tail + 1U, memory_order_release);
+    return true;
+}
+
+void _bal_log_flush(void)
+{
+    /* wait (briefly) for the log thread to catch up. */
+    for (int n = 0; n < 500 && atomic_load(&_bal_log_running); n++) {
+        bool empty = true;
+        for (bal_log_ring* ring = atomic_load(&_bal_log_rings); NULL != ring;
+            ring = ring->next) {
+            if (atomic_load(&ring->head) != atomic_load(&ring->tail))
+                empty = false;
+        }
+        if (empty)
+            break;
+        bal_sleep_msec(BAL_DBGLOG_IDLE_MSEC);
+    }
+}
+
+void _bal_log_get_stats(uint64_t* written, uint64_t* dropped)
+{
+    uint64_t total = 0U;
+    for (bal_log_ring* ring = atomic_load(&_bal_log_rings); NULL != ring;
+        ring = ring->next)
+        total += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+
+    *written = atomic_load(&_bal_log_written);
+    *dropped = total;
+}
+
+bool _bal_log_capture(bal_log_record* rec, const char* format, va_list args)
+{
+    size_t nargs = 0U;
+    size_t used  = 0U;
+
+    for (const char* cur = format; '\0' != *cur; cur++) {
+        if ('%' != *cur)
+            continue;
+        if ('%' == *++cur)
+            continue;
+
+        /* flags, width and precision ('*' would consume arguments). */
+        while ('\0' != *cur && NULL != strchr("-+ #0123456789.", *cur))
+            cur++;
+        if ('*' == *cur || '\0' == *cur)
+            return false;
+
+        int longs  = 0;
+        int shorts = 0;
+        char size  = '\0';
+        for (; '\0' != *cur && NULL != strchr("hlzjt", *cur); cur++) {
+            if ('l' == *cur)
+                longs++;
+            else if ('h' == *cur)
+                shorts++;
+            else
+                size = *cur;
+        }
+
+        /* wide characters/strings are left to vsnprintf. */
+        if (nargs >= BAL_DBGLOG_MAXARGS || (0 < longs && ('c' == *cur || 's' == *cur)))
+            return false;
+
+        bal_log_arg* arg = &rec->args[nargs++];
+        switch (*cur) {
+            case 'd': case 'i': case 'c':
+                if (2 <= longs)
+                    arg->i = va_arg(args, long long);
+                else if (1 == longs)
+                    arg->i = va_arg(args, long);
+                else if ('z' == size)
+                    arg->i = (intmax_t)va_arg(args, ssize_t);
+                else if ('j' == size)
+                    arg->i = va_arg(args, intmax_t);
+                else if ('t' == size)
+                    arg->i = va_arg(args, ptrdiff_t);
+                else if (1 == shorts)
+                    arg->i = (short)va_arg(args, int);
+                else if (2 <= shorts)
+                    arg->i = (signed char)va_arg(args, int);
+                else
+                    arg->i = va_arg(args, int);
+            break;
+            case 'u': case 'o': case 'x': case 'X':
+                if (2 <= longs)
+                    arg->u = va_arg(args, unsigned long long);
+                else if (1 == longs)
+                    arg->u = va_arg(args, unsigned long);
+                else if ('z' == size)
+                    arg->u = va_arg(args, size_t);
+                else if ('j' == size)
+                    arg->u = va_arg(args, uintmax_t);
+                else if ('t' == size)
+                    arg->u = (uintmax_t)va_arg(args, ptrdiff_t);
+                else if (1 == shorts)
+                    arg->u = (unsigned short)va_arg(args, unsigned int);
+                else if (2 <= shorts)
+                    arg->u = (unsigned char)va_arg(args, unsigned int);
+                else
+                    arg->u = va_arg(args, unsigned int);
+            break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                arg->d = va_arg(args, double);
+            break;
+            case 'p':
+                arg->p = va_arg(args, void*);
+            break;
+            case 's': {
+                const char* str = va_arg(args, const char*);
+                if (NULL == str)
+                    str = "(null)";
+                size_t len = strnlen(str, sizeof(rec->strs) - used);
+                if (used + len >= sizeof(rec->strs))
+                    return false;
+                memcpy(&rec->strs[used], str, len);
+                rec->strs[used + len] = '\0';
+                arg->str = used;
+                used += len + 1U;
+            }
+            break;
+            default:
+                /* %n, %L, and anything else unusual. */
+                return false;
+        }
+    }
+
+    rec->format = format;
+    rec->nargs  = nargs;
+    return true;
+}
+
+size_t _bal_log_format(const bal_log_record* rec, char* buf, size_t size)
+{
+    if (NULL == rec->format)
+        return (size_t)snprintf(buf, size, "%s", rec->strs);
+
+    size_t len   = 0U;
+    size_t nargs = 0U;
+
+    for (const char* cur = rec->format; '\0' != *cur && len + 1U < size;) {
+        if ('%' != *cur || '%' == cur[1]) {
+            buf[len++] = *cur;
+            cur += '%' == *cur ? 2 : 1;
+            continue;
+        }
+
+        /* rebuild the conversion with the length modifier matching the type
+         * the argument was captured as; flags, width and precision are kept. */
+        char spec[32] = {'%'};
+        size_t n      = 1U;
+        for (cur++; '\0' != *cur && NULL == strchr("diouxXcspeEfFgGaA", *cur); cur++) {
+            if (NULL == strchr("hlzjt", *cur) && n < sizeof(spec) - 3U)
+                spec[n++] = *cur;
+        }
+
+        if ('\0' == *cur || nargs >= rec->nargs)
+            break;
+
+        const bal_log_arg* arg = &rec->args[nargs++];
+        char conv   = *cur++;
+        char* out   = &buf[len];
+        size_t left = size - len;
+        int fmt     = 0;
+
+        switch (conv) {
+            case 'd': case 'i':
+                spec[n++] = 'j';
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, arg->i);
+            break;
+            case 'u': case 'o': case 'x': case 'X':
+                spec[n++] = 'j';
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, arg->u);
+            break;
+            case 'c':
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, (int)arg->i);
+            break;
+            case 'p':
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, arg->p);
+            break;
+            case 's':
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, &rec->strs[arg->str]);
+            break;
+            default:
+                spec[n++] = conv;
+                fmt = snprintf(out, left, spec, arg->d);
+            break;
+        }
+
+        if (fmt > 0)
+            len += (size_t)fmt < left ? (size_t)fmt : left - 1U;
+    }
+
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Static functions
+ */
+
+static bal_log_ring* _bal_log_get_ring(void)
+{
+    if (NULL != _bal_log_ring_tls)
+        return _bal_log_ring_tls;
+
+    if (!_bal_log_start())
+        return NULL;
+
+    /* reuse the ring of a thread that has exited, once it has been drained. */
+    bal_log_ring* ring = NULL;
+    for (bal_log_ring* cur = atomic_load(&_bal_log_rings); NULL != cur; cur = cur->next) {
+        bool orphaned = true;
+        if (atomic_load(&cur->head) == atomic_load(&cur->tail) &&
+            atomic_compare_exchange_strong(&cur->orphaned, &orphaned, false)) {
+            ring = cur;
+            break;
+        }
+    }
+
+    if (NULL == ring) {
+        ring = calloc(1, sizeof(bal_log_ring));
+        if (NULL == ring)
+            return NULL;
+
+        atomic_init(&ring->head, 0U);
+        atomic_init(&ring->tail, 0U);
+        atomic_init(&ring->dropped, 0U);
+        atomic_init(&ring->orphaned, false);
+
+        bal_log_ring* head = atomic_load(&_bal_log_rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&_bal_log_rings, &head, ring));
+    }
+
+    ring->tid         = _bal_gettid();
+    _bal_log_ring_tls = ring;
+
+#  if defined(__WIN__)
+    (void)FlsSetValue(_bal_log_fls, ring);
+#  else
+    (void)pthread_setspecific(_bal_log_key, ring);
+#  endif
+
+    return ring;
+}
+
+static bool _bal_log_drain(void)
+{
+    bool drained = false;
+    char msg[BAL_DBGLOG_MAXMSG];
+
+    for (bal_log_ring* ring = atomic_load(&_bal_log_rings); NULL != ring;
+        ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        for (; head != tail; head++) {
+            const bal_log_record* rec = &ring->recs[head & (BAL_DBGLOG_RINGSIZE - 1U)];
+            (void)_bal_log_format(rec, msg, sizeof(msg));
+            _bal_log_write(ring->tid, rec->func, rec->file, rec->line, msg);
+            atomic_store_explicit(&ring->head, head + 1U, memory_order_release);
+            atomic_fetch_add_explicit(&_bal_log_written, 1U, memory_order_relaxed);
+            drained = true;
+        }
+
+        uint_fast64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->reported) {
+            (void)snprintf(msg, sizeof(msg), "warning: %"PRIuFAST64" log message(s) dropped"
+                " (ring full)", dropped - ring->reported);
+            _bal_log_write(ring->tid, __func__, __file__, __LINE__, msg);
+            ring->reported = dropped;
+            drained        = true;
+        }
+    }
+
+    if (drained)
+        (void)fflush(stdout);
+
+    return drained;
+}
+
+static bool _bal_log_start(void)
+{
+    bool started = false;
+    if (!atomic_compare_exchange_strong(&_bal_log_started, &started, true))
+        return atomic_load(&_bal_log_running);
+
+    /* the log thread lives as long as the process; it is stopped (and the rings
+     * drained one last time) at exit. */
+#  if defined(__WIN__)
+    _bal_log_fls = FlsAlloc(&_bal_log_thread_exit);
+    _bal_log_thread = _beginthreadex(NULL, 0U, &_bal_log_thread_func, NULL, 0U, NULL);
+    bool ok = FLS_OUT_OF_INDEXES != _bal_log_fls && 0ULL != _bal_log_thread;
+#  else
+    bool ok = 0 == pthread_key_create(&_bal_log_key, &_bal_log_thread_exit) &&
+        0 == pthread_create(&_bal_log_thread, NULL, &_bal_log_thread_func, NULL);
+#  endif
+
+    if (ok)
+        ok = 0 == atexit(&_bal_log_stop);
+
+    /* if the thread couldn't be started, everything is logged synchronously;
+     * `_bal_log_started` stays set so that no one tries again. */
+    atomic_store(&_bal_log_running, ok);
+    return ok;
+}
+
+static void _bal_log_stop(void)
+{
+    atomic_store(&_bal_log_die, true);
+#  if defined(__WIN__)
+    (void)WaitForSingleObject((HANDLE)_bal_log_thread, INFINITE);
+    (void)CloseHandle((HANDLE)_bal_log_thread);
+#  else
+    (void)pthread_join(_bal_log_thread, NULL);
+#  endif
+    (void)_bal_log_drain();
+}
+
+#  if defined(__WIN__)
+static void WINAPI _bal_log_thread_exit(void* ctx)
+#  else
+static void _bal_log_thread_exit(void* ctx)
+#  endif
+{
+    bal_log_ring* ring = (bal_log_ring*)ctx;
+    if (NULL != ring)
+        atomic_store(&ring->orphaned, true);
+}
+
+#  if defined(__WIN__)
+static unsigned __stdcall _bal_log_thread_func(void* ctx)
+#  else
+static void* _bal_log_thread_func(void* ctx)
+#  endif
+{
+    BAL_UNUSED(ctx);
+
+    while (!atomic_load(&_bal_log_die)) {
+        if (!_bal_log_drain())
+            bal_sleep_msec(BAL_DBGLOG_IDLE_MSEC);
+    }
+
+#  if defined(__WIN__)
+    return 0U;
+#  else
+    return NULL;
+#  endif
+}
+# endif /* !__HAVE_ASYNC_DBGLOG__ */
+#endif /* !BAL_DBGLOG */
@@ -0,0 +1,292 @@
+/*
+ * balparse.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+static bool _bal_parse_port(const char* str, uint16_t* out);
+static bool _bal_parse_ipv4(const char* str, struct in_addr* out);
+static bool _bal_parse_ipv6(const char* str, struct sockaddr_in6* out);
+static size_t _bal_format_uint(uint32_t val, char* buf, size_t size);
+
+/**
+ * Exported functions
+ */
+
+bool bal_parse_addr(const char* host, const char* port, bal_sockaddr* out)
+{
+    if (!_bal_okstr(host) || !_bal_okptr(out))
+        return false;
+
+    if (!_bal_parse_addr(host, port, out))
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    return true;
+}
+
+size_t bal_format_addr(const bal_sockaddr* in, char* buf, size_t size)
+{
+    if (!_bal_okptr(in) || !_bal_okptr(buf))
+        return 0U;
+
+    if (PF_INET != in->ss_family && PF_INET6 != in->ss_family) {
+        (void)_bal_seterror(_BAL_E_INVALIDARG);
+        return 0U;
+    }
+
+    /* IPv6 addresses are bracketed so that the port is unambiguous. */
+    bool v6       = PF_INET6 == in->ss_family;
+    uint16_t port = v6 ? ((const struct sockaddr_in6*)in)->sin6_port
+                       : ((const struct sockaddr_in*)in)->sin_port;
+    size_t len    = 0U;
+
+    if (v6 && size > 1U)
+        buf[len++] = '[';
+
+    size_t fmt = _bal_format_ipaddr(in, buf + len, size - len);
+    len += fmt;
+
+    if (0U != fmt && v6) {
+        if (len + 1U < size)
+            buf[len++] = ']';
+        else
+            fmt = 0U;
+    }
+
+    if (0U != fmt) {
+        if (len + 1U < size) {
+            buf[len++] = ':';
+            fmt = _bal_format_port(ntohs(port), buf + len, size - len);
+            len += fmt;
+        } else {
+            fmt = 0U;
+        }
+    }
+
+    if (0U == fmt) {
+        if (0U != size)
+            buf[0] = '\0';
+        (void)_bal_seterror(_BAL_E_BADBUFLEN);
+        return 0U;
+    }
+
+    return len;
+}
+
+/**
+ * Internal functions
+ */
+
+bool _bal_parse_addr(const char* host, const char* port, bal_sockaddr* out)
+{
+    uint16_t nport = 0;
+    if (NULL != port && !_bal_parse_port(port, &nport))
+        return false;
+
+    memset(out, 0, sizeof(bal_sockaddr));
+
+    struct sockaddr_in* sin = (struct sockaddr_in*)out;
+    if (_bal_parse_ipv4(host, &sin->sin_addr)) {
+        sin->sin_family = AF_INET;
+        sin->sin_port   = htons(nport);
+        return true;
+    }
+
+    struct sockaddr_in6* sin6 = (struct sockaddr_in6*)out;
+    if (_bal_parse_ipv6(host, sin6)) {
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port   = htons(nport);
+        return true;
+    }
+
+    return false;
+}
+
+size_t _bal_format_ipaddr(const bal_sockaddr* in, char* buf, size_t size)
+{
+    size_t len = 0U;
+
+    if (PF_INET == in->ss_family) {
+        uint32_t addr = ntohl(((const struct sockaddr_in*)in)->sin_addr.s_addr);
+        for (int octet = 3; octet >= 0; octet--) {
+            size_t fmt = _bal_format_uint((addr >> (octet * 8)) & 0xffU, buf + len,
+                size - len);
+            if (0U == fmt)
+                return 0U;
+            len += fmt;
+            if (0 != octet) {
+                if (len + 1U >= size)
+                    return 0U;
+                buf[len++] = '.';
+            }
+        }
+    } else if (PF_INET6 == in->ss_family) {
+        const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)in;
+        if (NULL == inet_ntop(AF_INET6, &sin6->sin6_addr, buf, (socklen_t)size))
+            return 0U;
+        len = strnlen(buf, size);
+        /* the scope is always numeric; getnameinfo would map it to an interface
+         * name, which costs a system call. */
+        if (0U != sin6->sin6_scope_id) {
+            if (len + 1U >= size)
+                return 0U;
+            buf[len++] = '%';
+            size_t fmt = _bal_format_uint(sin6->sin6_scope_id, buf + len, size - len);
+            if (0U == fmt)
+                return 0U;
+            len += fmt;
+        }
+    }
+
+    return len;
+}
+
+size_t _bal_format_port(uint16_t port, char* buf, size_t size)
+{
+    return _bal_format_uint(port, buf, size);
+}
+
+/**
+ * Static functions
+ */
+
+static bool _bal_parse_port(const char* str, uint16_t* out)
+{
+    uint32_t val = 0;
+    size_t len   = 0;
+
+    for (; '\0' != str[len]; len++) {
+        if (str[len] < '0' || str[len] > '9' || len >= 5)
+            return false;
+        val = (val * 10U) + (uint32_t)(str[len] - '0');
+    }
+
+    if (0U == len || val > UINT16_MAX)
+        return false;
+
+    *out = (uint16_t)val;
+    return true;
+}
+
+static bool _bal_parse_ipv4(const char* str, struct in_addr* out)
+{
+    uint32_t addr = 0;
+
+    for (int octet = 0; octet < 4; octet++) {
+        if (0 < octet && '.' != *str++)
+            return false;
+
+        /* leading zeros are left to the resolver, which may read them as octal. */
+        const char* start = str;
+        uint32_t val      = 0;
+        while (*str >= '0' && *str <= '9' && str - start < 3)
+            val = (val * 10U) + (uint32_t)(*str++ - '0');
+
+        size_t digits = (size_t)(str - start);
+        if (0U == digits || val > 255U || (1U < digits && '0' == *start))
+            return false;
+
+        addr = (addr << 8) | val;
+    }
+
+    if ('\0' != *str)
+        return false;
+
+    out->s_addr = htonl(addr);
+    return true;
+}
+
+static bool _bal_parse_ipv6(const char* str, struct sockaddr_in6* out)
+{
+    char buf[INET6_ADDRSTRLEN] = {0};
+    const char* scope          = NULL;
+    size_t len                 = 0;
+    bool colon                 = false;
+
+    for (; '\0' != str[len] && '%' != str[len]; len++) {
+        if (len >= sizeof(buf) - 1)
+            return false;
+        colon |= ':' == str[len];
+    }
+
+    if (!colon)
+        return false;
+
+    if ('%' == str[len]) {
+        scope = &str[len + 1];
+        if ('\0' == *scope)
+            return false;
+    }
+
+    memcpy(buf, str, len);
+    if (1 != inet_pton(AF_INET6, buf, &out->sin6_addr))
+        return false;
+
+    if (NULL != scope) {
+        uint64_t index  = 0;
+        const char* cur = scope;
+        while (*cur >= '0' && *cur <= '9' && index <= UINT32_MAX)
+            index = (index * 10U) + (uint64_t)(*cur++ - '0');
+
+        if (index > UINT32_MAX)
+            return false;
+
+        if ('\0' != *cur) {
+#if defined(__WIN__)
+            /* interface names are left to the resolver. */
+            return false;
+#else
+            index = if_nametoindex(scope);
+            if (0U == index)
+                return false;
+#endif
+        }
+
+        out->sin6_scope_id = (uint32_t)index;
+    }
+
+    return true;
+}
+
+static size_t _bal_format_uint(uint32_t val, char* buf, size_t size)
+{
+    char tmp[10];
+    size_t len = 0U;
+
+    do {
+        tmp[len++] = (char)('0' + (val % 10U));
+        val /= 10U;
+    } while (0U != val);
+
+    if (len >= size)
+        return 0U;
+
+    for (size_t n = 0; n < len; n++)
+        buf[n] = tmp[len - n - 1U];
+    buf[len] = '\0';
+
+    return len;
+}
@@ -0,0 +1,695 @@
+/*
+ * balpool.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+/** Events that complete the hand-over of a connection to a checkout. */
+#define _BAL_POOL_EVTS \
+    (BAL_EVT_WRITE | BAL_EVT_CONNECT | BAL_EVT_CONNFAIL | BAL_EVT_CLOSE | \
+     BAL_EVT_ERROR | BAL_EVT_INVALID)
+
+/** Events that mean the connection can't be handed over after all. */
+#define _BAL_POOL_FAILEVTS \
+    (BAL_EVT_CONNFAIL | BAL_EVT_CLOSE | BAL_EVT_ERROR | BAL_EVT_INVALID)
+
+static bal_pool_dest* _bal_pool_get_dest(bal_pool* pool, const char* host,
+    const char* port);
+static bal_socket* _bal_pool_take_idle(bal_pool_dest* dest);
+static bal_socket* _bal_pool_connect(const char* host, const char* port);
+static bool _bal_pool_submit(bal_pool_dest* dest, bal_pool_req* req);
+static bool _bal_pool_open(bal_pool_dest* dest, bal_pool_req* req);
+static bool _bal_pool_hand_over(bal_pool_dest* dest, bal_pool_req* req, bal_socket* s);
+static void _bal_pool_on_resolved(bal_addrlist* addrs, void* ctx);
+static void _bal_pool_on_io(bal_socket* s, uint32_t events);
+static void _bal_pool_slot_freed(bal_pool_dest* dest);
+static void _bal_pool_complete(bal_pool_req* req, bal_socket* s);
+static bal_pool_req* _bal_pool_find_req(const bal_pool_dest* dest, const bal_socket* s);
+static void _bal_pool_unlink(bal_pool_req** list, const bal_pool_req* req);
+static void _bal_pool_push_waiter(bal_pool_dest* dest, bal_pool_req* req, bool front);
+static void _bal_pool_unregister(bal_socket* s);
+static void _bal_pool_dest_free(bal_pool_dest** dest);
+static char* _bal_pool_strdup(const char* str);
+
+/**
+ * Exported functions
+ */
+
+bool bal_pool_create(bal_pool** pool, const bal_pool_cfg* cfg)
+{
+    if (!_bal_okptrptr(pool))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bal_pool_cfg tmp = {0};
+    if (NULL != cfg)
+        tmp = *cfg;
+
+    if (tmp.idle_ttl_sec > UINT32_MAX / 1000U)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    if (0U == tmp.max_total)
+        tmp.max_total = BAL_POOL_MAX_TOTAL;
+    if (0U == tmp.max_idle)
+        tmp.max_idle = BAL_POOL_MAX_IDLE;
+    if (tmp.max_idle > tmp.max_total)
+        tmp.max_idle = tmp.max_total;
+
+    *pool = _bal_calloc(1, sizeof(bal_pool));
+    if (!_bal_okptrnf(*pool))
+        return _bal_handlelasterr();
+
+    (*pool)->cfg = tmp;
+    return true;
+}
+
+bool bal_pool_destroy(bal_pool** pool)
+{
+    if (!_bal_okptrptr(pool) || !_bal_okptr(*pool))
+        return false;
+
+    _BAL_MUTEX_COUNTER_INIT(pooldestroy);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, pooldestroy);
+
+    while (NULL != (*pool)->dests) {
+        bal_pool_dest* dest = (*pool)->dests;
+        (*pool)->dests      = dest->next;
+        dest->next          = NULL;
+
+        /* checkouts still waiting for a slot complete now, empty-handed. */
+        bal_pool_req* req  = dest->waiters;
+        dest->waiters      = NULL;
+        dest->waiters_tail = NULL;
+        while (NULL != req) {
+            bal_pool_req* next = req->next;
+            _bal_pool_complete(req, NULL);
+            req = next;
+        }
+
+        /* as do those being handed a connection. those still resolving find
+         * out that the pool is gone when the resolver is done. */
+        req = dest->pending;
+        while (NULL != req) {
+            bal_pool_req* next = req->next;
+            if (NULL != req->s) {
+                _bal_pool_unlink(&dest->pending, req);
+                (void)bal_close(&req->s, true);
+                _bal_pool_complete(req, NULL);
+            }
+            req = next;
+        }
+
+        while (dest->nidle > 0U) {
+            bal_socket* s = dest->idle[--dest->nidle].s;
+            (void)bal_close(&s, true);
+        }
+
+        /* connections checked out from here keep it alive until they're gone. */
+        dest->pool = NULL;
+        if (0U == dest->total)
+            _bal_pool_dest_free(&dest);
+    }
+
+    _bal_safefree(pool);
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, pooldestroy);
+    _BAL_MUTEX_COUNTER_CHECK(pooldestroy);
+
+    return true;
+}
+
+bool bal_pool_checkout(bal_pool* pool, const char* host, const char* port, bal_socket** out)
+{
+    if (!_bal_okptr(pool) || !_bal_okstr(host) || !_bal_okstr(port) ||
+        !_bal_okptrptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bool retval   = false;
+    bool reserved = false;
+
+    _BAL_MUTEX_COUNTER_INIT(poolcheckout);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolcheckout);
+
+    bal_pool_dest* dest = _bal_pool_get_dest(pool, host, port);
+    if (NULL != dest) {
+        *out = _bal_pool_take_idle(dest);
+        if (NULL != *out) {
+            pool->stats.reused++;
+            retval = true;
+        } else if (dest->total < pool->cfg.max_total) {
+            dest->total++;
+            reserved = true;
+        } else {
+            pool->stats.failures++;
+            (void)_bal_seterror(_BAL_E_POOLFULL);
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolcheckout);
+
+    if (reserved) {
+        /* the slot is held while connecting, but the lock isn't: the event
+         * thread would otherwise stall until the handshake is done. */
+        bal_socket* s = _bal_pool_connect(host, port);
+
+        _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolcheckout);
+
+        if (NULL != s) {
+            s->state.pool = dest;
+            if (NULL != dest->pool)
+                dest->pool->stats.created++;
+            *out   = s;
+            retval = true;
+        } else {
+            bal_thread_error_info err;
+            _bal_save_error(&err);
+            if (NULL != dest->pool)
+                dest->pool->stats.failures++;
+            dest->total--;
+            _bal_pool_slot_freed(dest);
+            _bal_restore_error(&err);
+        }
+
+        _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolcheckout);
+    }
+
+    _BAL_MUTEX_COUNTER_CHECK(poolcheckout);
+
+    return retval;
+}
+
+bool bal_pool_checkout_async(bal_pool* pool, const char* host, const char* port,
+    bal_pool_cb cb, void* ctx)
+{
+    if (!_bal_okptr(pool) || !_bal_okstr(host) || !_bal_okstr(port) || !_bal_okptr(cb))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bool retval = false;
+
+    _BAL_MUTEX_COUNTER_INIT(poolcheckoutasync);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolcheckoutasync);
+
+    bal_pool_dest* dest = _bal_pool_get_dest(pool, host, port);
+    if (NULL != dest) {
+        bal_pool_req* req = _bal_calloc(1, sizeof(bal_pool_req));
+        if (!_bal_okptrnf(req)) {
+            (void)_bal_handlelasterr();
+        } else {
+            req->cb   = cb;
+            req->ctx  = ctx;
+            req->dest = dest;
+
+            retval = _bal_pool_submit(dest, req);
+            if (!retval) {
+                pool->stats.failures++;
+                _bal_safefree(&req);
+            }
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolcheckoutasync);
+    _BAL_MUTEX_COUNTER_CHECK(poolcheckoutasync);
+
+    return retval;
+}
+
+bool bal_pool_checkin(bal_socket** s, bool reuse)
+{
+    if (!_bal_okptrptr(s) || !_bal_oksock(*s))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bool retval = false;
+
+    _BAL_MUTEX_COUNTER_INIT(poolcheckin);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolcheckin);
+
+    bal_pool_dest* dest = (*s)->state.pool;
+    if (NULL == dest || NULL != _bal_pool_find_req(dest, *s)) {
+        /* not pooled, or not checked out yet. */
+        (void)_bal_seterror(_BAL_E_INVALIDARG);
+    } else {
+        const bal_pool* pool = dest->pool;
+        bool keep            = reuse && NULL != pool && !_bal_is_closed_conn(*s);
+
+        if (keep) {
+            /* the next user starts out with a blocking, unregistered
+             * connection, just as if it were new. */
+            if (_bal_coalescer_pending((*s)->state.coalesce))
+                (void)bal_flush(*s);
+            _bal_pool_unregister(*s);
+            (*s)->user_data = 0U;
+
+            if (NULL != dest->waiters) {
+                bal_pool_req* req = dest->waiters;
+                dest->waiters     = req->next;
+                if (NULL == dest->waiters)
+                    dest->waiters_tail = NULL;
+                if (!_bal_pool_hand_over(dest, req, *s)) {
+                    /* closing it below opens another for this checkout. */
+                    _bal_pool_push_waiter(dest, req, true);
+                    keep = false;
+                }
+            } else if (dest->nidle < pool->cfg.max_idle) {
+                dest->idle[dest->nidle].s     = *s;
+                dest->idle[dest->nidle].since = _bal_monotonic_msec();
+                dest->nidle++;
+            } else {
+                keep = false;
+            }
+        }
+
+        if (keep)
+            *s = NULL;
+        else
+            (void)bal_close(s, true);
+
+        retval = true;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolcheckin);
+    _BAL_MUTEX_COUNTER_CHECK(poolcheckin);
+
+    return retval;
+}
+
+bool bal_pool_get_stats(const bal_pool* pool, bal_pool_stats* out)
+{
+    if (!_bal_okptr(pool) || !_bal_okptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    _BAL_MUTEX_COUNTER_INIT(poolstats);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolstats);
+
+    *out = pool->stats;
+    for (const bal_pool_dest* dest = pool->dests; NULL != dest; dest = dest->next) {
+        out->idle += dest->nidle;
+        out->busy += dest->total - dest->nidle;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolstats);
+    _BAL_MUTEX_COUNTER_CHECK(poolstats);
+
+    return true;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_pool_release(bal_socket* s)
+{
+    bal_pool_dest* dest = s->state.pool;
+    if (NULL == dest)
+        return;
+
+    s->state.pool = NULL;
+
+    /* a connection being handed over was destroyed out from under the pool. */
+    bal_pool_req* req = _bal_pool_find_req(dest, s);
+    if (NULL != req)
+        _bal_pool_unlink(&dest->pending, req);
+
+    BAL_ASSERT(dest->total > 0U);
+    dest->total--;
+    _bal_pool_slot_freed(dest);
+
+    if (NULL != req)
+        _bal_pool_complete(req, NULL);
+}
+
+/**
+ * Static functions
+ */
+
+static bal_pool_dest* _bal_pool_get_dest(bal_pool* pool, const char* host,
+    const char* port)
+{
+    for (bal_pool_dest* dest = pool->dests; NULL != dest; dest = dest->next) {
+        if (0 == strcmp(dest->host, host) && 0 == strcmp(dest->port, port))
+            return dest;
+    }
+
+    bal_pool_dest* dest = _bal_calloc(1, sizeof(bal_pool_dest));
+    if (!_bal_okptrnf(dest)) {
+        (void)_bal_handlelasterr();
+        return NULL;
+    }
+
+    dest->pool = pool;
+    dest->host = _bal_pool_strdup(host);
+    dest->port = _bal_pool_strdup(port);
+    dest->idle = _bal_calloc(pool->cfg.max_idle, sizeof(bal_pool_idle));
+
+    if (NULL == dest->host || NULL == dest->port || NULL == dest->idle) {
+        if (NULL == dest->idle)
+            (void)_bal_handlelasterr();
+        _bal_pool_dest_free(&dest);
+        return NULL;
+    }
+
+    dest->next  = pool->dests;
+    pool->dests = dest;
+    return dest;
+}
+
+static bal_socket* _bal_pool_take_idle(bal_pool_dest* dest)
+{
+    uint64_t ttl = (uint64_t)dest->pool->cfg.idle_ttl_sec * 1000U;
+    uint64_t now = _bal_monotonic_msec();
+
+    /* the most recently used connection is the likeliest to still be open,
+     * and a peek at it is enough to tell. */
+    while (dest->nidle > 0U) {
+        const bal_pool_idle* idle = &dest->idle[--dest->nidle];
+        bal_socket* s             = idle->s;
+
+        if ((0U == ttl || now - idle->since < ttl) && !_bal_is_closed_conn(s))
+            return s;
+
+        dest->pool->stats.stale++;
+        (void)bal_close(&s, true);
+    }
+
+    return NULL;
+}
+
+static bal_socket* _bal_pool_connect(const char* host, const char* port)
+{
+    bal_addrlist al = {0};
+    if (!_bal_resolve_addrlist(0, PF_UNSPEC, SOCK_STREAM, host, port, &al))
+        return NULL;
+
+    bal_socket* s          = NULL;
+    const bal_sockaddr* sa = bal_enum_addrlist(&al);
+    bool ok = NULL != sa && bal_create(&s, 0, sa->ss_family, SOCK_STREAM, IPPROTO_TCP) &&
+        bal_connect_addrlist(s, &al);
+
+    if (ok) {
+        /* the socket is blocking, so the connection is already established. */
+        bal_setbitslow(&s->state.bits, BAL_S_CONNECT);
+        bal_setbitslow(&s->state.mask, BAL_EVT_WRITE);
+    } else if (NULL != s) {
+        bal_thread_error_info err;
+        _bal_save_error(&err);
+        (void)bal_close(&s, true);
+        _bal_restore_error(&err);
+    }
+
+    (void)bal_free_addrlist(&al);
+    return s;
+}
+
+static bool _bal_pool_submit(bal_pool_dest* dest, bal_pool_req* req)
+{
+    bal_socket* s = _bal_pool_take_idle(dest);
+    if (NULL != s) {
+        if (_bal_pool_hand_over(dest, req, s))
+            return true;
+        (void)bal_close(&s, true);
+    }
+
+    if (dest->total < dest->pool->cfg.max_total)
+        return _bal_pool_open(dest, req);
+
+    _bal_pool_push_waiter(dest, req, false);
+    dest->pool->stats.waits++;
+    return true;
+}
+
+static bool _bal_pool_open(bal_pool_dest* dest, bal_pool_req* req)
+{
+    /* the socket is created once the name is resolved, which happens on the
+     * event thread after it has dispatched I/O events: a descriptor closed by
+     * a callback can't be reused (and then mistaken for the old one) yet. */
+    req->s        = NULL;
+    req->fresh    = true;
+    req->next     = dest->pending;
+    dest->pending = req;
+    dest->total++;
+
+    if (bal_resolve_async(dest->host, dest->port, &_bal_pool_on_resolved, req))
+        return true;
+
+    _bal_pool_unlink(&dest->pending, req);
+    dest->total--;
+    return false;
+}
+
+static bool _bal_pool_hand_over(bal_pool_dest* dest, bal_pool_req* req, bal_socket* s)
+{
+    /* an open connection is writable right away, so the event thread picks
+     * it up on its next pass. */
+    req->s        = s;
+    req->fresh    = false;
+    req->next     = dest->pending;
+    dest->pending = req;
+
+    if (bal_async_poll(s, &_bal_pool_on_io, _BAL_POOL_EVTS))
+        return true;
+
+    _bal_pool_unlink(&dest->pending, req);
+    req->s = NULL;
+    return false;
+}
+
+static void _bal_pool_on_resolved(bal_addrlist* addrs, void* ctx)
+{
+    bal_pool_req* req   = (bal_pool_req*)ctx;
+    bal_pool_dest* dest = req->dest;
+    bal_pool* pool      = dest->pool;
+    bal_socket* s       = NULL;
+    bool ok             = NULL != addrs && NULL != pool;
+
+    _BAL_MUTEX_COUNTER_INIT(poolresolved);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolresolved);
+
+    if (ok) {
+        const bal_sockaddr* sa = bal_enum_addrlist(addrs);
+        ok = NULL != sa && bal_create(&s, 0, sa->ss_family, SOCK_STREAM, IPPROTO_TCP);
+        if (ok) {
+            s->state.pool = dest;
+            req->s        = s;
+            ok = bal_async_poll(s, &_bal_pool_on_io, _BAL_POOL_EVTS) &&
+                bal_connect_addrlist(s, addrs);
+        }
+    }
+
+    if (!ok) {
+        bal_thread_error_info err;
+        _bal_save_error(&err);
+
+        _bal_pool_unlink(&dest->pending, req);
+        if (NULL != pool)
+            pool->stats.failures++;
+
+        /* either way, the slot is released. */
+        if (NULL != s) {
+            (void)bal_close(&s, true);
+        } else {
+            dest->total--;
+            _bal_pool_slot_freed(dest);
+        }
+
+        _bal_restore_error(&err);
+        _bal_pool_complete(req, NULL);
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolresolved);
+    _BAL_MUTEX_COUNTER_CHECK(poolresolved);
+}
+
+static void _bal_pool_on_io(bal_socket* s, uint32_t events)
+{
+    if (0U == (events & _BAL_POOL_EVTS))
+        return;
+
+    _BAL_MUTEX_COUNTER_INIT(poolio);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, poolio);
+
+    bal_pool_dest* dest = s->state.pool;
+    bal_pool_req* req   = NULL != dest ? _bal_pool_find_req(dest, s) : NULL;
+    BAL_ASSERT(NULL != req);
+
+    if (NULL != req) {
+        bal_pool* pool = dest->pool;
+        _bal_pool_unlink(&dest->pending, req);
+
+        if (0U == (events & _BAL_POOL_FAILEVTS)) {
+            _bal_pool_unregister(s);
+            if (NULL != pool) {
+                if (req->fresh)
+                    pool->stats.created++;
+                else
+                    pool->stats.reused++;
+            }
+            _bal_pool_complete(req, s);
+        } else if (!req->fresh) {
+            /* the idle connection was closed on the way over; closing it
+             * frees a slot, which opens another ahead of anyone waiting. */
+            if (NULL != pool)
+                pool->stats.stale++;
+            req->s = NULL;
+            _bal_pool_push_waiter(dest, req, true);
+            (void)bal_close(&s, true);
+        } else {
+            bal_thread_error_info err;
+            _bal_save_error(&err);
+            if (NULL != pool)
+                pool->stats.failures++;
+            (void)bal_close(&s, true);
+            _bal_restore_error(&err);
+            _bal_pool_complete(req, NULL);
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, poolio);
+    _BAL_MUTEX_COUNTER_CHECK(poolio);
+}
+
+static void _bal_pool_slot_freed(bal_pool_dest* dest)
+{
+    /* callbacks run last: they may well use the pool themselves. */
+    bal_pool_req* failed = NULL;
+
+    if (NULL == dest->pool) {
+        failed             = dest->waiters;
+        dest->waiters      = NULL;
+        dest->waiters_tail = NULL;
+        if (0U == dest->total)
+            _bal_pool_dest_free(&dest);
+    } else {
+        while (NULL != dest->waiters && dest->total < dest->pool->cfg.max_total) {
+            bal_pool_req* req = dest->waiters;
+            dest->waiters     = req->next;
+            if (NULL == dest->waiters)
+                dest->waiters_tail = NULL;
+            if (!_bal_pool_open(dest, req)) {
+                dest->pool->stats.failures++;
+                req->next = failed;
+                failed    = req;
+            }
+        }
+    }
+
+    while (NULL != failed) {
+        bal_pool_req* next = failed->next;
+        _bal_pool_complete(failed, NULL);
+        failed = next;
+    }
+}
+
+static void _bal_pool_complete(bal_pool_req* req, bal_socket* s)
+{
+    req->cb(s, req->ctx);
+    _bal_safefree(&req);
+}
+
+static bal_pool_req* _bal_pool_find_req(const bal_pool_dest* dest, const bal_socket* s)
+{
+    for (bal_pool_req* req = dest->pending; NULL != req; req = req->next) {
+        if (s == req->s)
+            return req;
+    }
+
+    return NULL;
+}
+
+static void _bal_pool_unlink(bal_pool_req** list, const bal_pool_req* req)
+{
+    while (NULL != *list) {
+        if (req == *list) {
+            *list = req->next;
+            break;
+        }
+        list = &(*list)->next;
+    }
+}
+
+static void _bal_pool_push_waiter(bal_pool_dest* dest, bal_pool_req* req, bool front)
+{
+    if (front) {
+        req->next     = dest->waiters;
+        dest->waiters = req;
+        if (NULL == dest->waiters_tail)
+            dest->waiters_tail = req;
+    } else {
+        req->next = NULL;
+        if (NULL != dest->waiters_tail)
+            dest->waiters_tail->next = req;
+        else
+            dest->waiters = req;
+        dest->waiters_tail = req;
+    }
+}
+
+static void _bal_pool_unregister(bal_socket* s)
+{
+    bal_socket* d = NULL;
+    if (_bal_list_find(_bal_as_container.lst, s->sd, &d) && s == d)
+        (void)bal_async_poll(s, NULL, 0U);
+
+    s->state.mask = 0U;
+    s->state.proc = NULL;
+    (void)bal_set_io_mode(s, false);
+}
+
+static void _bal_pool_dest_free(bal_pool_dest** dest)
+{
+    if (NULL != dest && NULL != *dest) {
+        _bal_safefree(&(*dest)->idle);
+        _bal_safefree(&(*dest)->host);
+        _bal_safefree(&(*dest)->port);
+        _bal_safefree(dest);
+    }
+}
+
+static char* _bal_pool_strdup(const char* str)
+{
+    size_t len = strnlen(str, NI_MAXHOST);
+    char* dup  = _bal_calloc(len + 1, sizeof(char));
+    if (!_bal_okptrnf(dup)) {
+        (void)_bal_handlelasterr();
+        return NULL;
+    }
+
+    memcpy(dup, str, len);
+    return dup;
+}
@@ -0,0 +1,354 @@
+/*
+ * balrace.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+static bool _bal_race_start_next(bal_race* r);
+static void _bal_race_attempt_failed(bal_race* r, size_t idx, int error);
+static void _bal_race_win(bal_race* r, size_t idx);
+static bool _bal_race_find(bal_descriptor sd, bal_race** r, size_t* idx);
+static void _bal_race_closesd(bal_descriptor sd);
+
+/**
+ * Exported functions
+ */
+
+bool bal_connect_race(bal_socket* s, const char* host, const char* port)
+{
+    if (!_bal_oksock(s) || !_bal_okstr(host) || !_bal_okstr(port))
+        return false;
+
+    bal_addrlist al = {0};
+    if (!_bal_resolve_addrlist(0, PF_UNSPEC, s->type, host, port, &al))
+        return false;
+
+    bool retval = bal_connect_race_addrlist(s, &al);
+    (void)bal_free_addrlist(&al);
+
+    return retval;
+}
+
+bool bal_connect_race_addrlist(bal_socket* s, bal_addrlist* al)
+{
+    if (!_bal_oksock(s) || !bal_reset_addrlist(al))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bal_race* r = _bal_calloc(1, sizeof(bal_race));
+    if (!_bal_okptrnf(r))
+        return _bal_handlelasterr();
+
+    /* RFC 8305, section 4: alternate address families, starting with the
+     * family of the first (most preferred) address. */
+    const bal_sockaddr* fams[2][BAL_RACE_MAXADDRS];
+    size_t counts[2]       = {0, 0};
+    const bal_sockaddr* sa = NULL;
+
+    while (NULL != (sa = bal_enum_addrlist(al)) &&
+        counts[0] + counts[1] < BAL_RACE_MAXADDRS) {
+        size_t fam = 0U == counts[0] || fams[0][0]->ss_family == sa->ss_family ? 0 : 1;
+        fams[fam][counts[fam]++] = sa;
+    }
+
+    for (size_t n = 0; n < BAL_RACE_MAXADDRS; n++) {
+        for (size_t fam = 0; fam < 2; fam++) {
+            if (n < counts[fam])
+                memcpy(&r->addrs[r->naddrs++], fams[fam][n], sizeof(bal_sockaddr));
+        }
+    }
+
+    r->s = s;
+    for (size_t n = 0; n < BAL_RACE_MAXADDRS; n++)
+        r->sds[n] = BAL_BADSOCKET;
+
+    bool retval = false;
+
+    _BAL_MUTEX_COUNTER_INIT(racestart);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, racestart);
+
+    /* the outcome is delivered as BAL_EVT_CONNECT/BAL_EVT_CONNFAIL, so the
+     * socket has to be registered with the event thread. */
+    bal_socket* d = NULL;
+    if (!_bal_list_find(_bal_as_container.lst, s->sd, &d) || s != d) {
+        (void)_bal_seterror(_BAL_E_ASNOSOCKET);
+    } else if (!_bal_race_start_next(r)) {
+        /* every candidate failed immediately. */
+        (void)_bal_handleerr(r->error);
+    } else {
+        _bal_race_destroy(&s->state.race);
+        r->next_at              = _bal_monotonic_msec() + BAL_RACE_DELAY_MSEC;
+        r->next                 = _bal_as_container.raceq;
+        _bal_as_container.raceq = r;
+        s->state.race           = r;
+        r                       = NULL;
+        retval                  = true;
+        _bal_wakeup_signal();
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, racestart);
+    _BAL_MUTEX_COUNTER_CHECK(racestart);
+
+    /* not queued, and no attempts are in flight. */
+    _bal_safefree(&r);
+    return retval;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_race_cancel(bal_socket* s)
+{
+    _BAL_MUTEX_COUNTER_INIT(racecancel);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, racecancel);
+    _bal_race_destroy(&s->state.race);
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, racecancel);
+    _BAL_MUTEX_COUNTER_CHECK(racecancel);
+}
+
+void _bal_race_destroy(bal_race** r)
+{
+    if (NULL == r || NULL == *r)
+        return;
+
+    bal_race** link = &_bal_as_container.raceq;
+    while (NULL != *link && *r != *link)
+        link = &(*link)->next;
+    if (NULL != *link)
+        *link = (*r)->next;
+
+    for (size_t n = 0; n < BAL_RACE_MAXADDRS; n++) {
+        if (BAL_BADSOCKET != (*r)->sds[n])
+            _bal_race_closesd((*r)->sds[n]);
+    }
+
+    _bal_safefree(r);
+}
+
+size_t _bal_race_prepare(int* timeout)
+{
+    size_t inflight = 0;
+    uint64_t now    = _bal_monotonic_msec();
+
+    for (bal_race* r = _bal_as_container.raceq; NULL != r; r = r->next) {
+        if (!r->lost && r->cursor < r->naddrs && now >= r->next_at) {
+            if (_bal_race_start_next(r))
+                r->next_at = now + BAL_RACE_DELAY_MSEC;
+        }
+
+        if (0U == r->inflight && r->cursor >= r->naddrs)
+            r->lost = true;
+
+        if (r->lost) {
+            *timeout = 0;
+        } else if (r->cursor < r->naddrs) {
+            uint64_t wait = r->next_at > now ? r->next_at - now : 0U;
+            if (wait < (uint64_t)*timeout)
+                *timeout = (int)wait;
+        }
+
+        inflight += r->inflight;
+    }
+
+    return inflight;
+}
+
+size_t _bal_race_fill(bal_pollfd* fds, size_t max)
+{
+    size_t count = 0;
+
+    for (bal_race* r = _bal_as_container.raceq; NULL != r; r = r->next) {
+        for (size_t n = 0; n < r->naddrs && count < max; n++) {
+            if (BAL_BADSOCKET != r->sds[n]) {
+                fds[count].fd     = r->sds[n];
+                fds[count].events = POLLWRNORM;
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+void _bal_race_dispatch(const bal_pollfd* fds, size_t nfds)
+{
+    for (size_t n = 0; n < nfds; n++) {
+        bal_race* r = NULL;
+        size_t idx  = 0;
+
+        /* callbacks may have ended races (or closed sockets) since the poll. */
+        if (0 == fds[n].revents || !_bal_race_find(fds[n].fd, &r, &idx))
+            continue;
+
+        int error     = 0;
+        socklen_t len = sizeof(int);
+        if (0 != getsockopt(fds[n].fd, SOL_SOCKET, SO_ERROR, (char*)&error, &len))
+            error = _bal_lasterror();
+
+        if (0 == error && !bal_isbitset(fds[n].revents, POLLERR) &&
+            !bal_isbitset(fds[n].revents, POLLHUP)) {
+            _bal_race_win(r, idx);
+        } else {
+            _bal_race_attempt_failed(r, idx, 0 != error ? error : _BAL_ECONNREFUSED);
+        }
+    }
+
+    /* report races lost on every candidate. */
+    bal_race* r = _bal_as_container.raceq;
+    while (NULL != r) {
+        if (!r->lost) {
+            r = r->next;
+            continue;
+        }
+
+        bal_socket* s = r->s;
+        (void)_bal_handleerr(r->error);
+        _bal_race_destroy(&s->state.race);
+        _bal_dbglog("connection race for socket "BAL_SOCKET_SPEC" lost", s->sd);
+        _bal_probe2(connect__done, s->sd, false);
+
+        if (bal_bitsinmask(s, BAL_EVT_CONNFAIL) && _bal_okptr(s->state.proc))
+            _bal_invoke_callback(s, s->sd, BAL_EVT_CONNFAIL);
+
+        /* the callback may have changed the queue; start over. */
+        r = _bal_as_container.raceq;
+    }
+}
+
+/**
+ * Static functions
+ */
+
+static bool _bal_race_start_next(bal_race* r)
+{
+    while (r->cursor < r->naddrs) {
+        size_t idx             = r->cursor++;
+        const bal_sockaddr* sa = &r->addrs[idx];
+
+        bal_descriptor sd = socket(sa->ss_family, r->s->type, r->s->proto);
+        if (BAL_BADSOCKET == sd) {
+            r->error = _bal_lasterror();
+            continue;
+        }
+
+#if defined(__WIN__)
+        u_long flag = 1UL;
+        int ret     = ioctlsocket(sd, FIONBIO, &flag);
+#else
+        int ret = fcntl(sd, F_SETFL, O_NONBLOCK);
+#endif
+        if (0 == ret)
+            ret = connect(sd, (const struct sockaddr*)sa, _BAL_SASIZE(*sa));
+
+        int error = 0 == ret ? 0 : _bal_lasterror();
+        if (0 == ret || _bal_connpending(error)) {
+            _bal_trace_instant(BAL_TRACE_CONNECT, sd, 0U);
+            r->sds[idx] = sd;
+            r->inflight++;
+            return true;
+        }
+
+        r->error = error;
+        _bal_race_closesd(sd);
+    }
+
+    return false;
+}
+
+static void _bal_race_attempt_failed(bal_race* r, size_t idx, int error)
+{
+    _bal_race_closesd(r->sds[idx]);
+    r->sds[idx] = BAL_BADSOCKET;
+    r->inflight--;
+    r->error = error;
+
+    /* RFC 8305, section 5: a failure starts the next attempt right away. */
+    if (_bal_race_start_next(r))
+        r->next_at = _bal_monotonic_msec() + BAL_RACE_DELAY_MSEC;
+    else if (0U == r->inflight)
+        r->lost = true;
+}
+
+static void _bal_race_win(bal_race* r, size_t idx)
+{
+    bal_socket* s     = r->s;
+    bal_descriptor sd = r->sds[idx];
+    int addr_fam      = r->addrs[idx].ss_family;
+
+    /* the losers are closed along with the race. */
+    r->sds[idx] = BAL_BADSOCKET;
+    _bal_race_destroy(&s->state.race);
+
+    bal_socket* d = NULL;
+    bool listed   = _bal_list_remove(_bal_as_container.lst, s->sd, &d);
+    _bal_race_closesd(s->sd);
+
+    _bal_dbglog("connection race won by "BAL_SOCKET_SPEC"; replaces "BAL_SOCKET_SPEC
+        " (%p)", sd, s->sd, s);
+
+    s->sd       = sd;
+    s->addr_fam = addr_fam;
+    if (NULL != s->state.coalesce)
+        s->state.coalesce->sd = sd;
+
+    if (listed) {
+        bool added = _bal_list_add(_bal_as_container.lst, sd, s);
+        BAL_ASSERT_UNUSED(added, added);
+    }
+
+    _bal_probe2(connect__done, sd, true);
+    if (bal_bitsinmask(s, BAL_EVT_CONNECT) && _bal_okptr(s->state.proc))
+        _bal_invoke_callback(s, s->sd, BAL_EVT_CONNECT);
+}
+
+static bool _bal_race_find(bal_descriptor sd, bal_race** r, size_t* idx)
+{
+    for (bal_race* cur = _bal_as_container.raceq; NULL != cur; cur = cur->next) {
+        for (size_t n = 0; n < cur->naddrs; n++) {
+            if (sd == cur->sds[n]) {
+                *r   = cur;
+                *idx = n;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static void _bal_race_closesd(bal_descriptor sd)
+{
+#if defined(__WIN__)
+    int ret = closesocket(sd);
+#else
+    int ret = close(sd);
+#endif
+    BAL_ASSERT_UNUSED(ret, 0 == ret);
+}
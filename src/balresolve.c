@@ -0,0 +1,511 @@
+/*
+ * balresolve.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+static bool _bal_resolver_submit(const char* host, const char* port, int addr_fam,
+    int type, bal_resolve_cb cb, void* ctx, bal_socket* s);
+static bool _bal_resolver_start(void);
+static char* _bal_resolver_strdup(const char* str);
+static void _bal_resolve_req_free(bal_resolve_req** req);
+static bool _bal_rescache_key(char* key, size_t size, int flags, int addr_fam,
+    int type, const char* host, const char* port);
+static bool _bal_rescache_negative(const bal_thread_error_info* err);
+
+/**
+ * Exported functions
+ */
+
+bool bal_resolve_async(const char* host, const char* port, bal_resolve_cb cb, void* ctx)
+{
+    if (!_bal_okstr(host) || !_bal_okptr(cb))
+        return false;
+
+    return _bal_resolver_submit(host, port, PF_UNSPEC, 0, cb, ctx, NULL);
+}
+
+bool bal_connect_async(bal_socket* s, const char* host, const char* port)
+{
+    if (!_bal_oksock(s) || !_bal_okstr(host) || !_bal_okstr(port))
+        return false;
+
+    /* the result is delivered as BAL_EVT_CONNECT/BAL_EVT_CONNFAIL, so the
+     * socket has to be registered with the event thread. */
+    bal_socket* d = NULL;
+
+    _BAL_MUTEX_COUNTER_INIT(connasync);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, connasync);
+    bool found = _bal_get_boolean(&_bal_async_poll_init) &&
+        _bal_list_find(_bal_as_container.lst, s->sd, &d) && s == d;
+    /* until it is connecting, an unconnected socket polls as hung up; the event
+     * thread leaves it alone while the name is resolved. */
+    if (found)
+        bal_setbitshigh(&s->state.bits, BAL_S_RESOLVE);
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, connasync);
+    _BAL_MUTEX_COUNTER_CHECK(connasync);
+
+    if (!found)
+        return _bal_seterror(_BAL_E_ASNOSOCKET);
+
+    bool submitted = _bal_resolver_submit(host, port, s->addr_fam, s->type, NULL, NULL, s);
+    if (!submitted) {
+        /* the event thread reads this while building the poll set. */
+        _BAL_MUTEX_COUNTER_INIT(connasyncfail);
+        _BAL_LOCK_MUTEX(&_bal_as_container.mutex, connasyncfail);
+        bal_setbitslow(&s->state.bits, BAL_S_RESOLVE);
+        _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, connasyncfail);
+        _BAL_MUTEX_COUNTER_CHECK(connasyncfail);
+    }
+
+    return submitted;
+}
+
+bool bal_set_resolver_cache(size_t max_entries, uint32_t ttl_sec, uint32_t neg_ttl_sec)
+{
+    if (!_bal_sanity())
+        return false;
+
+    if (ttl_sec > UINT32_MAX / 1000U || neg_ttl_sec > UINT32_MAX / 1000U)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    return _bal_cache_configure(&_bal_rescache, max_entries, ttl_sec * 1000U,
+        neg_ttl_sec * 1000U);
+}
+
+bool bal_flush_resolver_cache(void)
+{
+    if (!_bal_sanity())
+        return false;
+
+    _bal_cache_flush(&_bal_rescache);
+    return true;
+}
+
+bool bal_get_resolver_cache_stats(bal_cache_stats* out)
+{
+    if (!_bal_sanity() || !_bal_okptr(out))
+        return false;
+
+    _bal_cache_get_stats(&_bal_rescache, out);
+    return true;
+}
+
+bool bal_set_rdns_cache(size_t max_entries, uint32_t ttl_sec, uint32_t neg_ttl_sec)
+{
+    if (!_bal_sanity())
+        return false;
+
+    if (ttl_sec > UINT32_MAX / 1000U || neg_ttl_sec > UINT32_MAX / 1000U)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    return _bal_cache_configure(&_bal_rdnscache, max_entries, ttl_sec * 1000U,
+        neg_ttl_sec * 1000U);
+}
+
+bool bal_flush_rdns_cache(void)
+{
+    if (!_bal_sanity())
+        return false;
+
+    _bal_cache_flush(&_bal_rdnscache);
+    return true;
+}
+
+bool bal_get_rdns_cache_stats(bal_cache_stats* out)
+{
+    if (!_bal_sanity() || !_bal_okptr(out))
+        return false;
+
+    _bal_cache_get_stats(&_bal_rdnscache, out);
+    return true;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_resolver_cleanup(void)
+{
+    _BAL_MUTEX_COUNTER_INIT(rescleanup);
+    _BAL_LOCK_MUTEX(&_bal_resolver.mutex, rescleanup);
+    _bal_resolver.die = true;
+    (void)_bal_cond_broadcast(&_bal_resolver.cond);
+    size_t nthreads = _bal_resolver.nthreads;
+    _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, rescleanup);
+
+    /* a thread inside getaddrinfo can't be interrupted; this waits for it. */
+    for (size_t n = 0; n < nthreads; n++) {
+#if defined(__WIN__)
+        DWORD wait = WaitForSingleObject((HANDLE)_bal_resolver.threads[n], INFINITE);
+        BAL_ASSERT_UNUSED(wait, WAIT_OBJECT_0 == wait);
+        (void)CloseHandle((HANDLE)_bal_resolver.threads[n]);
+#else
+        int wait = pthread_join(_bal_resolver.threads[n], NULL);
+        BAL_ASSERT_UNUSED(wait, 0 == wait);
+#endif
+    }
+
+    _BAL_LOCK_MUTEX(&_bal_resolver.mutex, rescleanup);
+
+    bal_resolve_req* lists[] = {_bal_resolver.pending, _bal_resolver.done};
+    for (size_t n = 0; n < _bal_countof(lists); n++) {
+        while (NULL != lists[n]) {
+            bal_resolve_req* next = lists[n]->next;
+            _bal_resolve_req_free(&lists[n]);
+            lists[n] = next;
+        }
+    }
+
+    _bal_resolver.pending      = NULL;
+    _bal_resolver.pending_tail = NULL;
+    _bal_resolver.done         = NULL;
+    _bal_resolver.nthreads     = 0;
+    _bal_resolver.die          = false;
+
+    _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, rescleanup);
+    _BAL_MUTEX_COUNTER_CHECK(rescleanup);
+}
+
+void _bal_resolver_dispatch(void)
+{
+    _BAL_MUTEX_COUNTER_INIT(resdispatch);
+    _BAL_LOCK_MUTEX(&_bal_resolver.mutex, resdispatch);
+    bal_resolve_req* done = _bal_resolver.done;
+    _bal_resolver.done    = NULL;
+    _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, resdispatch);
+    _BAL_MUTEX_COUNTER_CHECK(resdispatch);
+
+    /* completions are pushed onto the front; deliver them oldest first. */
+    bal_resolve_req* req = NULL;
+    while (NULL != done) {
+        bal_resolve_req* next = done->next;
+        done->next            = req;
+        req                   = done;
+        done                  = next;
+    }
+
+    while (NULL != req) {
+        bal_resolve_req* next = req->next;
+
+        if (!req->ok)
+            _bal_restore_error(&req->err);
+
+        if (NULL != req->s) {
+            /* the socket may have been closed or deregistered meanwhile. */
+            bal_socket* s = NULL;
+            if (_bal_list_find(_bal_as_container.lst, req->sd, &s) && s == req->s) {
+                bal_setbitslow(&s->state.bits, BAL_S_RESOLVE);
+                bool connecting = req->ok && bal_connect_addrlist(s, &req->addrs);
+                if (!connecting && bal_bitsinmask(s, BAL_EVT_CONNFAIL) &&
+                    NULL != s->state.proc)
+                    _bal_invoke_callback(s, s->sd, BAL_EVT_CONNFAIL);
+            }
+        } else {
+            req->cb(req->ok ? &req->addrs : NULL, req->ctx);
+        }
+
+        _bal_resolve_req_free(&req);
+        req = next;
+    }
+}
+
+size_t _bal_resolve_addrs(int flags, int addr_fam, int type, const char* host,
+    const char* port, bal_sockaddr* out, size_t max)
+{
+    /* literal addresses need neither the resolver nor the cache. */
+    if (NULL != host && 0U != max && _bal_parse_addr(host, port, out) &&
+        (PF_UNSPEC == addr_fam || addr_fam == out->ss_family))
+        return 1U;
+
+    char key[NI_MAXHOST + NI_MAXSERV + 64];
+    bool cached = _bal_rescache_key(key, sizeof(key), flags, addr_fam, type, host, port);
+    bal_thread_error_info err;
+
+    if (cached) {
+        size_t len = max * sizeof(bal_sockaddr);
+        int get    = _bal_cache_get(&_bal_rescache, key, out, &len, &err);
+        if (BAL_CACHE_HIT == get) {
+            size_t count = len / sizeof(bal_sockaddr);
+            return count < max ? count : max;
+        }
+        if (BAL_CACHE_NEGATIVE == get) {
+            _bal_restore_error(&err);
+            return 0U;
+        }
+    }
+
+    struct addrinfo* ai = NULL;
+    if (!_bal_get_addrinfo(flags, addr_fam, type, host, port, &ai)) {
+        if (cached) {
+            _bal_save_error(&err);
+            if (_bal_rescache_negative(&err))
+                _bal_cache_put(&_bal_rescache, key, NULL, 0U, &err);
+        }
+        return 0U;
+    }
+
+    bal_sockaddr addrs[BAL_RESCACHE_MAXADDRS];
+    size_t count = 0U;
+    for (const struct addrinfo* cur = ai; NULL != cur && count < BAL_RESCACHE_MAXADDRS;
+        cur = cur->ai_next) {
+        if (cur->ai_addrlen <= sizeof(bal_sockaddr)) {
+            memset(&addrs[count], 0, sizeof(bal_sockaddr));
+            memcpy(&addrs[count++], cur->ai_addr, cur->ai_addrlen);
+        }
+    }
+    freeaddrinfo(ai);
+
+    if (cached && 0U != count)
+        _bal_cache_put(&_bal_rescache, key, addrs, count * sizeof(bal_sockaddr), NULL);
+
+    count = count < max ? count : max;
+    if (0U != count)
+        memcpy(out, addrs, count * sizeof(bal_sockaddr));
+
+    return count;
+}
+
+bool _bal_reverse_lookup(const bal_sockaddr* in, const char* addr, char* host,
+    size_t size)
+{
+    /* the numeric address (scope included) identifies the lookup. */
+    bal_thread_error_info err;
+    size_t len = size;
+    int get    = _bal_cache_get(&_bal_rdnscache, addr, host, &len, &err);
+
+    if (BAL_CACHE_HIT == get && len <= size)
+        return true;
+
+    if (BAL_CACHE_NEGATIVE == get) {
+        _bal_restore_error(&err);
+        return false;
+    }
+
+    char name[NI_MAXHOST];
+    char port[NI_MAXSERV];
+    if (!_bal_getnameinfo(_BAL_NI_DNS, in, name, port)) {
+        _bal_save_error(&err);
+        if (_bal_rescache_negative(&err))
+            _bal_cache_put(&_bal_rdnscache, addr, NULL, 0U, &err);
+        return false;
+    }
+
+    len = strnlen(name, sizeof(name)) + 1U;
+    _bal_cache_put(&_bal_rdnscache, addr, name, len, NULL);
+
+    _bal_strcpy(host, size, name, len);
+    return true;
+}
+
+bool _bal_resolve_addrlist(int flags, int addr_fam, int type, const char* host,
+    const char* port, bal_addrlist* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    bal_sockaddr addrs[BAL_RESCACHE_MAXADDRS];
+    size_t count = _bal_resolve_addrs(flags, addr_fam, type, host, port, addrs,
+        BAL_RESCACHE_MAXADDRS);
+    if (0U == count)
+        return false;
+
+    if (!_bal_addrlist_alloc(out, count))
+        return false;
+
+    memcpy(_bal_addrlist_data(out), addrs, count * sizeof(bal_sockaddr));
+    return true;
+}
+
+bal_threadret _bal_resolver_thread(void* ctx)
+{
+    BAL_UNUSED(ctx);
+
+    _BAL_MUTEX_COUNTER_INIT(resthread);
+    _BAL_LOCK_MUTEX(&_bal_resolver.mutex, resthread);
+
+    while (!_bal_resolver.die) {
+        if (NULL == _bal_resolver.pending) {
+            (void)_bal_cond_wait(&_bal_resolver.cond, &_bal_resolver.mutex);
+            continue;
+        }
+
+        bal_resolve_req* req  = _bal_resolver.pending;
+        _bal_resolver.pending = req->next;
+        if (NULL == _bal_resolver.pending)
+            _bal_resolver.pending_tail = NULL;
+        req->next = NULL;
+
+        _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, resthread);
+
+        req->ok = _bal_resolve_addrlist(0, req->addr_fam, req->type, req->host,
+            req->port, &req->addrs);
+        if (!req->ok)
+            _bal_save_error(&req->err);
+
+        _BAL_LOCK_MUTEX(&_bal_resolver.mutex, resthread);
+        req->next          = _bal_resolver.done;
+        _bal_resolver.done = req;
+        _bal_wakeup_signal();
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, resthread);
+    _BAL_MUTEX_COUNTER_CHECK(resthread);
+
+#if defined(__WIN__)
+    return 0U;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Static functions
+ */
+
+static bool _bal_resolver_submit(const char* host, const char* port, int addr_fam,
+    int type, bal_resolve_cb cb, void* ctx, bal_socket* s)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    bal_resolve_req* req = _bal_calloc(1, sizeof(bal_resolve_req));
+    if (!_bal_okptrnf(req))
+        return _bal_handlelasterr();
+
+    req->host     = _bal_resolver_strdup(host);
+    req->port     = NULL != port ? _bal_resolver_strdup(port) : NULL;
+    req->addr_fam = addr_fam;
+    req->type     = type;
+    req->cb       = cb;
+    req->ctx      = ctx;
+    req->s        = s;
+    req->sd       = NULL != s ? s->sd : BAL_BADSOCKET;
+
+    if (NULL == req->host || (NULL != port && NULL == req->port)) {
+        _bal_resolve_req_free(&req);
+        return false;
+    }
+
+    bool retval = true;
+
+    _BAL_MUTEX_COUNTER_INIT(ressubmit);
+    _BAL_LOCK_MUTEX(&_bal_resolver.mutex, ressubmit);
+
+    if (0U == _bal_resolver.nthreads)
+        retval = _bal_resolver_start();
+
+    if (retval) {
+        if (NULL == _bal_resolver.pending_tail) {
+            _bal_resolver.pending = req;
+        } else {
+            _bal_resolver.pending_tail->next = req;
+        }
+        _bal_resolver.pending_tail = req;
+        (void)_bal_cond_signal(&_bal_resolver.cond);
+    } else {
+        _bal_resolve_req_free(&req);
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_resolver.mutex, ressubmit);
+    _BAL_MUTEX_COUNTER_CHECK(ressubmit);
+
+    return retval;
+}
+
+static bool _bal_resolver_start(void)
+{
+    /* called with the resolver mutex held. */
+    for (size_t n = 0; n < BAL_RESOLVER_THREADS; n++) {
+#if defined(__WIN__)
+        _bal_resolver.threads[n] = _beginthreadex(NULL, 0U, &_bal_resolver_thread,
+            NULL, 0U, NULL);
+        if (0ULL == _bal_resolver.threads[n]) {
+            (void)_bal_handlelasterr();
+            break;
+        }
+#else
+        int op = pthread_create(&_bal_resolver.threads[n], NULL,
+            &_bal_resolver_thread, NULL);
+        if (0 != op) {
+            (void)_bal_handleerr(op);
+            break;
+        }
+#endif
+        _bal_resolver.nthreads++;
+    }
+
+    _bal_dbglog("started %zu resolver thread(s)", _bal_resolver.nthreads);
+    return 0U != _bal_resolver.nthreads;
+}
+
+static char* _bal_resolver_strdup(const char* str)
+{
+    size_t len = strnlen(str, NI_MAXHOST);
+    char* dup  = _bal_calloc(len + 1, sizeof(char));
+    if (!_bal_okptrnf(dup)) {
+        (void)_bal_handlelasterr();
+        return NULL;
+    }
+
+    memcpy(dup, str, len);
+    return dup;
+}
+
+static void _bal_resolve_req_free(bal_resolve_req** req)
+{
+    if (NULL != req && NULL != *req) {
+        (void)bal_free_addrlist(&(*req)->addrs);
+        _bal_safefree(&(*req)->host);
+        _bal_safefree(&(*req)->port);
+        _bal_safefree(req);
+    }
+}
+
+static bool _bal_rescache_key(char* key, size_t size, int flags, int addr_fam,
+    int type, const char* host, const char* port)
+{
+    int len = snprintf(key, size, "%d|%d|%d|%s|%s", flags, addr_fam, type,
+        NULL != host ? host : "", NULL != port ? port : "");
+
+    /* a truncated key could collide with another; just bypass the cache. */
+    return 0 < len && (size_t)len < size;
+}
+
+static bool _bal_rescache_negative(const bal_thread_error_info* err)
+{
+    /* only cache definitive answers; transient failures (EAI_AGAIN, etc.)
+     * should be retried. */
+    if (_BAL_E_PLATFORM != err->code)
+        return false;
+
+    return EAI_NONAME == err->os.code
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+        || EAI_NODATA == err->os.code
+#endif
+        ;
+}
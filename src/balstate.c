@@ -44,9 +44,47 @@ bal_as_container _bal_as_container = {
     NULL,
     BAL_MUTEX_INIT,
     BAL_THREAD_INIT,
-    0
+    0,
+    NULL,
+    NULL,
+    {BAL_BADSOCKET, BAL_BADSOCKET}
+};
+
+/* asynchronous name resolution state. */
+bal_resolver _bal_resolver;
+
+/* resolver cache. */
+bal_cache _bal_rescache = {
+    BAL_MUTEX_INIT,
+    NULL,
+    0,
+    BAL_RESCACHE_MAXENTRIES,
+    BAL_RESCACHE_TTL * 1000U,
+    BAL_RESCACHE_NEGTTL * 1000U,
+    NULL,
+    NULL,
+    {0U, 0U, 0U, 0U, 0U, 0U}
 };
 
+/* reverse lookup cache. */
+bal_cache _bal_rdnscache = {
+    BAL_MUTEX_INIT,
+    NULL,
+    0,
+    BAL_RDNSCACHE_MAXENTRIES,
+    BAL_RDNSCACHE_TTL * 1000U,
+    BAL_RDNSCACHE_NEGTTL * 1000U,
+    NULL,
+    NULL,
+    {0U, 0U, 0U, 0U, 0U, 0U}
+};
+
+/* library-wide statistics. */
+bal_counters _bal_stats;
+
+/* slow callback watchdog. */
+bal_watchdog _bal_watchdog = {0U, NULL, NULL};
+
 /* global library state. */
 bal_state _bal_state = {
     BAL_MUTEX_INIT,
@@ -0,0 +1,285 @@
+/*
+ * balstats.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/state.h"
+#include "bal/helpers.h"
+
+static size_t _bal_hist_bucket(uint64_t value);
+static uint64_t _bal_hist_bucket_max(size_t bucket);
+
+/**
+ * Exported functions
+ */
+
+bool bal_get_stats(bal_stats* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    memset(out, 0, sizeof(bal_stats));
+
+    if (_bal_get_boolean(&_bal_async_poll_init)) {
+        _BAL_MUTEX_COUNTER_INIT(stats);
+        _BAL_LOCK_MUTEX(&_bal_as_container.mutex, stats);
+        out->sockets = _bal_list_count(_bal_as_container.lst);
+        _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, stats);
+        _BAL_MUTEX_COUNTER_CHECK(stats);
+    }
+
+    for (size_t n = 0; n < BAL_EVT_COUNT; n++)
+        out->events[n] = _bal_counter_get(&_bal_stats.events[n]);
+
+    out->polls         = _bal_counter_get(&_bal_stats.polls);
+    out->poll_nsec     = _bal_counter_get(&_bal_stats.poll_nsec);
+    out->callbacks     = _bal_counter_get(&_bal_stats.callbacks);
+    out->callback_nsec = _bal_counter_get(&_bal_stats.callback_nsec);
+    out->slow_callbacks = _bal_counter_get(&_bal_stats.slow_callbacks);
+    out->allocs        = _bal_counter_get(&_bal_stats.allocs);
+    out->alloc_bytes   = _bal_counter_get(&_bal_stats.alloc_bytes);
+
+    return true;
+}
+
+bool bal_get_socket_stats(const bal_socket* s, bal_socket_stats* out)
+{
+    if (!_bal_oksock(s) || !_bal_okptr(out))
+        return false;
+
+    memset(out, 0, sizeof(bal_socket_stats));
+
+    const bal_sockcounters* c = s->state.stats;
+    if (NULL != c) {
+        out->sends           = _bal_counter_get(&c->sends);
+        out->bytes_sent      = _bal_counter_get(&c->bytes_sent);
+        out->send_wouldblock = _bal_counter_get(&c->send_wouldblock);
+        out->recvs           = _bal_counter_get(&c->recvs);
+        out->bytes_recv      = _bal_counter_get(&c->bytes_recv);
+        out->recv_wouldblock = _bal_counter_get(&c->recv_wouldblock);
+        out->events          = _bal_counter_get(&c->events);
+    }
+
+    return true;
+}
+
+bool bal_get_histogram(int which, bal_histogram* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    if (which < 0 || which >= BAL_HIST_COUNT)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    const bal_histcounters* h = &_bal_stats.hists[which];
+    for (size_t n = 0; n < BAL_HIST_BUCKETS; n++)
+        out->counts[n] = _bal_counter_get(&h->counts[n]);
+
+    out->total = _bal_counter_get(&h->total);
+    out->sum   = _bal_counter_get(&h->sum);
+    out->max   = _bal_counter_get(&h->max);
+
+    return true;
+}
+
+uint64_t bal_histogram_bucket_min(size_t bucket)
+{
+    if (bucket < (1U << BAL_HIST_SUBBITS))
+        return bucket;
+
+    size_t shift = (bucket >> BAL_HIST_SUBBITS) - 1U;
+    size_t sub   = bucket & ((1U << BAL_HIST_SUBBITS) - 1U);
+    return ((uint64_t)(1U << BAL_HIST_SUBBITS) + sub) << shift;
+}
+
+uint64_t bal_histogram_percentile(const bal_histogram* h, double pct)
+{
+    if (!_bal_okptr(h) || 0U == h->total)
+        return 0U;
+
+    if (pct < 0.0)
+        pct = 0.0;
+    if (pct > 100.0)
+        pct = 100.0;
+
+    /* the value of the sample at that rank, to within the bucket's precision. */
+    uint64_t rank = (uint64_t)((pct / 100.0) * (double)h->total + 0.5);
+    if (0U == rank)
+        rank = 1U;
+
+    uint64_t seen = 0U;
+    for (size_t n = 0; n < BAL_HIST_BUCKETS; n++) {
+        seen += h->counts[n];
+        if (seen >= rank) {
+            uint64_t top = _bal_hist_bucket_max(n);
+            return top < h->max ? top : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+bool bal_set_callback_budget(uint64_t budget_nsec, bal_slow_cb cb, void* ctx)
+{
+    if (!_bal_sanity())
+        return false;
+
+    _BAL_MUTEX_COUNTER_INIT(watchdog);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, watchdog);
+    _bal_watchdog.budget = budget_nsec;
+    _bal_watchdog.cb     = cb;
+    _bal_watchdog.ctx    = ctx;
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, watchdog);
+    _BAL_MUTEX_COUNTER_CHECK(watchdog);
+
+    return true;
+}
+
+/**
+ * Internal functions
+ */
+
+void* _bal_calloc(size_t count, size_t size)
+{
+    _bal_count(&_bal_stats.allocs, 1U);
+    _bal_count(&_bal_stats.alloc_bytes, (uint64_t)count * size);
+    return calloc(count, size);
+}
+
+void* _bal_malloc(size_t size)
+{
+    _bal_count(&_bal_stats.allocs, 1U);
+    _bal_count(&_bal_stats.alloc_bytes, size);
+    return malloc(size);
+}
+
+void* _bal_realloc(void* ptr, size_t size)
+{
+    _bal_count(&_bal_stats.allocs, 1U);
+    _bal_count(&_bal_stats.alloc_bytes, size);
+    return realloc(ptr, size);
+}
+
+bool _bal_sockstats_create(bal_socket* s)
+{
+    bal_sockcounters* c = _bal_calloc(1, sizeof(bal_sockcounters));
+    if (!_bal_okptrnf(c))
+        return _bal_handlelasterr();
+
+#if defined(__HAVE_STDATOMICS__)
+    atomic_init(&c->sends, 0U);
+    atomic_init(&c->bytes_sent, 0U);
+    atomic_init(&c->send_wouldblock, 0U);
+    atomic_init(&c->recvs, 0U);
+    atomic_init(&c->bytes_recv, 0U);
+    atomic_init(&c->recv_wouldblock, 0U);
+    atomic_init(&c->events, 0U);
+#endif
+
+    s->state.stats = c;
+    return true;
+}
+
+void _bal_sockstats_destroy(bal_socket* s)
+{
+    _bal_safefree(&s->state.stats);
+}
+
+void _bal_count_send(const bal_socket* s, ssize_t ret)
+{
+    bal_sockcounters* c = s->state.stats;
+    if (NULL == c)
+        return;
+
+    if (ret >= 0) {
+        _bal_count(&c->sends, 1U);
+        _bal_count(&c->bytes_sent, (uint64_t)ret);
+    } else if (_bal_wouldblock(_bal_lasterror())) {
+        _bal_count(&c->send_wouldblock, 1U);
+    }
+}
+
+void _bal_count_recv(const bal_socket* s, ssize_t ret)
+{
+    bal_sockcounters* c = s->state.stats;
+    if (NULL == c)
+        return;
+
+    if (ret >= 0) {
+        _bal_count(&c->recvs, 1U);
+        _bal_count(&c->bytes_recv, (uint64_t)ret);
+    } else if (_bal_wouldblock(_bal_lasterror())) {
+        _bal_count(&c->recv_wouldblock, 1U);
+    }
+}
+
+void _bal_hist_record(int which, uint64_t value)
+{
+    bal_histcounters* h = &_bal_stats.hists[which];
+
+    _bal_count(&h->counts[_bal_hist_bucket(value)], 1U);
+    _bal_count(&h->total, 1U);
+    _bal_count(&h->sum, value);
+
+    /* samples are only recorded by the event thread. */
+    if (value > _bal_counter_get(&h->max)) {
+#if defined(__HAVE_STDATOMICS__)
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+#else
+        h->max = value;
+#endif
+    }
+}
+
+/**
+ * Static functions
+ */
+
+static size_t _bal_hist_bucket(uint64_t value)
+{
+    if (value < (1U << BAL_HIST_SUBBITS))
+        return (size_t)value;
+
+    /* the most significant bit selects a power of 2; the bits below it select
+     * one of that power's sub-buckets. */
+    unsigned msb = 0U;
+    for (unsigned step = 32U; 0U != step; step >>= 1) {
+        if (0U != (value >> (msb + step)))
+            msb += step;
+    }
+
+    unsigned shift = msb - BAL_HIST_SUBBITS;
+    size_t sub     = (size_t)(value >> shift) & ((1U << BAL_HIST_SUBBITS) - 1U);
+    return ((size_t)(shift + 1U) << BAL_HIST_SUBBITS) + sub;
+}
+
+static uint64_t _bal_hist_bucket_max(size_t bucket)
+{
+    if (bucket < (1U << BAL_HIST_SUBBITS))
+        return bucket;
+
+    size_t shift = (bucket >> BAL_HIST_SUBBITS) - 1U;
+    return bal_histogram_bucket_min(bucket) + ((1ULL << shift) - 1U);
+}
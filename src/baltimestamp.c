@@ -0,0 +1,272 @@
+/*
+ * baltimestamp.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+#if defined(__HAVE_SO_TIMESTAMPING__)
+static void _bal_tstamp_from_scm(const struct scm_timestamping* scm, uint32_t flags,
+    uint32_t sw, uint32_t hw, bal_timestamp* ts);
+#endif
+
+/**
+ * Exported functions
+ */
+
+bool bal_enable_timestamping(bal_socket* s, uint32_t flags)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    if (0U != (flags & ~(BAL_TS_RX_SOFTWARE | BAL_TS_RX_HARDWARE |
+        BAL_TS_TX_SOFTWARE | BAL_TS_TX_HARDWARE)))
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+#if !defined(__HAVE_SO_TIMESTAMPING__)
+    return _bal_seterror(_BAL_E_UNAVAIL);
+#else
+    int val = 0;
+
+    if (bal_isbitset(flags, BAL_TS_RX_SOFTWARE))
+        val |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (bal_isbitset(flags, BAL_TS_RX_HARDWARE))
+        val |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    if (bal_isbitset(flags, BAL_TS_TX_SOFTWARE))
+        val |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (bal_isbitset(flags, BAL_TS_TX_HARDWARE))
+        val |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+
+    /* tag transmit timestamps with a counter, and don't loop the payload back
+     * through the error queue along with them. */
+    if (0U != (flags & (BAL_TS_TX_SOFTWARE | BAL_TS_TX_HARDWARE)))
+        val |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    if (!bal_set_option(s, SOL_SOCKET, SO_TIMESTAMPING, &val, sizeof(val)))
+        return false;
+
+    bool retval = true;
+
+    _BAL_MUTEX_COUNTER_INIT(tstamp);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, tstamp);
+
+    if (0U == flags) {
+        _bal_tstamp_destroy(&s->state.tstamp);
+    } else {
+        if (NULL == s->state.tstamp) {
+            s->state.tstamp = _bal_calloc(1, sizeof(bal_tsqueue));
+            if (!_bal_okptrnf(s->state.tstamp))
+                retval = _bal_handlelasterr();
+        }
+        if (retval)
+            s->state.tstamp->flags = flags;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, tstamp);
+    _BAL_MUTEX_COUNTER_CHECK(tstamp);
+
+    return retval;
+#endif
+}
+
+ssize_t bal_recv_ts(const bal_socket* s, void* data, bal_iolen len, int flags,
+    bal_timestamp* ts)
+{
+    return bal_recvfrom_ts(s, data, len, flags, NULL, ts);
+}
+
+ssize_t bal_recvfrom_ts(const bal_socket* s, void* data, bal_iolen len, int flags,
+    bal_sockaddr* res, bal_timestamp* ts)
+{
+    ssize_t read = -1;
+
+    if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len) && _bal_okptr(ts)) {
+        memset(ts, 0, sizeof(bal_timestamp));
+#if defined(__HAVE_SO_TIMESTAMPING__)
+        union {
+            char buf[CMSG_SPACE(sizeof(struct scm_timestamping))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = {data, len};
+        struct msghdr msg = {0};
+
+        msg.msg_name       = res;
+        msg.msg_namelen    = NULL != res ? sizeof(bal_sockaddr) : 0;
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        read = recvmsg(s->sd, &msg, flags);
+        _bal_count_recv(s, read);
+        if (0 >= read) {
+            _bal_handlelastioerr();
+        } else if (NULL != s->state.tstamp) {
+            for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); NULL != cm;
+                cm = CMSG_NXTHDR(&msg, cm)) {
+                if (SOL_SOCKET == cm->cmsg_level && SCM_TIMESTAMPING == cm->cmsg_type) {
+                    _bal_tstamp_from_scm((const struct scm_timestamping*)CMSG_DATA(cm),
+                        s->state.tstamp->flags, BAL_TS_RX_SOFTWARE,
+                        BAL_TS_RX_HARDWARE, ts);
+                }
+            }
+        }
+#else
+        /* no ancillary timestamps on this platform; behaves as recvfrom. */
+        socklen_t sasize = sizeof(bal_sockaddr);
+        read = recvfrom(s->sd, data, len, flags, (struct sockaddr*)res,
+            NULL != res ? &sasize : NULL);
+        _bal_count_recv(s, read);
+        if (0 >= read)
+            _bal_handlelastioerr();
+#endif
+    }
+
+    return read;
+}
+
+bool bal_get_tx_timestamp(const bal_socket* s, bal_timestamp* ts)
+{
+    if (!_bal_oksock(s) || !_bal_okptr(ts))
+        return false;
+
+    bool retval = false;
+
+    _BAL_MUTEX_COUNTER_INIT(gettstamp);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, gettstamp);
+
+    bal_tsqueue* q = s->state.tstamp;
+    if (NULL == q) {
+        (void)_bal_seterror(_BAL_E_INVALIDARG);
+    } else if (0U == q->count) {
+        (void)_bal_handleerr(_BAL_EWOULDBLOCK);
+    } else {
+        *ts     = q->tx[q->head];
+        q->head = (q->head + 1U) % BAL_TS_QUEUELEN;
+        q->count--;
+        retval  = true;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, gettstamp);
+    _BAL_MUTEX_COUNTER_CHECK(gettstamp);
+
+    return retval;
+}
+
+/**
+ * Internal functions
+ */
+
+void _bal_tstamp_destroy(bal_tsqueue** q)
+{
+    _bal_safefree(q);
+}
+
+uint32_t _bal_tstamp_drain(bal_socket* s)
+{
+    uint32_t retval = 0U;
+#if defined(__HAVE_SO_TIMESTAMPING__)
+    bal_tsqueue* q = s->state.tstamp;
+
+    for (;;) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+                     CMSG_SPACE(sizeof(struct sock_extended_err) +
+                         sizeof(bal_sockaddr))];
+            struct cmsghdr align;
+        } control;
+        char data[64];
+        struct iovec iov = {data, sizeof(data)};
+        struct msghdr msg = {0};
+
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        if (-1 == recvmsg(s->sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT))
+            break;
+
+        bal_timestamp ts = {0};
+        bool tstamp      = false;
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); NULL != cm;
+            cm = CMSG_NXTHDR(&msg, cm)) {
+            if (SOL_SOCKET == cm->cmsg_level && SCM_TIMESTAMPING == cm->cmsg_type) {
+                _bal_tstamp_from_scm((const struct scm_timestamping*)CMSG_DATA(cm),
+                    q->flags, BAL_TS_TX_SOFTWARE, BAL_TS_TX_HARDWARE, &ts);
+            } else if ((SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type) ||
+                (SOL_IPV6 == cm->cmsg_level && IPV6_RECVERR == cm->cmsg_type)) {
+                const struct sock_extended_err* ee =
+                    (const struct sock_extended_err*)CMSG_DATA(cm);
+                if (ENOMSG == ee->ee_errno && SO_EE_ORIGIN_TIMESTAMPING == ee->ee_origin) {
+                    ts.id  = ee->ee_data;
+                    tstamp = true;
+                }
+            }
+        }
+
+        if (tstamp && 0U != ts.source) {
+            /* full: the oldest entry makes way. */
+            if (BAL_TS_QUEUELEN == q->count) {
+                q->head = (q->head + 1U) % BAL_TS_QUEUELEN;
+                q->count--;
+            }
+            q->tx[(q->head + q->count) % BAL_TS_QUEUELEN] = ts;
+            q->count++;
+            retval = BAL_EVT_TXTIME;
+        }
+    }
+#else
+    BAL_UNUSED(s);
+#endif
+    return retval;
+}
+
+/**
+ * Static functions
+ */
+
+#if defined(__HAVE_SO_TIMESTAMPING__)
+static void _bal_tstamp_from_scm(const struct scm_timestamping* scm, uint32_t flags,
+    uint32_t sw, uint32_t hw, bal_timestamp* ts)
+{
+    /* ts[0] is the software timestamp, ts[2] the raw hardware timestamp;
+     * whichever was requested and is non-zero wins (hardware first). */
+    const struct timespec* hwts = &scm->ts[2];
+    const struct timespec* swts = &scm->ts[0];
+
+    if (bal_isbitset(flags, hw) && (0 != hwts->tv_sec || 0 != hwts->tv_nsec)) {
+        ts->sec    = (int64_t)hwts->tv_sec;
+        ts->nsec   = (int32_t)hwts->tv_nsec;
+        ts->source = hw;
+    } else if (bal_isbitset(flags, sw) && (0 != swts->tv_sec || 0 != swts->tv_nsec)) {
+        ts->sec    = (int64_t)swts->tv_sec;
+        ts->nsec   = (int32_t)swts->tv_nsec;
+        ts->source = sw;
+    }
+}
+#endif
@@ -0,0 +1,283 @@
+/*
+ * baltrace.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include <stdio.h>
+
+#if defined(__HAVE_BAL_TRACE__)
+/* registry of every thread's ring (lock-free: pushed, never unlinked). */
+static _Atomic(bal_trace_ring*) _bal_trace_rings = NULL;
+
+/* the calling thread's ring. */
+static _bal_thread_local bal_trace_ring* _bal_trace_ring_tls = NULL;
+
+static bal_once _bal_trace_once = BAL_ONCE_INIT;
+static bool _bal_trace_keyed    = false;
+
+# if defined(__WIN__)
+static DWORD _bal_trace_fls = FLS_OUT_OF_INDEXES;
+# else
+static pthread_key_t _bal_trace_key;
+# endif
+
+static bal_trace_ring* _bal_trace_get_ring(void);
+static bool _bal_trace_write_ring(FILE* out, const bal_trace_ring* ring, unsigned long pid,
+    bool* first);
+# if defined(__WIN__)
+static BOOL CALLBACK _bal_trace_once_func(PINIT_ONCE ponce, PVOID param, PVOID* ctx);
+static void WINAPI _bal_trace_thread_exit(void* ctx);
+# else
+static void _bal_trace_once_func(void);
+static void _bal_trace_thread_exit(void* ctx);
+# endif
+#endif /* !__HAVE_BAL_TRACE__ */
+
+/**
+ * Exported functions
+ */
+
+bool bal_trace_dump(const char* path)
+{
+#if !defined(__HAVE_BAL_TRACE__)
+    BAL_UNUSED(path);
+    return _bal_seterror(_BAL_E_UNAVAIL);
+#else
+    if (!_bal_okstr(path))
+        return false;
+
+    FILE* out = NULL;
+# if defined(__WIN__)
+    if (0 != fopen_s(&out, path, "w"))
+        out = NULL;
+# else
+    out = fopen(path, "w");
+# endif
+    if (NULL == out) {
+        _bal_handlelasterr();
+        return false;
+    }
+
+# if defined(__WIN__)
+    unsigned long pid = (unsigned long)GetCurrentProcessId();
+# else
+    unsigned long pid = (unsigned long)getpid();
+# endif
+
+    /* Chrome's JSON trace event format, which Perfetto also reads. */
+    bool first = true;
+    bool ok    = 0 < fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (bal_trace_ring* ring = atomic_load(&_bal_trace_rings); ok && NULL != ring;
+        ring = ring->next)
+        ok = _bal_trace_write_ring(out, ring, pid, &first);
+    if (ok)
+        ok = 0 < fprintf(out, "\n]}\n");
+
+    if (!ok)
+        _bal_handlelasterr();
+    if (0 != fclose(out) && ok) {
+        _bal_handlelasterr();
+        ok = false;
+    }
+
+    return ok;
+#endif
+}
+
+#if defined(__HAVE_BAL_TRACE__)
+/**
+ * Internal functions
+ */
+
+void _bal_trace_record(uint8_t type, bal_descriptor sd, uint32_t arg, uint64_t start,
+    uint64_t end)
+{
+    bal_trace_ring* ring = _bal_trace_get_ring();
+    if (NULL == ring)
+        return;
+
+    uint_fast64_t count   = atomic_load_explicit(&ring->count, memory_order_relaxed);
+    bal_trace_record* rec = &ring->recs[count & (BAL_TRACE_RINGSIZE - 1U)];
+    uint64_t dur          = end > start ? end - start : 0U;
+
+    rec->ts   = start;
+    rec->dur  = dur < UINT32_MAX ? (uint32_t)dur : UINT32_MAX;
+    rec->arg  = arg;
+    rec->sd   = (uint32_t)sd;
+    rec->type = type;
+
+    atomic_store_explicit(&ring->count, count + 1U, memory_order_release);
+}
+
+void _bal_trace_name_thread(const char* name)
+{
+    bal_trace_ring* ring = _bal_trace_get_ring();
+    if (NULL != ring)
+        ring->name = name;
+}
+
+/**
+ * Static functions
+ */
+
+static bal_trace_ring* _bal_trace_get_ring(void)
+{
+    if (NULL != _bal_trace_ring_tls)
+        return _bal_trace_ring_tls;
+
+    if (!_bal_once(&_bal_trace_once, &_bal_trace_once_func) || !_bal_trace_keyed)
+        return NULL;
+
+    /* reuse the ring of a thread that has exited; its events are discarded. */
+    bal_trace_ring* ring = NULL;
+    for (bal_trace_ring* cur = atomic_load(&_bal_trace_rings); NULL != cur; cur = cur->next) {
+        bool orphaned = true;
+        if (atomic_compare_exchange_strong(&cur->orphaned, &orphaned, false)) {
+            atomic_store(&cur->count, 0U);
+            cur->name = NULL;
+            ring      = cur;
+            break;
+        }
+    }
+
+    if (NULL == ring) {
+        ring = calloc(1, sizeof(bal_trace_ring));
+        if (NULL == ring)
+            return NULL;
+
+        atomic_init(&ring->count, 0U);
+        atomic_init(&ring->orphaned, false);
+
+        bal_trace_ring* head = atomic_load(&_bal_trace_rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&_bal_trace_rings, &head, ring));
+    }
+
+    ring->tid           = _bal_gettid();
+    _bal_trace_ring_tls = ring;
+
+# if defined(__WIN__)
+    (void)FlsSetValue(_bal_trace_fls, ring);
+# else
+    (void)pthread_setspecific(_bal_trace_key, ring);
+# endif
+
+    return ring;
+}
+
+static bool _bal_trace_write_ring(FILE* out, const bal_trace_ring* ring, unsigned long pid,
+    bool* first)
+{
+    static const char* names[] = {
+        "", "poll", "dispatch", "callback", "accept", "connect", "close"
+    };
+
+    if (NULL != ring->name) {
+        if (0 > fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,"
+            "\"tid\":%lu,\"args\":{\"name\":\"%s\"}}", *first ? "" : ",", pid,
+            (unsigned long)ring->tid, ring->name))
+            return false;
+        *first = false;
+    }
+
+    uint_fast64_t count = atomic_load_explicit(&ring->count, memory_order_acquire);
+    uint_fast64_t n     = count > BAL_TRACE_RINGSIZE ? count - BAL_TRACE_RINGSIZE : 0U;
+
+    for (; n < count; n++) {
+        bal_trace_record rec = ring->recs[n & (BAL_TRACE_RINGSIZE - 1U)];
+
+        /* the owning thread keeps writing; skip records it may have been
+         * overwriting while they were copied. */
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&ring->count, memory_order_relaxed) - n >= BAL_TRACE_RINGSIZE)
+            continue;
+        if (rec.type < BAL_TRACE_POLL || rec.type > BAL_TRACE_CLOSE)
+            continue;
+
+        int ret = fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"bal\",\"pid\":%lu,\"tid\":"
+            "%lu,\"ts\":%"PRIu64".%03"PRIu64, *first ? "" : ",", names[rec.type], pid,
+            (unsigned long)ring->tid, rec.ts / 1000U, rec.ts % 1000U);
+
+        if (0 < ret) {
+            switch (rec.type) {
+                case BAL_TRACE_POLL:
+                    ret = fprintf(out, ",\"ph\":\"X\",\"dur\":%"PRIu32".%03"PRIu32
+                        ",\"args\":{\"ready\":%"PRId32"}}", rec.dur / 1000U, rec.dur % 1000U,
+                        (int32_t)rec.arg);
+                break;
+                case BAL_TRACE_DISPATCH:
+                case BAL_TRACE_CALLBACK:
+                    ret = fprintf(out, ",\"ph\":\"X\",\"dur\":%"PRIu32".%03"PRIu32
+                        ",\"args\":{\"sd\":%"PRIu32",\"events\":\"0x%08"PRIx32"\"}}",
+                        rec.dur / 1000U, rec.dur % 1000U, rec.sd, rec.arg);
+                break;
+                case BAL_TRACE_ACCEPT:
+                    ret = fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"sd\":%"PRIu32
+                        ",\"listener\":%"PRIu32"}}", rec.sd, rec.arg);
+                break;
+                default:
+                    ret = fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"sd\":%"PRIu32
+                        "}}", rec.sd);
+                break;
+            }
+        }
+
+        if (0 > ret)
+            return false;
+        *first = false;
+    }
+
+    return true;
+}
+
+# if defined(__WIN__)
+static BOOL CALLBACK _bal_trace_once_func(PINIT_ONCE ponce, PVOID param, PVOID* ctx)
+{
+    BAL_UNUSED(ponce);
+    BAL_UNUSED(param);
+    BAL_UNUSED(ctx);
+    _bal_trace_fls   = FlsAlloc(&_bal_trace_thread_exit);
+    _bal_trace_keyed  = FLS_OUT_OF_INDEXES != _bal_trace_fls;
+    return TRUE;
+}
+
+static void WINAPI _bal_trace_thread_exit(void* ctx)
+# else
+static void _bal_trace_once_func(void)
+{
+    _bal_trace_keyed = 0 == pthread_key_create(&_bal_trace_key, &_bal_trace_thread_exit);
+}
+
+static void _bal_trace_thread_exit(void* ctx)
+# endif
+{
+    /* the thread's events remain in its ring until another thread takes it. */
+    bal_trace_ring* ring = (bal_trace_ring*)ctx;
+    if (NULL != ring)
+        atomic_store(&ring->orphaned, true);
+}
+#endif /* !__HAVE_BAL_TRACE__ */
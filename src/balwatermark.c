@@ -0,0 +1,121 @@
+/*
+ * balwatermark.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2025
+ * Version:   0.3.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+/**
+ * Exported functions
+ */
+
+bool bal_set_watermarks(bal_socket* s, size_t low, size_t high, bool pause_read)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    if (0U != high && low >= high)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    _BAL_MUTEX_COUNTER_INIT(watermarks);
+    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, watermarks);
+
+    /* don't leave reads switched off under rules that no longer apply. */
+    if (s->state.wm.paused && (0U == high || !pause_read))
+        bal_setbitshigh(&s->state.mask, BAL_EVT_READ);
+
+    s->state.wm.low        = low;
+    s->state.wm.high       = high;
+    s->state.wm.pause_read = 0U != high && pause_read;
+    s->state.wm.above      = false;
+    s->state.wm.paused     = false;
+
+    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, watermarks);
+    _BAL_MUTEX_COUNTER_CHECK(watermarks);
+
+    return true;
+}
+
+size_t bal_get_sendqueue_size(const bal_socket* s)
+{
+    size_t size = 0;
+
+    if (_bal_oksock(s)) {
+#if defined(__HAVE_SIOCOUTQ__)
+        int queued = 0;
+        if (0 != ioctl(s->sd, SIOCOUTQ, &queued)) {
+            _bal_handlelasterr();
+        } else {
+            size = (size_t)queued;
+        }
+#elif defined(SO_NWRITE)
+        int queued = 0;
+        if (bal_get_option(s, SOL_SOCKET, SO_NWRITE, &queued, sizeof(int)))
+            size = (size_t)queued;
+#endif
+        /* bytes held back by write coalescing haven't reached the kernel yet. */
+        if (NULL != s->state.coalesce)
+            size += s->state.coalesce->len - s->state.coalesce->off;
+    }
+
+    return size;
+}
+
+/**
+ * Internal functions
+ */
+
+uint32_t _bal_watermark_check(bal_socket* s)
+{
+    if (0U == s->state.wm.high)
+        return 0U;
+
+    size_t queued = bal_get_sendqueue_size(s);
+
+    if (!s->state.wm.above && queued >= s->state.wm.high) {
+        s->state.wm.above = true;
+        if (s->state.wm.pause_read && bal_bitsinmask(s, BAL_EVT_READ)) {
+            bal_setbitslow(&s->state.mask, BAL_EVT_READ);
+            s->state.wm.paused = true;
+        }
+        _bal_dbglog("socket "BAL_SOCKET_SPEC" send queue high (%zu bytes)", s->sd,
+            queued);
+        return BAL_EVT_WRITE_HIGH;
+    }
+
+    if (s->state.wm.above && queued <= s->state.wm.low) {
+        s->state.wm.above = false;
+        if (s->state.wm.paused) {
+            bal_setbitshigh(&s->state.mask, BAL_EVT_READ);
+            s->state.wm.paused = false;
+        }
+        _bal_dbglog("socket "BAL_SOCKET_SPEC" send queue low (%zu bytes)", s->sd,
+            queued);
+        return BAL_EVT_WRITE_LOW;
+    }
+
+    return 0U;
+}
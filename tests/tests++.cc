@@ -26,12 +26,136 @@
 #include "tests++.hh"
 #include <vector>
 #include <cstdlib>
+#include <atomic>
+#include <array>
+#include <memory_resource>
 
 using namespace bal;
 
+namespace
+{
+    /* handles read events for an accepted connection (see crtp_socket). */
+    class reader : public bal::socket<reader>
+    {
+    public:
+        bool on_read()
+        {
+            char buf[16] {};
+            if (recv(buf, sizeof(buf), 0) > 0) {
+                read = true;
+            }
+            return true;
+        }
+
+        std::atomic_bool read = false;
+    };
+
+    /* accepts one connection and echoes what it receives (see coroutines). */
+    bal::task echo_once(scoped_socket& listener, std::atomic_bool& done)
+    {
+        scoped_socket conn;
+        address peer;
+        if (co_await listener.async_accept(conn, peer) && conn.async_poll()) {
+            char buf[16] {};
+            const auto res = co_await conn.async_recv(buf, sizeof(buf));
+            if (res) {
+                [[maybe_unused]] const auto sent =
+                    co_await conn.async_send(buf, static_cast<bal_iolen>(*res));
+            }
+        }
+        done = true;
+    }
+
+    /* connects, sends "ping" and awaits the echo (see coroutines). */
+    bal::task ping(scoped_socket& client, std::string port, std::atomic_bool& echoed)
+    {
+        if (co_await client.async_connect("127.0.0.1", port)) {
+            const auto sent = co_await client.async_send("ping", 4);
+            char buf[16] {};
+            const auto res = co_await client.async_recv(buf, sizeof(buf));
+            echoed = sent && res && 4U == *res && 0 == memcmp(buf, "ping", 4);
+        }
+    }
+
+    /* awaits a connect that can't begin; the exception ends up in the task
+     * (see coroutines). */
+    bal::task connect_unregistered(scoped_socket& sock)
+    {
+        [[maybe_unused]] const auto connected = co_await sock.async_connect("127.0.0.1", "1");
+    }
+    std::atomic_int _srv_connects = 0;
+    std::atomic_int _srv_disconnects = 0;
+
+    /* echoes each read back; "big" is answered with 1 MiB and a close, which
+     * must still arrive in full (see server). */
+    struct echo_handler
+    {
+        void on_connect(auto&)
+        {
+            _srv_connects++;
+        }
+
+        void on_data(auto& conn, std::span<const std::byte> data)
+        {
+            if (data.size() == 3U && 0 == memcmp(data.data(), "big", 3)) {
+                const std::vector<std::byte> big(1024U * 1024U, std::byte {'x'});
+                [[maybe_unused]] const auto sent = conn.send(big);
+                conn.close();
+            } else {
+                [[maybe_unused]] const auto sent = conn.send(data);
+            }
+        }
+
+        void on_disconnect(auto&)
+        {
+            _srv_disconnects++;
+        }
+    };
+
+    std::atomic_size_t _flood_sent = 0U;
+    std::atomic_size_t _flood_queued = 0U;
+    std::atomic_bool _flood_refused = false;
+    std::atomic_bool _flood_drained = false;
+
+    /* answers any read with all the server will take, until the peer (which
+     * doesn't read) has stopped taking any for a while (see server_backpressure). */
+    struct flood_handler
+    {
+        void on_data(auto& conn, std::span<const std::byte>)
+        {
+            const std::vector<std::byte> chunk(65536U, std::byte {'x'});
+            size_t sent = 0U;
+            for (int refused = 0; refused < 20;) {
+                if (conn.send(chunk)) {
+                    sent += chunk.size();
+                    refused = 0;
+                } else {
+                    _flood_refused = true;
+                    refused++;
+                    bal_sleep_msec(10);
+                }
+            }
+            _flood_queued = conn.get_queued();
+            _flood_sent   = sent;
+        }
+
+        void on_drain(auto&)
+        {
+            _flood_drained = true;
+        }
+    };
+} // !namespace
+
 static std::vector<bal_test_data> bal_tests = {
     {"raii-initializer",   tests::init_with_initializer, false, true, false},
-    {"raii_socket_sanity", tests::raii_socket_sanity, false, true, false }
+    {"raii_socket_sanity", tests::raii_socket_sanity, false, true, false },
+    {"address-format",     tests::address_format, false, true, false },
+    {"crtp-socket",        tests::crtp_socket, false, true, false },
+    {"coroutines",         tests::coroutines, false, true, false },
+    {"span-pmr",           tests::span_pmr, false, true, false },
+    {"connection-pool",    tests::connection_pool, false, true, false },
+    {"server",             tests::server, false, true, false },
+    {"server-backpressure", tests::server_backpressure, false, true, false }
 };
 
 int main(int argc, char** argv)
@@ -123,6 +247,293 @@ bool bal::tests::raii_socket_sanity()
     _BAL_TEST_CONCLUDE
 }
 
+bool bal::tests::address_format()
+{
+    _BAL_TEST_COMMENCE
+
+    const auto v4 = address::prepare("10.1.2.3", "8080");
+    const auto v6 = address::prepare("::1", "443");
+
+    TEST_MSG("to_string: '%s', '%s'", v4.to_string().c_str(), v6.to_string().c_str());
+    _bal_eqland(pass, v4.to_string().view() == "10.1.2.3:8080");
+    _bal_eqland(pass, v6.to_string().view() == "[::1]:443");
+    _bal_eqland(pass, address {}.to_string().empty());
+
+#if defined(__HAVE_STD_FORMAT__)
+    const auto str = std::format("{} -> {}", v4, v6);
+    TEST_MSG("std::format: '%s'", str.c_str());
+    _bal_eqland(pass, str == "10.1.2.3:8080 -> [::1]:443");
+#endif
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::crtp_socket()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("connecting, accepting into a socket<reader>...");
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, listener.bind("127.0.0.1", "0"));
+    _bal_eqland(pass, listener.listen());
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(listener.get(), false, &strings));
+    _bal_eqland(pass, client.connect("127.0.0.1", strings.port));
+
+    bal::handler<reader> conn;
+    address peer;
+    _bal_eqland(pass, listener.accept(conn, peer));
+    _bal_eqland(pass, reader::from_user_data(conn.get()) == &conn);
+    _bal_eqland(pass, conn.async_poll());
+
+    TEST_MSG_0("sending; the handler's on_read should be called...");
+    _bal_eqland(pass, 4 == client.send("ping", 4));
+    for (int n = 0; pass && n < 100 && !conn.read; n++) {
+        bal_sleep_msec(20);
+    }
+    _bal_eqland(pass, conn.read.load());
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::coroutines()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("listening and connecting from coroutines...");
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, listener.bind("127.0.0.1", "0"));
+    _bal_eqland(pass, listener.listen());
+    _bal_eqland(pass, listener.async_poll());
+    _bal_eqland(pass, client.async_poll(BAL_EVT_CLIENT));
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(listener.get(), false, &strings));
+
+    std::atomic_bool done   = false;
+    std::atomic_bool echoed = false;
+    const auto accepting = echo_once(listener, done);
+    const auto pinging   = ping(client, strings.port, echoed);
+
+    TEST_MSG_0("waiting for the echo...");
+    for (int n = 0; pass && n < 100 && !(accepting.done() && pinging.done()); n++) {
+        bal_sleep_msec(20);
+    }
+    _bal_eqland(pass, done.load() && echoed.load());
+    _bal_eqland(pass, accepting.done() && !accepting.exception());
+    _bal_eqland(pass, pinging.done() && !pinging.exception());
+
+    TEST_MSG_0("observing an exception thrown from a coroutine...");
+    scoped_socket unregistered(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    const auto failing = connect_unregistered(unregistered);
+    _bal_eqland(pass, failing.done() && failing.exception());
+    bool rethrown = false;
+    try {
+        failing.rethrow_if_failed();
+    } catch (bal::exception&) {
+        rethrown = true;
+    }
+    _bal_eqland(pass, rethrown);
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::span_pmr()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("sending and receiving std::span buffers...");
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    scoped_socket conn;
+    _bal_eqland(pass, listener.bind("127.0.0.1", "0"));
+    _bal_eqland(pass, listener.listen());
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(listener.get(), false, &strings));
+    _bal_eqland(pass, client.connect("127.0.0.1", strings.port));
+
+    address peer;
+    _bal_eqland(pass, listener.accept(conn, peer));
+
+    const std::string_view ping = "ping";
+    _bal_eqland(pass, 4 == client.send(std::as_bytes(std::span {ping})));
+    std::array<std::byte, 16> buf {};
+    _bal_eqland(pass, 4 == conn.recv(buf));
+    _bal_eqland(pass, 0 == std::memcmp(buf.data(), ping.data(), ping.size()));
+
+    TEST_MSG_0("allocating address strings and lists from an arena...");
+    std::array<std::byte, 4096> storage {};
+    std::pmr::monotonic_buffer_resource arena {storage.data(), storage.size(),
+        std::pmr::null_memory_resource()};
+
+    const auto info = peer.get_address_info(false, &arena);
+    TEST_MSG("peer: %s:%s", info.get_addr().c_str(), info.get_port().c_str());
+    _bal_eqland(pass, info.get_addr() == "127.0.0.1");
+    _bal_eqland(pass, info.get_allocator().resource() == &arena);
+
+    address_list addrs {&arena};
+    _bal_eqland(pass, scoped_socket::resolve_host("127.0.0.1", addrs));
+    _bal_eqland(pass, !addrs.empty());
+    _bal_eqland(pass, addrs.get_allocator().resource() == &arena);
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::connection_pool()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("checking a connection out of a pool, in, and out again...");
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, listener.bind("127.0.0.1", "0"));
+    _bal_eqland(pass, listener.listen());
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(listener.get(), false, &strings));
+
+    bal::connection_pool<> pool;
+    scoped_socket conn;
+    _bal_eqland(pass, pool.checkout("127.0.0.1", strings.port, conn));
+    const auto* first = conn.get();
+    _bal_eqland(pass, pool.checkin(conn));
+    _bal_eqland(pass, !conn.is_valid());
+    _bal_eqland(pass, pool.checkout("127.0.0.1", strings.port, conn));
+    _bal_eqland(pass, conn.get() == first);
+
+    TEST_MSG_0("checking another out asynchronously...");
+    std::atomic<bal_socket*> handed = nullptr;
+    _bal_eqland(pass, pool.checkout_async("127.0.0.1", strings.port,
+        [&handed](bal_socket* s) { handed = s; }));
+    for (int n = 0; pass && n < 100 && nullptr == handed.load(); n++) {
+        bal_sleep_msec(20);
+    }
+
+    scoped_socket other;
+    [[maybe_unused]] const auto* existing = other.attach(handed.load());
+    _bal_eqland(pass, other.is_valid());
+
+    bal_pool_stats stats {};
+    _bal_eqland(pass, pool.get_stats(stats));
+    TEST_MSG("created: %" PRIu64 ", reused: %" PRIu64 ", busy: %zu", stats.created,
+        stats.reused, stats.busy);
+    _bal_eqland(pass, 2U == stats.created && 1U == stats.reused && 2U == stats.busy);
+    _bal_eqland(pass, pool.checkin(conn) && pool.checkin(other));
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::server()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("starting a server with two workers...");
+    bal::server<echo_handler> srv({.workers = 2U});
+    _bal_eqland(pass, srv.start("127.0.0.1", "0"));
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(srv.get_listener(), false, &strings));
+
+    TEST_MSG_0("connecting three clients and checking their echoes...");
+    std::vector<scoped_socket> clients;
+    for (int n = 0; pass && n < 3; n++) {
+        auto& client = clients.emplace_back(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        _bal_eqland(pass, client.set_recv_timeout(5, 0));
+        _bal_eqland(pass, client.connect("127.0.0.1", strings.port));
+        _bal_eqland(pass, 4 == client.send("ping", 4));
+
+        std::array<char, 4> buf {};
+        size_t got = 0U;
+        while (pass && got < buf.size()) {
+            const auto read = client.recv(buf.data() + got, to_iolen(buf.size() - got), 0);
+            _bal_eqland(pass, read > 0);
+            got += read > 0 ? static_cast<size_t>(read) : 0U;
+        }
+        _bal_eqland(pass, 0 == memcmp(buf.data(), "ping", 4));
+    }
+
+    for (int n = 0; pass && n < 100 && _srv_connects.load() < 3; n++) {
+        bal_sleep_msec(20);
+    }
+    _bal_eqland(pass, 3 == _srv_connects.load() && 3U == srv.get_connection_count());
+
+    TEST_MSG_0("checking that a close waits for queued writes...");
+    if (pass) {
+        _bal_eqland(pass, 3 == clients[0].send("big", 3));
+        std::vector<char> buf(65536U);
+        size_t total = 0U;
+        ssize_t read = 0;
+        while (pass && (read = clients[0].recv(buf.data(), to_iolen(buf.size()), 0)) > 0) {
+            total += static_cast<size_t>(read);
+        }
+        TEST_MSG("received %zu bytes before the close", total);
+        _bal_eqland(pass, 0 == read && 1024U * 1024U == total);
+    }
+
+    TEST_MSG_0("stopping the server and checking the rest are closed...");
+    _bal_eqland(pass, srv.stop());
+    _bal_eqland(pass, 3 == _srv_disconnects.load() && 0U == srv.get_connection_count());
+    for (size_t n = 1U; pass && n < clients.size(); n++) {
+        char buf[16] {};
+        _bal_eqland(pass, 0 == clients[n].recv(buf, sizeof(buf), 0));
+    }
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::server_backpressure()
+{
+    _BAL_TEST_COMMENCE
+
+    constexpr size_t limit = 256U * 1024U;
+    TEST_MSG_0("starting a server with a small send queue limit...");
+    bal::server<flood_handler> srv({.workers = 1U, .send_queue_limit = limit});
+    _bal_eqland(pass, srv.start("127.0.0.1", "0"));
+
+    bal_addrstrings strings {};
+    _bal_eqland(pass, bal_get_localhost_strings(srv.get_listener(), false, &strings));
+
+    TEST_MSG_0("asking for a flood, without reading any of it...");
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, client.set_recvbuf_size(65536));
+    _bal_eqland(pass, client.set_recv_timeout(5, 0));
+    _bal_eqland(pass, client.connect("127.0.0.1", strings.port));
+    _bal_eqland(pass, 5 == client.send("flood", 5));
+    for (int n = 0; pass && n < 500 && 0U == _flood_sent; n++) {
+        bal_sleep_msec(20);
+    }
+    TEST_MSG("queued %zu of %zu bytes once stalled", _flood_queued.load(),
+        _flood_sent.load());
+    _bal_eqland(pass, _flood_refused.load() && _flood_sent.load() > 0U);
+    _bal_eqland(pass, _flood_queued.load() > 0U && _flood_queued.load() <= limit);
+
+    /* the queue may have drained while the kernel still took data. */
+    bal_sleep_msec(200);
+    _flood_drained = false;
+    bal_sleep_msec(200);
+    _bal_eqland(pass, !_flood_drained.load());
+
+    TEST_MSG_0("reading it all; the handler should hear that it drained...");
+    std::vector<char> buf(65536U);
+    size_t total = 0U;
+    while (pass && total < _flood_sent) {
+        const auto read = client.recv(buf.data(), to_iolen(buf.size()), 0);
+        _bal_eqland(pass, read > 0);
+        total += read > 0 ? static_cast<size_t>(read) : 0U;
+    }
+    for (int n = 0; pass && n < 100 && !_flood_drained; n++) {
+        bal_sleep_msec(20);
+    }
+    _bal_eqland(pass, total == _flood_sent && _flood_drained.load());
+
+    _bal_eqland(pass, srv.stop());
+
+    _BAL_TEST_CONCLUDE
+}
+
 /*bool bal::tests::()
 {
     _BAL_TEST_COMMENCE
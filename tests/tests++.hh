@@ -52,6 +52,61 @@ namespace bal::tests
      */
     bool raii_socket_sanity();
 
+    /**
+     * @test address_format
+     * @brief Ensure that addresses format without a resolver, and work with
+     * std::format.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool address_format();
+
+    /**
+     * @test crtp_socket
+     * @brief Ensure that a socket<THandler>'s event handlers are called.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool crtp_socket();
+
+    /**
+     * @test coroutines
+     * @brief Ensure that accept, connect, send and receive can be awaited, and
+     * that an exception thrown from a coroutine is kept by its task.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool coroutines();
+
+    /**
+     * @test span_pmr
+     * @brief Ensure that std::span buffers can be sent and received, and that
+     * address strings and lists allocate from a std::pmr::memory_resource.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool span_pmr();
+
+    /**
+     * @test connection_pool
+     * @brief Ensure that pooled connections are reused, and that a connection
+     * can be checked out asynchronously.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool connection_pool();
+
+    /**
+     * @test server
+     * @brief Ensure that a server echoes through its workers, sends everything
+     * queued before a close, and closes its connections when stopped.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool server();
+
+    /**
+     * @test server_backpressure
+     * @brief Ensure that a server refuses to queue more than send_queue_limit
+     * bytes for a peer that doesn't read, and reports when the queue drains.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool server_backpressure();
+
     /**
      * @ test
      * @ brief
@@ -25,6 +25,8 @@
  */
 #include "tests.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 
 #pragma message("TODO: implement CLI")
 #pragma message("TODO: implement offline-only test runs")
@@ -32,7 +34,29 @@
 static bal_test_data bal_tests[] = {
     {"init-cleanup-sanity", baltest_init_cleanup_sanity, false, true, false},
     {"create-bind-listen",  baltest_create_bind_listen_tcp, false, true, false},
-    {"error-sanity",        baltest_error_sanity, false, true, false}
+    {"error-sanity",        baltest_error_sanity, false, true, false},
+    {"framing-delim",       baltest_framing_delim, false, true, false},
+    {"write-coalescing",    baltest_write_coalescing, false, true, false},
+    {"watermarks",          baltest_watermarks, false, true, false},
+    {"timestamping",        baltest_timestamping, false, true, false},
+    {"resolve-async",       baltest_resolve_async, false, true, false},
+    {"resolver-cache",      baltest_resolver_cache, false, true, false},
+    {"sendto-dest",         baltest_sendto_dest, false, true, false},
+    {"connect-race",        baltest_connect_race, false, true, false},
+    {"addrlist",            baltest_addrlist, false, true, false},
+    {"parse-addr",          baltest_parse_addr, false, true, false},
+    {"format-addr",         baltest_format_addr, false, true, false},
+    {"error-lazy",          baltest_error_lazy, false, true, false},
+    {"try-io",              baltest_try_io, false, true, false},
+    {"dbglog-async",        baltest_dbglog_async, false, true, false},
+    {"trace",               baltest_trace, false, true, false},
+    {"stats",               baltest_stats, false, true, false},
+    {"callback-watchdog",   baltest_callback_watchdog, false, true, false},
+    {"lock-profiler",       baltest_lock_profiler, false, true, false},
+    {"arena",               baltest_arena, false, true, false},
+    {"connection-pool",     baltest_connection_pool, false, true, false},
+    {"coalesce-close",      baltest_coalesce_close, false, true, false},
+    {"coalesce-error",      baltest_coalesce_error, false, true, false}
 };
 
 int main(int argc, char** argv)
@@ -159,6 +183,8 @@ bool baltest_error_sanity(void)
         {BAL_E_INTERNAL,   "BAL_E_INTERNAL"},   /* An internal error has occurred */
         {BAL_E_UNAVAIL,    "BAL_E_UNAVAIL"},    /* Feature is disabled or unavailable */
         {BAL_E_PLATFORM,   "BAL_E_PLATFORM"},   /* Platform error code %d: %s */
+        {BAL_E_BADFRAME,   "BAL_E_BADFRAME"},   /* Malformed or oversized message frame */
+        {BAL_E_POOLFULL,   "BAL_E_POOLFULL"},   /* Connection pool limit reached */
         {BAL_E_UNKNOWN,    "BAL_E_UNKNOWN"}     /* An unknown error has occurred */
     };
 
@@ -196,3 +222,1695 @@ bool baltest_error_sanity(void)
 
     return pass;
 }
+
+static char _framing_frames[64];
+static atomic_uint_fast32_t _framing_count;
+
+static void _framing_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        bal_frame frame = {0};
+        if (bal_get_frame(s, &frame)) {
+            size_t used = strnlen(_framing_frames, sizeof(_framing_frames));
+            if (used + frame.len + 2 < sizeof(_framing_frames)) {
+                memcpy(&_framing_frames[used], frame.data, frame.len);
+                _framing_frames[used + frame.len] = '|';
+            }
+            atomic_fetch_add(&_framing_count, 1);
+        }
+    }
+}
+
+bool baltest_framing_delim(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+
+    memset(_framing_frames, 0, sizeof(_framing_frames));
+    atomic_store(&_framing_count, 0);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a loopback client and accepting it...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("enabling CRLF delimiter framing...");
+    bal_framing cfg = {0};
+    cfg.mode        = BAL_FRAME_DELIM;
+    cfg.delim.len   = 2;
+    memcpy(cfg.delim.bytes, "\r\n", 2);
+    _bal_eqland(pass, bal_set_framing(a, &cfg));
+    _bal_eqland(pass, bal_async_poll(a, &_framing_callback, BAL_EVT_NORMAL));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("sending three frames split across two writes...");
+    static const char part1[] = "one\r\ntwo\r\nthr";
+    static const char part2[] = "ee\r\n";
+    _bal_eqland(pass, bal_send(c, part1, sizeof(part1) - 1, 0) == (ssize_t)(sizeof(part1) - 1));
+    bal_sleep_msec(50);
+    _bal_eqland(pass, bal_send(c, part2, sizeof(part2) - 1, 0) == (ssize_t)(sizeof(part2) - 1));
+    _bal_print_err(pass, false);
+
+    for (int n = 0; pass && n < 100 && atomic_load(&_framing_count) < 3; n++)
+        bal_sleep_msec(20);
+
+    TEST_MSG("received %"PRIuFAST32" frame(s): '%s'", atomic_load(&_framing_count),
+        _framing_frames);
+    _bal_eqland(pass, 3 == atomic_load(&_framing_count));
+    _bal_eqland(pass, 0 == strcmp(_framing_frames, "one|two|three|"));
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_bool _coalesce_pending;
+static bal_socket* _coalesce_client;
+
+static void _coalescing_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[16] = {0};
+        if (bal_recv(s, buf, sizeof(buf), 0) > 0) {
+            /* none of these should hit the wire until the callback returns. */
+            bool queued = 2 == bal_send(s, "po", 2, 0);
+            queued &= 1 == bal_send(s, "n", 1, 0);
+            queued &= 1 == bal_send(s, "g", 1, 0);
+            /* over loopback, anything sent would already be readable. */
+            queued &= 0 == bal_get_recvqueue_size(_coalesce_client);
+            atomic_store(&_coalesce_pending, queued);
+        }
+    }
+}
+
+bool baltest_write_coalescing(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+
+    atomic_store(&_coalesce_pending, false);
+    _coalesce_client = NULL;
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener and client...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_set_recv_timeout(c, 2, 0));
+    _bal_print_err(pass, false);
+    _coalesce_client = c;
+
+    TEST_MSG_0("enabling write coalescing on the accepted socket...");
+    _bal_eqland(pass, bal_set_coalescing(a, true));
+    _bal_eqland(pass, bal_async_poll(a, &_coalescing_callback, BAL_EVT_NORMAL));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("sending a request; expecting a reply sent in three parts...");
+    _bal_eqland(pass, 4 == bal_send(c, "ping", 4, 0));
+
+    char reply[8] = {0};
+    size_t got    = 0;
+    while (pass && got < 4) {
+        ssize_t ret = bal_recv(c, &reply[got], (bal_iolen)(sizeof(reply) - 1 - got), 0);
+        if (ret <= 0)
+            break;
+        got += (size_t)ret;
+    }
+
+    TEST_MSG("received '%s'", reply);
+    _bal_eqland(pass, 0 == strcmp(reply, "pong"));
+    _bal_eqland(pass, atomic_load(&_coalesce_pending));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_uint_fast32_t _wm_events;
+
+static void _watermark_callback(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    atomic_fetch_or(&_wm_events, events & (BAL_EVT_WRITE_HIGH | BAL_EVT_WRITE_LOW));
+}
+
+static bool _wait_for_events(atomic_uint_fast32_t* events, uint32_t want)
+{
+    for (int n = 0; n < 150 && want != (atomic_load(events) & want); n++)
+        bal_sleep_msec(20);
+    return want == (atomic_load(events) & want);
+}
+
+bool baltest_watermarks(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+
+    atomic_store(&_wm_events, 0U);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener and client...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_set_recv_timeout(c, 2, 0));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("setting watermarks (low = 4 KiB, high = 16 KiB, pause reads)...");
+    _bal_eqland(pass, bal_set_watermarks(a, 4096, 16384, true));
+    _bal_eqland(pass, bal_async_poll(a, &_watermark_callback,
+        BAL_EVT_NORMAL | BAL_EVT_WRITE_HIGH | BAL_EVT_WRITE_LOW));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("filling the send queue while the peer isn't reading...");
+    static char chunk[4096];
+    size_t total = 0;
+    while (pass && total < 64U * 1024U * 1024U) {
+        ssize_t ret = bal_send(a, chunk, sizeof(chunk), 0);
+        if (ret <= 0)
+            break;
+        total += (size_t)ret;
+    }
+
+    TEST_MSG("queued %zu bytes; waiting for BAL_EVT_WRITE_HIGH...", total);
+    _bal_eqland(pass, _wait_for_events(&_wm_events, BAL_EVT_WRITE_HIGH));
+    _bal_eqland(pass, !bal_bitsinmask(a, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("draining the peer; waiting for BAL_EVT_WRITE_LOW...");
+    size_t drained = 0;
+    while (pass && drained < total) {
+        ssize_t ret = bal_recv(c, chunk, sizeof(chunk), 0);
+        if (ret <= 0)
+            break;
+        drained += (size_t)ret;
+    }
+
+    _bal_eqland(pass, drained == total);
+    _bal_eqland(pass, _wait_for_events(&_wm_events, BAL_EVT_WRITE_LOW));
+    _bal_eqland(pass, bal_bitsinmask(a, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_uint_fast32_t _ts_events;
+
+static void _timestamping_callback(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    atomic_fetch_or(&_ts_events, events & BAL_EVT_TXTIME);
+}
+
+bool baltest_timestamping(void)
+{
+    bal_socket* rx = NULL;
+    bal_socket* tx = NULL;
+
+    atomic_store(&_ts_events, 0U);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback UDP sockets...");
+    _bal_eqland(pass, bal_create(&rx, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_create(&tx, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_bind(rx, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_set_recv_timeout(rx, 2, 0));
+    _bal_print_err(pass, false);
+
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, bal_get_localhost_strings(rx, false, &strings));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("enabling software timestamping...");
+    bool supported = bal_enable_timestamping(rx, BAL_TS_RX_SOFTWARE);
+    if (!supported) {
+        bal_error err = {0};
+        _bal_eqland(pass, BAL_E_UNAVAIL == bal_get_error(&err));
+        TEST_MSG_0("kernel timestamping is unavailable on this platform; skipping");
+    } else {
+        _bal_eqland(pass, bal_enable_timestamping(tx, BAL_TS_TX_SOFTWARE));
+        _bal_eqland(pass, bal_async_poll(tx, &_timestamping_callback,
+            BAL_EVT_ERROR | BAL_EVT_TXTIME));
+        _bal_print_err(pass, false);
+
+        /* the kernel turns stamping on lazily, so the first datagrams after
+         * enabling it may arrive without one. */
+        TEST_MSG("sending datagrams to 127.0.0.1:%s...", strings.port);
+        char buf[8]      = {0};
+        bal_timestamp ts = {0};
+        for (int n = 0; pass && n < 10 && 0U == ts.source; n++) {
+            _bal_eqland(pass, 4 == bal_sendto(tx, "127.0.0.1", strings.port, "tick", 4, 0));
+            _bal_eqland(pass, 4 == bal_recv_ts(rx, buf, sizeof(buf), 0, &ts));
+            if (0U == ts.source)
+                bal_sleep_msec(20);
+        }
+        TEST_MSG("rx timestamp: %"PRId64".%09"PRId32" (source = %"PRIu32")", ts.sec,
+            ts.nsec, ts.source);
+        _bal_eqland(pass, BAL_TS_RX_SOFTWARE == ts.source && 0 < ts.sec);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("waiting for BAL_EVT_TXTIME...");
+        _bal_eqland(pass, _wait_for_events(&_ts_events, BAL_EVT_TXTIME));
+        memset(&ts, 0, sizeof(ts));
+        _bal_eqland(pass, bal_get_tx_timestamp(tx, &ts));
+        TEST_MSG("tx timestamp: %"PRId64".%09"PRId32" (source = %"PRIu32", id = %"
+            PRIu32")", ts.sec, ts.nsec, ts.source, ts.id);
+        _bal_eqland(pass, BAL_TS_TX_SOFTWARE == ts.source && 0 < ts.sec);
+        _bal_print_err(pass, false);
+    }
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != tx)
+        _bal_eqland(pass, bal_close(&tx, true));
+    if (NULL != rx)
+        _bal_eqland(pass, bal_close(&rx, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_uint_fast32_t _resolve_events;
+
+static void _resolve_callback(bal_addrlist* addrs, void* ctx)
+{
+    size_t* count = (size_t*)ctx;
+    if (NULL != addrs) {
+        while (NULL != bal_enum_addrlist(addrs))
+            (*count)++;
+    }
+    atomic_fetch_or(&_resolve_events, 1U);
+}
+
+static void _connect_async_callback(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    atomic_fetch_or(&_resolve_events, events & (BAL_EVT_CONNECT | BAL_EVT_CONNFAIL));
+}
+
+bool baltest_resolve_async(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    size_t count  = 0;
+
+    atomic_store(&_resolve_events, 0U);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("resolving 'localhost' asynchronously...");
+    _bal_eqland(pass, bal_resolve_async("localhost", NULL, &_resolve_callback, &count));
+    _bal_eqland(pass, _wait_for_events(&_resolve_events, 1U));
+    TEST_MSG("resolved %zu address(es)", count);
+    _bal_eqland(pass, count > 0);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener...");
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, _bal_loopback_listener(&l, &strings));
+    _bal_print_err(pass, false);
+
+    TEST_MSG("connecting asynchronously to 127.0.0.1:%s...", strings.port);
+    _bal_eqland(pass, bal_create(&c, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, !bal_connect_async(c, "127.0.0.1", strings.port));
+    _bal_eqland(pass, bal_async_poll(c, &_connect_async_callback, BAL_EVT_CLIENT));
+    _bal_eqland(pass, bal_connect_async(c, "127.0.0.1", strings.port));
+    _bal_eqland(pass, _wait_for_events(&_resolve_events, BAL_EVT_CONNECT));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_resolver_cache(void)
+{
+    bal_cache_stats stats = {0};
+    bal_addrlist al       = {0};
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("configuring an 8-entry resolver cache...");
+    _bal_eqland(pass, bal_set_resolver_cache(8, 60, 5));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("resolving 'localhost' twice...");
+    for (size_t n = 0; n < 2; n++) {
+        _bal_eqland(pass, bal_resolve_host("localhost", &al));
+        _bal_eqland(pass, NULL != bal_enum_addrlist(&al));
+        _bal_eqland(pass, bal_free_addrlist(&al));
+    }
+    _bal_eqland(pass, bal_get_resolver_cache_stats(&stats));
+    TEST_MSG("hits: %"PRIu64", misses: %"PRIu64, stats.hits, stats.misses);
+    _bal_eqland(pass, 1U == stats.hits && 1U == stats.misses && 1U == stats.entries);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("resolving a literal address (bypasses the cache)...");
+    _bal_eqland(pass, bal_resolve_host("127.0.0.1", &al));
+    _bal_eqland(pass, bal_free_addrlist(&al));
+    _bal_eqland(pass, bal_get_resolver_cache_stats(&stats));
+    _bal_eqland(pass, 1U == stats.misses && 1U == stats.entries);
+    _bal_print_err(pass, false);
+
+    /* every port is a separate cache key. */
+    TEST_MSG_0("overflowing the cache...");
+    for (int n = 1; n <= 10; n++) {
+        char port[8] = {0};
+        (void)snprintf(port, sizeof(port), "%d", n);
+        _bal_eqland(pass, _bal_resolve_addrlist(0, PF_UNSPEC, SOCK_STREAM, "localhost",
+            port, &al));
+        _bal_eqland(pass, bal_free_addrlist(&al));
+    }
+    _bal_eqland(pass, bal_get_resolver_cache_stats(&stats));
+    TEST_MSG("entries: %zu, evictions: %"PRIu64, stats.entries, stats.evictions);
+    _bal_eqland(pass, 8U == stats.entries && 3U == stats.evictions);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("flushing the cache...");
+    _bal_eqland(pass, bal_flush_resolver_cache());
+    _bal_eqland(pass, bal_get_resolver_cache_stats(&stats));
+    _bal_eqland(pass, 0U == stats.entries);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("disabling the cache...");
+    _bal_eqland(pass, bal_set_resolver_cache(0, 0, 0));
+    _bal_eqland(pass, bal_resolve_host("localhost", &al));
+    _bal_eqland(pass, bal_free_addrlist(&al));
+    _bal_eqland(pass, bal_get_resolver_cache_stats(&stats));
+    _bal_eqland(pass, 0U == stats.misses && 0U == stats.entries);
+    _bal_eqland(pass, bal_set_resolver_cache(BAL_RESCACHE_MAXENTRIES, BAL_RESCACHE_TTL,
+        BAL_RESCACHE_NEGTTL));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_sendto_dest(void)
+{
+    bal_socket* rx = NULL;
+    bal_socket* tx = NULL;
+    bal_dest dests[100];
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback UDP sockets...");
+    _bal_eqland(pass, bal_create(&rx, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_create(&tx, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_bind(rx, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_set_recv_timeout(rx, 2, 0));
+    _bal_eqland(pass, bal_set_recvbuf_size(rx, 1024 * 1024));
+    _bal_print_err(pass, false);
+
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, bal_get_localhost_strings(rx, false, &strings));
+    _bal_print_err(pass, false);
+
+    TEST_MSG("preparing destination 127.0.0.1:%s...", strings.port);
+    _bal_eqland(pass, bal_dest_prepare("127.0.0.1", strings.port, &dests[0]));
+    _bal_eqland(pass, !bal_dest_prepare("127.0.0.1", NULL, &dests[1]));
+    _bal_print_err(pass, false);
+
+    char buf[8] = {0};
+    TEST_MSG_0("sending to the prepared destination...");
+    _bal_eqland(pass, 4 == bal_sendto_dest(tx, &dests[0], "ping", 4, 0));
+    _bal_eqland(pass, 4 == bal_recv(rx, buf, sizeof(buf), 0));
+    _bal_eqland(pass, 0 == memcmp(buf, "ping", 4));
+    _bal_print_err(pass, false);
+
+    TEST_MSG("fanning out to %zu destinations...", _bal_countof(dests));
+    for (size_t n = 1; n < _bal_countof(dests); n++)
+        dests[n] = dests[0];
+    _bal_eqland(pass, (ssize_t)_bal_countof(dests) ==
+        bal_sendto_dests(tx, dests, _bal_countof(dests), "fan", 3, 0));
+    size_t received = 0;
+    while (pass && received < _bal_countof(dests) && 3 == bal_recv(rx, buf, sizeof(buf), 0))
+        received++;
+    TEST_MSG("received %zu datagrams", received);
+    _bal_eqland(pass, _bal_countof(dests) == received);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != tx)
+        _bal_eqland(pass, bal_close(&tx, true));
+    if (NULL != rx)
+        _bal_eqland(pass, bal_close(&rx, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_uint_fast32_t _race_events;
+
+static void _race_callback(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    atomic_fetch_or(&_race_events, events & (BAL_EVT_CONNECT | BAL_EVT_CONNFAIL));
+}
+
+bool baltest_connect_race(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* r = NULL;
+    bal_socket* c = NULL;
+    bal_dest dests[3];
+    bal_addrlist al = {0};
+
+    atomic_store(&_race_events, 0U);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    /* a bound socket that isn't listening refuses connections. */
+    TEST_MSG_0("creating a loopback listener and a refusing socket...");
+    bal_addrstrings open = {0};
+    bal_addrstrings refused = {0};
+    _bal_eqland(pass, _bal_loopback_listener(&l, &open));
+    _bal_eqland(pass, bal_create(&r, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_bind(r, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_get_localhost_strings(r, false, &refused));
+    _bal_print_err(pass, false);
+
+    /* IPv6 first (as getaddrinfo usually orders them); it may not even be
+     * available here, which is just another way for an attempt to fail. */
+    _bal_eqland(pass, bal_dest_prepare("::1", refused.port, &dests[0]));
+    _bal_eqland(pass, bal_dest_prepare("127.0.0.1", refused.port, &dests[1]));
+    _bal_eqland(pass, bal_dest_prepare("127.0.0.1", open.port, &dests[2]));
+    for (size_t n = 0; n < _bal_countof(dests); n++)
+        al.addrs[al.count++] = dests[n].addr;
+    _bal_print_err(pass, false);
+
+    TEST_MSG("racing [::1]:%s, 127.0.0.1:%s and 127.0.0.1:%s...", refused.port,
+        refused.port, open.port);
+    _bal_eqland(pass, bal_create(&c, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, !bal_connect_race_addrlist(c, &al));
+    _bal_eqland(pass, bal_async_poll(c, &_race_callback, BAL_EVT_CLIENT));
+    _bal_eqland(pass, bal_connect_race_addrlist(c, &al));
+    _bal_eqland(pass, _wait_for_events(&_race_events, BAL_EVT_CONNECT));
+    _bal_print_err(pass, false);
+
+    bal_addrstrings peer = {0};
+    _bal_eqland(pass, bal_get_peer_strings(c, false, &peer));
+    TEST_MSG("connected to %s:%s", peer.addr, peer.port);
+    _bal_eqland(pass, 0 == strcmp(open.port, peer.port));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("racing only refusing addresses...");
+    atomic_store(&_race_events, 0U);
+    al.count = 2;
+    _bal_eqland(pass, bal_close(&c, true));
+    _bal_eqland(pass, bal_create(&c, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_async_poll(c, &_race_callback, BAL_EVT_CLIENT));
+    if (bal_connect_race_addrlist(c, &al))
+        _bal_eqland(pass, _wait_for_events(&_race_events, BAL_EVT_CONNFAIL));
+    _bal_eqland(pass, 0U == (atomic_load(&_race_events) & BAL_EVT_CONNECT));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != r)
+        _bal_eqland(pass, bal_close(&r, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_addrlist(void)
+{
+    bool pass = true;
+
+    for (size_t count = 1; count <= BAL_ADDRLIST_INLINE * 2; count++) {
+        TEST_MSG("enumerating a list of %zu address(es)...", count);
+
+        bal_addrlist al = {0};
+        _bal_eqland(pass, _bal_addrlist_alloc(&al, count));
+        _bal_eqland(pass, (count > BAL_ADDRLIST_INLINE) == (NULL != al.heap));
+        _bal_eqland(pass, count == bal_count_addrlist(&al));
+
+        for (size_t n = 0; pass && n < count; n++) {
+            struct sockaddr_in* sin = (struct sockaddr_in*)&_bal_addrlist_data(&al)[n];
+            sin->sin_family         = AF_INET;
+            sin->sin_port           = htons((uint16_t)n);
+        }
+
+        /* twice, since enumeration resets itself after the last address. */
+        for (size_t round = 0; round < 2; round++) {
+            size_t seen            = 0;
+            const bal_sockaddr* sa = NULL;
+            while (NULL != (sa = bal_enum_addrlist(&al))) {
+                _bal_eqland(pass, seen == ntohs(((const struct sockaddr_in*)sa)->sin_port));
+                seen++;
+            }
+            _bal_eqland(pass, count == seen);
+        }
+
+        _bal_eqland(pass, bal_free_addrlist(&al));
+        _bal_eqland(pass, NULL == al.heap && 0U == bal_count_addrlist(&al));
+        _bal_print_err(pass, false);
+    }
+
+    return pass;
+}
+
+static uint64_t _nsec_now(void)
+{
+    struct timespec ts = {0};
+    (void)timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+bool baltest_parse_addr(void)
+{
+    static const struct {
+        const char* host;
+        const char* port;
+        int fam;
+    } cases[] = {
+        {"127.0.0.1",       "80",    AF_INET},
+        {"0.0.0.0",         NULL,    AF_INET},
+        {"255.255.255.255", "65535", AF_INET},
+        {"::1",             "443",   AF_INET6},
+        {"fe80::1%1",       "0",     AF_INET6},
+        {"::ffff:10.0.0.1", "53",    AF_INET6},
+        {"256.0.0.1",       "80",    AF_UNSPEC},
+        {"1.2.3",           "80",    AF_UNSPEC},
+        {"01.2.3.4",        "80",    AF_UNSPEC},
+        {"1.2.3.4.5",       "80",    AF_UNSPEC},
+        {"localhost",       "80",    AF_UNSPEC},
+        {"127.0.0.1",       "http",  AF_UNSPEC},
+        {"127.0.0.1",       "65536", AF_UNSPEC},
+        {"::1%",            "80",    AF_UNSPEC},
+        {"1:2:3:4:5:6:7:8:9", "80",  AF_UNSPEC}
+    };
+
+    bool pass = true;
+
+    for (size_t n = 0; n < _bal_countof(cases); n++) {
+        bal_sockaddr sa = {0};
+        bool parsed     = bal_parse_addr(cases[n].host, cases[n].port, &sa);
+        TEST_MSG("'%s' port '%s': %s", cases[n].host, NULL != cases[n].port ?
+            cases[n].port : "(null)", parsed ? "parsed" : "rejected");
+        _bal_eqland(pass, (AF_UNSPEC != cases[n].fam) == parsed);
+        if (parsed) {
+            uint16_t port = AF_INET == sa.ss_family
+                ? ((struct sockaddr_in*)&sa)->sin_port
+                : ((struct sockaddr_in6*)&sa)->sin6_port;
+            _bal_eqland(pass, cases[n].fam == sa.ss_family);
+            _bal_eqland(pass, (NULL != cases[n].port ? atoi(cases[n].port) : 0) ==
+                ntohs(port));
+        }
+    }
+
+    bal_sockaddr sa = {0};
+    _bal_eqland(pass, bal_parse_addr("fe80::1%1", NULL, &sa));
+    _bal_eqland(pass, 1U == ((struct sockaddr_in6*)&sa)->sin6_scope_id);
+    _bal_print_err(pass, false);
+
+    /* microbenchmark: the literal parser vs. getaddrinfo(AI_NUMERICHOST). timings
+     * are informational only (debug builds and loaded machines skew them); the
+     * results must agree, though. */
+    const size_t iterations = 20000;
+    const char* hosts[]     = {"192.168.100.200", "2001:db8::8a2e:370:7334"};
+
+    for (size_t h = 0; h < _bal_countof(hosts); h++) {
+        struct addrinfo hints = {0};
+        hints.ai_flags        = AI_NUMERICHOST | AI_NUMERICSERV;
+        hints.ai_socktype     = SOCK_STREAM;
+
+        bal_sockaddr gai_sa = {0};
+        uint64_t start      = _nsec_now();
+        for (size_t n = 0; pass && n < iterations; n++) {
+            struct addrinfo* ai = NULL;
+            _bal_eqland(pass, 0 == getaddrinfo(hosts[h], "8080", &hints, &ai));
+            if (NULL != ai) {
+                memcpy(&gai_sa, ai->ai_addr, ai->ai_addrlen);
+                freeaddrinfo(ai);
+            }
+        }
+        uint64_t gai = _nsec_now() - start;
+
+        start = _nsec_now();
+        for (size_t n = 0; pass && n < iterations; n++)
+            _bal_eqland(pass, bal_parse_addr(hosts[h], "8080", &sa));
+        uint64_t parse = _nsec_now() - start;
+
+        TEST_MSG("%s: getaddrinfo %"PRIu64" ns/op, bal_parse_addr %"PRIu64" ns/op",
+            hosts[h], gai / iterations, parse / iterations);
+        _bal_eqland(pass, 0 == memcmp(&gai_sa, &sa, _BAL_SASIZE(sa)));
+        _bal_print_err(pass, false);
+    }
+
+    return pass;
+}
+
+bool baltest_format_addr(void)
+{
+    static const struct {
+        const char* host;
+        const char* port;
+        const char* expect;
+    } cases[] = {
+        {"127.0.0.1",       "80",    "127.0.0.1:80"},
+        {"0.0.0.0",         "0",     "0.0.0.0:0"},
+        {"255.255.255.255", "65535", "255.255.255.255:65535"},
+        {"::1",             "443",   "[::1]:443"},
+        {"fe80::1%7",       "8080",  "[fe80::1%7]:8080"},
+        {"2001:db8::1",     "53",    "[2001:db8::1]:53"}
+    };
+
+    bool pass = bal_init();
+
+    for (size_t n = 0; n < _bal_countof(cases); n++) {
+        bal_sockaddr sa          = {0};
+        char buf[BAL_ADDRSTRLEN] = {0};
+        _bal_eqland(pass, bal_parse_addr(cases[n].host, cases[n].port, &sa));
+        size_t len = bal_format_addr(&sa, buf, sizeof(buf));
+        TEST_MSG("'%s' port '%s' -> '%s'", cases[n].host, cases[n].port, buf);
+        _bal_eqland(pass, strlen(cases[n].expect) == len);
+        _bal_eqland(pass, 0 == strcmp(cases[n].expect, buf));
+
+        /* every buffer short of the full length must be rejected. */
+        for (size_t size = 0; size <= len; size++) {
+            char small[BAL_ADDRSTRLEN];
+            memset(small, 'x', sizeof(small));
+            _bal_eqland(pass, 0U == bal_format_addr(&sa, small, size));
+            _bal_eqland(pass, 0U == size || '\0' == small[0]);
+        }
+        _bal_print_err(pass, false);
+
+        /* bal_get_addrstrings must agree with getnameinfo. */
+        bal_addrstrings strings = {0};
+        char host[NI_MAXHOST]   = {0};
+        char port[NI_MAXSERV]   = {0};
+        _bal_eqland(pass, bal_get_addrstrings(&sa, false, &strings));
+        _bal_eqland(pass, 0 == getnameinfo((const struct sockaddr*)&sa, _BAL_SASIZE(sa),
+            host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV));
+        TEST_MSG("addrstrings: '%s' '%s', getnameinfo: '%s' '%s'", strings.addr,
+            strings.port, host, port);
+        _bal_eqland(pass, 0 == strcmp(port, strings.port));
+        if (NULL == strchr(host, '%'))
+            _bal_eqland(pass, 0 == strcmp(host, strings.addr));
+        _bal_print_err(pass, false);
+    }
+
+    bal_sockaddr sa          = {0};
+    char buf[BAL_ADDRSTRLEN] = {0};
+    _bal_eqland(pass, 0U == bal_format_addr(&sa, buf, sizeof(buf)));
+
+    /* reverse lookups of the same address are answered by the cache. */
+    bal_cache_stats stats   = {0};
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, bal_set_rdns_cache(BAL_RDNSCACHE_MAXENTRIES, BAL_RDNSCACHE_TTL,
+        BAL_RDNSCACHE_NEGTTL));
+    _bal_eqland(pass, bal_parse_addr("127.0.0.1", "1234", &sa));
+
+    for (int n = 0; n < 3; n++) {
+        _bal_eqland(pass, bal_get_addrstrings(&sa, true, &strings));
+        TEST_MSG("reverse lookup: '%s'", strings.host);
+        _bal_eqland(pass, '\0' != strings.host[0]);
+    }
+
+    _bal_eqland(pass, bal_get_rdns_cache_stats(&stats));
+    TEST_MSG("rdns cache: %"PRIu64" hits, %"PRIu64" negative, %"PRIu64" misses",
+        stats.hits, stats.negative_hits, stats.misses);
+    _bal_eqland(pass, 1U == stats.misses && 2U == stats.hits + stats.negative_hits);
+
+    _bal_eqland(pass, bal_flush_rdns_cache());
+    _bal_eqland(pass, bal_get_rdns_cache_stats(&stats));
+    _bal_eqland(pass, 0U == stats.entries);
+    _bal_print_err(pass, false);
+
+    _bal_eqland(pass, bal_cleanup());
+
+    return pass;
+}
+
+bool baltest_error_lazy(void)
+{
+    bool pass = bal_init();
+
+    /* the OS message is produced when the error is retrieved, and must match
+     * what the platform reports for the code. */
+    bal_error err = {0};
+    (void)_bal_handleerr(_BAL_ECONNREFUSED);
+    _bal_eqland(pass, BAL_E_PLATFORM == bal_get_error_ext(&err));
+    TEST_MSG("ECONNREFUSED [ext] = %s", err.message);
+#if !defined(__WIN__)
+    _bal_eqland(pass, NULL != strstr(err.message, strerror(ECONNREFUSED)));
+#endif
+    _bal_eqland(pass, NULL == strchr(err.message, '/'));
+
+    (void)_bal_handlegaierr(EAI_NONAME);
+    _bal_eqland(pass, BAL_E_PLATFORM == bal_get_error(&err));
+    TEST_MSG("EAI_NONAME = %s", err.message);
+    _bal_eqland(pass, NULL != strstr(err.message, gai_strerror(EAI_NONAME)));
+    _bal_print_err(pass, false);
+
+    /* would-block results are left in errno and do not disturb the error state. */
+    bal_socket* s = NULL;
+    _bal_eqland(pass, bal_create(&s, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_bind(s, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_set_io_mode(s, true));
+
+    char buf[16];
+    (void)_bal_seterror(_BAL_E_INVALIDARG);
+    _bal_eqland(pass, -1 == bal_recv(s, buf, sizeof(buf), 0));
+    _bal_eqland(pass, _bal_wouldblock(_bal_lasterror()));
+    _bal_eqland(pass, BAL_E_INVALIDARG == bal_get_error(&err));
+    _bal_eqland(pass, -1 == bal_recvfrom(s, buf, sizeof(buf), 0, NULL));
+    _bal_eqland(pass, _bal_wouldblock(_bal_lasterror()));
+    _bal_eqland(pass, BAL_E_INVALIDARG == bal_get_error(&err));
+    _bal_print_err(pass, false);
+
+    _bal_eqland(pass, bal_close(&s, true));
+    _bal_eqland(pass, bal_cleanup());
+
+    return pass;
+}
+
+bool baltest_try_io(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating a nonblocking loopback connection...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_set_io_mode(a, true));
+    _bal_eqland(pass, bal_set_io_mode(c, true));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("nothing to read: would-block, error state untouched...");
+    char buf[4096] = {0};
+    bal_error err  = {0};
+    (void)_bal_seterror(_BAL_E_INVALIDARG);
+    bal_io_result res = bal_try_recv(c, buf, sizeof(buf), 0);
+    _bal_eqland(pass, BAL_IO_WOULDBLOCK == res.status && 0U == res.bytes);
+    _bal_eqland(pass, BAL_E_INVALIDARG == bal_get_error(&err));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("send and receive...");
+    res = bal_try_send(a, "hello", 5, 0);
+    _bal_eqland(pass, BAL_IO_OK == res.status && 5U == res.bytes);
+    for (int n = 0; pass && n < 200; n++) {
+        res = bal_try_recv(c, buf, sizeof(buf), 0);
+        if (BAL_IO_WOULDBLOCK != res.status)
+            break;
+        bal_sleep_msec(10);
+    }
+    _bal_eqland(pass, BAL_IO_OK == res.status && 5U == res.bytes);
+    _bal_eqland(pass, 0 == memcmp(buf, "hello", 5));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("filling the send buffer until it would block...");
+    size_t total = 0U;
+    for (size_t n = 0; pass && n < 64U * 1024U; n++) {
+        res = bal_try_send(a, buf, sizeof(buf), 0);
+        total += res.bytes;
+        if (BAL_IO_OK != res.status && BAL_IO_PARTIAL != res.status)
+            break;
+    }
+    TEST_MSG("sent %zu bytes before status %d", total, res.status);
+    _bal_eqland(pass, BAL_IO_WOULDBLOCK == res.status && 0U == res.bytes);
+    _bal_eqland(pass, BAL_E_INVALIDARG == bal_get_error(&err));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing the sender; draining until end of stream...");
+    _bal_eqland(pass, bal_close(&a, true));
+    size_t drained = 0U;
+    for (int idle = 0; pass && idle < 200;) {
+        res = bal_try_recv(c, buf, sizeof(buf), 0);
+        if (BAL_IO_OK == res.status) {
+            drained += res.bytes;
+        } else if (BAL_IO_WOULDBLOCK == res.status) {
+            bal_sleep_msec(10);
+            idle++;
+        } else {
+            break;
+        }
+    }
+    TEST_MSG("drained %zu bytes, then status %d", drained, res.status);
+    _bal_eqland(pass, BAL_IO_EOF == res.status && drained == total);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("invalid arguments are errors...");
+    res = bal_try_recv(c, NULL, sizeof(buf), 0);
+    _bal_eqland(pass, BAL_IO_ERROR == res.status);
+    _bal_eqland(pass, BAL_E_NULLPTR == bal_get_error(&err));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+#if defined(__HAVE_ASYNC_DBGLOG__)
+static bool _dbglog_roundtrip(const char* format, ...)
+{
+    char expect[BAL_DBGLOG_MAXMSG] = {0};
+    char actual[BAL_DBGLOG_MAXMSG] = {0};
+    bal_log_record rec = {0};
+
+    va_list args;
+    va_start(args, format);
+    va_list args2;
+    va_copy(args2, args);
+    (void)vsnprintf(expect, sizeof(expect), format, args);
+    bool captured = _bal_log_capture(&rec, format, args2);
+    va_end(args2);
+    va_end(args);
+
+    if (captured)
+        (void)_bal_log_format(&rec, actual, sizeof(actual));
+
+    TEST_MSG("'%s' -> '%s' (%s)", format, actual, captured ? "captured" : "not captured");
+    return captured && 0 == strcmp(expect, actual);
+}
+#endif
+
+bool baltest_dbglog_async(void)
+{
+#if defined(__HAVE_ASYNC_DBGLOG__)
+    bool pass = true;
+
+    TEST_MSG_0("capturing arguments and formatting them later...");
+    _bal_eqland(pass, _dbglog_roundtrip("plain text, no arguments"));
+    _bal_eqland(pass, _dbglog_roundtrip("%d %i %u %x %X %o %c %%", -42, 7, 42U, 0xbeefU,
+        0xcafeU, 8U, 'z'));
+    _bal_eqland(pass, _dbglog_roundtrip("%hd %hhu %hx %hhx %ld %lu %lld %llx", (short)-3,
+        (unsigned char)200, (unsigned short)-1, (unsigned char)-1, -123456789L,
+        123456789UL, -1234567890123LL, 0xfeedfaceULL));
+    _bal_eqland(pass, _dbglog_roundtrip("%zu %zd %jd %td", (size_t)99, (ssize_t)-99,
+        (intmax_t)-7, (ptrdiff_t)5));
+    _bal_eqland(pass, _dbglog_roundtrip("%"PRIu64" %"PRIx32" %08"PRIx32" [%-6d] [%+5d]",
+        UINT64_MAX, 0x1234U, 0xabU, 12, 34));
+    _bal_eqland(pass, _dbglog_roundtrip("%s and %s (%.3s) [%8s] %s", "one", "two",
+        "truncated", "pad", (const char*)NULL));
+    _bal_eqland(pass, _dbglog_roundtrip("%.2f %e %g %p", 3.14159, 1e10, 0.5,
+        (void*)&pass));
+    _bal_eqland(pass, !_dbglog_roundtrip("%*d", 5, 1));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("logging through the ring...");
+    uint64_t written = 0U;
+    uint64_t dropped = 0U;
+    _bal_log_flush();
+    _bal_log_get_stats(&written, &dropped);
+
+    uint64_t before = written + dropped;
+    for (int n = 0; n < 16; n++)
+        _bal_dbglog("dbglog-async message %d of %d (%s)", n + 1, 16, "test");
+
+    _bal_log_flush();
+    _bal_log_get_stats(&written, &dropped);
+    TEST_MSG("%"PRIu64" written, %"PRIu64" dropped", written, dropped);
+    _bal_eqland(pass, written + dropped >= before + 16U);
+    _bal_print_err(pass, false);
+
+    return pass;
+#else
+    TEST_MSG_0("asynchronous debug logging is not enabled in this build");
+    return true;
+#endif
+}
+
+#if defined(__HAVE_BAL_TRACE__)
+static atomic_bool _trace_read;
+
+static void _trace_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[16] = {0};
+        if (bal_recv(s, buf, sizeof(buf), 0) > 0)
+            atomic_store(&_trace_read, true);
+    }
+}
+#endif
+
+bool baltest_trace(void)
+{
+    static const char* path = "baltests-trace.json";
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+#if !defined(__HAVE_BAL_TRACE__)
+    TEST_MSG_0("tracing is not enabled in this build; dumping should fail...");
+    bal_error err = {0};
+    _bal_eqland(pass, !bal_trace_dump(path));
+    _bal_eqland(pass, BAL_E_UNAVAIL == bal_get_error(&err));
+    _bal_print_err(pass, false);
+#else
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+
+    atomic_store(&_trace_read, false);
+
+    TEST_MSG_0("connecting, accepting and reading asynchronously...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_async_poll(a, &_trace_callback, BAL_EVT_NORMAL));
+    _bal_eqland(pass, 4 == bal_send(c, "ping", 4, 0));
+    for (int n = 0; pass && n < 100 && !atomic_load(&_trace_read); n++)
+        bal_sleep_msec(20);
+    _bal_eqland(pass, atomic_load(&_trace_read));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG("dumping the trace to %s...", path);
+    _bal_eqland(pass, bal_trace_dump(path));
+    _bal_print_err(pass, false);
+
+    static char json[1024 * 1024];
+    size_t len = 0U;
+    FILE* in   = fopen(path, "r");
+    _bal_eqland(pass, NULL != in);
+    if (NULL != in) {
+        len = fread(json, 1, sizeof(json) - 1, in);
+        (void)fclose(in);
+    }
+    json[len] = '\0';
+    (void)remove(path);
+    TEST_MSG("read %zu bytes of JSON", len);
+
+    static const char* expected[] = {
+        "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[",
+        "\"args\":{\"name\":\"bal event thread\"}",
+        "\"name\":\"poll\"",
+        "\"name\":\"dispatch\"",
+        "\"name\":\"callback\"",
+        "\"name\":\"accept\"",
+        "\"name\":\"connect\"",
+        "\"name\":\"close\"",
+        "\n]}\n"
+    };
+    for (size_t n = 0; n < sizeof(expected) / sizeof(expected[0]); n++) {
+        bool found = NULL != strstr(json, expected[n]);
+        TEST_MSG("%s: %s", expected[n], found ? "found" : "missing");
+        _bal_eqland(pass, found);
+    }
+#endif
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_bool _stats_read;
+
+static void _stats_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[16] = {0};
+        if (bal_recv(s, buf, sizeof(buf), 0) > 0)
+            atomic_store(&_stats_read, true);
+    }
+}
+
+bool baltest_stats(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+    bal_stats before = {0};
+    bal_stats after  = {0};
+
+    atomic_store(&_stats_read, false);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_eqland(pass, bal_get_stats(&before));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting, and reading asynchronously...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_set_io_mode(c, true));
+    _bal_eqland(pass, bal_async_poll(a, &_stats_callback, BAL_EVT_NORMAL));
+    _bal_eqland(pass, 4 == bal_send(c, "ping", 4, 0));
+    _bal_eqland(pass, 4 == bal_send(c, "pong", 4, 0));
+    for (int n = 0; pass && n < 100 && !atomic_load(&_stats_read); n++)
+        bal_sleep_msec(20);
+    _bal_eqland(pass, atomic_load(&_stats_read));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("nothing to read on the client: would-block...");
+    char buf[16] = {0};
+    bal_io_result res = bal_try_recv(c, buf, sizeof(buf), 0);
+    _bal_eqland(pass, BAL_IO_WOULDBLOCK == res.status);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking per-socket statistics...");
+    bal_socket_stats cs = {0};
+    bal_socket_stats as = {0};
+    _bal_eqland(pass, bal_get_socket_stats(c, &cs));
+    _bal_eqland(pass, bal_get_socket_stats(a, &as));
+    TEST_MSG("client: %"PRIu64" send(s), %"PRIu64" byte(s), %"PRIu64" recv would-block",
+        cs.sends, cs.bytes_sent, cs.recv_wouldblock);
+    TEST_MSG("server: %"PRIu64" recv(s), %"PRIu64" byte(s), %"PRIu64" event(s)",
+        as.recvs, as.bytes_recv, as.events);
+    _bal_eqland(pass, 2U == cs.sends && 8U == cs.bytes_sent);
+    _bal_eqland(pass, 1U == cs.recv_wouldblock && 0U == cs.recvs);
+    _bal_eqland(pass, as.recvs >= 1U && as.bytes_recv >= 4U && as.events >= 1U);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking library-wide statistics...");
+    _bal_eqland(pass, bal_get_stats(&after));
+    TEST_MSG("%"PRIu64" socket(s), %"PRIu64" poll(s) (%"PRIu64" nsec), %"PRIu64
+        " callback(s) (%"PRIu64" nsec), %"PRIu64" read event(s), %"PRIu64
+        " allocation(s) (%"PRIu64" bytes)", after.sockets, after.polls, after.poll_nsec,
+        after.callbacks, after.callback_nsec, after.events[0], after.allocs,
+        after.alloc_bytes);
+    _bal_eqland(pass, 1U == after.sockets);
+    _bal_eqland(pass, after.polls > before.polls);
+    _bal_eqland(pass, after.callbacks > before.callbacks);
+    _bal_eqland(pass, after.events[0] > before.events[0]);
+    _bal_eqland(pass, after.allocs > before.allocs && after.alloc_bytes > before.alloc_bytes);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+    _bal_eqland(pass, bal_get_stats(&after) && 0U == after.sockets);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_bool _watchdog_read;
+static atomic_uint_fast32_t _watchdog_slow;
+static atomic_uint_fast32_t _watchdog_events;
+static bal_descriptor _watchdog_sd;
+
+static void _watchdog_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[16] = {0};
+        if (bal_recv(s, buf, sizeof(buf), 0) > 0) {
+            bal_sleep_msec(20);
+            atomic_store(&_watchdog_read, true);
+        }
+    }
+}
+
+static void _watchdog_hook(bal_descriptor sd, uint32_t events, uint64_t nsec, void* ctx)
+{
+    BAL_UNUSED(ctx);
+    TEST_MSG("slow callback: socket "BAL_SOCKET_SPEC", events %08"PRIx32", %"PRIu64
+        " nsec", sd, events, nsec);
+    if (sd == _watchdog_sd && nsec >= 20000000U) {
+        atomic_store(&_watchdog_events, events);
+        atomic_fetch_add(&_watchdog_slow, 1);
+    }
+}
+
+bool baltest_callback_watchdog(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+    bal_histogram* hist = calloc(1, sizeof(bal_histogram));
+    bal_histogram* lag  = calloc(1, sizeof(bal_histogram));
+
+    atomic_store(&_watchdog_read, false);
+    atomic_store(&_watchdog_slow, 0);
+    atomic_store(&_watchdog_events, 0);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = NULL != hist && NULL != lag && bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("histogram buckets are contiguous and increasing...");
+    for (size_t n = 1; pass && n < BAL_HIST_BUCKETS; n++)
+        _bal_eqland(pass, bal_histogram_bucket_min(n) > bal_histogram_bucket_min(n - 1));
+    _bal_eqland(pass, 1024U == bal_histogram_bucket_min(64));
+    _bal_eqland(pass, !bal_get_histogram(BAL_HIST_COUNT, hist));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("setting a 5 msec callback budget...");
+    _bal_eqland(pass, bal_set_callback_budget(5000000U, &_watchdog_hook, NULL));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("reading with a callback that takes 20 msec...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    if (NULL != a)
+        _watchdog_sd = a->sd;
+    _bal_eqland(pass, bal_async_poll(a, &_watchdog_callback, BAL_EVT_NORMAL));
+    _bal_eqland(pass, 4 == bal_send(c, "ping", 4, 0));
+    for (int n = 0; pass && n < 100 && 0 == atomic_load(&_watchdog_slow); n++)
+        bal_sleep_msec(20);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("the hook reported it...");
+    _bal_eqland(pass, 1 == atomic_load(&_watchdog_slow));
+    _bal_eqland(pass, bal_isbitset((uint32_t)atomic_load(&_watchdog_events), BAL_EVT_READ));
+    bal_stats stats = {0};
+    _bal_eqland(pass, bal_get_stats(&stats) && stats.slow_callbacks >= 1U);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("callback durations are in the histogram...");
+    _bal_eqland(pass, bal_get_histogram(BAL_HIST_CALLBACK, hist));
+    uint64_t p50  = bal_histogram_percentile(hist, 50.0);
+    uint64_t p100 = bal_histogram_percentile(hist, 100.0);
+    TEST_MSG("%"PRIu64" callback(s): p50 = %"PRIu64" nsec, max = %"PRIu64" nsec",
+        hist->total, p50, p100);
+    _bal_eqland(pass, hist->total >= 1U && p100 == hist->max && p100 >= 20000000U);
+    _bal_eqland(pass, p50 <= p100);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("waiting for poll to time out, for loop lag...");
+    uint64_t before = 0U;
+    if (bal_get_histogram(BAL_HIST_LOOPLAG, lag))
+        before = lag->total;
+    for (int n = 0; pass && n < 150 && lag->total <= before; n++) {
+        bal_sleep_msec(20);
+        _bal_eqland(pass, bal_get_histogram(BAL_HIST_LOOPLAG, lag));
+    }
+    TEST_MSG("%"PRIu64" timeout(s): p99 lag = %"PRIu64" nsec", lag->total,
+        bal_histogram_percentile(lag, 99.0));
+    _bal_eqland(pass, lag->total > before);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    _bal_eqland(pass, bal_set_callback_budget(0U, NULL, NULL));
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    free(hist);
+    free(lag);
+    return pass;
+}
+
+#if defined(__HAVE_BAL_LOCKPROF__)
+static const bal_lock_stats* _find_lock_site(const bal_lock_stats* stats, size_t count,
+    const char* site)
+{
+    for (size_t n = 0; n < count; n++) {
+        if (0 == strcmp(stats[n].site, site))
+            return &stats[n];
+    }
+    return NULL;
+}
+#endif
+
+bool baltest_lock_profiler(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+#if !defined(__HAVE_BAL_LOCKPROF__)
+    TEST_MSG_0("lock profiling is not enabled in this build; querying should fail...");
+    bal_error err = {0};
+    size_t none   = 0;
+    _bal_eqland(pass, !bal_get_lock_stats(NULL, &none));
+    _bal_eqland(pass, BAL_E_UNAVAIL == bal_get_error(&err));
+    _bal_print_err(pass, false);
+#else
+    bal_socket* l = NULL;
+
+    TEST_MSG_0("listening asynchronously...");
+    _bal_eqland(pass, bal_reset_lock_stats());
+    _bal_eqland(pass, _bal_loopback_listener(&l, NULL));
+    _bal_eqland(pass, bal_async_poll(l, &_stats_callback, BAL_EVT_NORMAL));
+    bal_sleep_msec(250);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("counting lock sites...");
+    size_t count = 0;
+    _bal_eqland(pass, bal_get_lock_stats(NULL, &count));
+    TEST_MSG("%zu lock site(s)", count);
+    _bal_eqland(pass, count >= 2U);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking lock site statistics...");
+    bal_lock_stats* stats = calloc(count, sizeof(bal_lock_stats));
+    _bal_eqland(pass, NULL != stats);
+    if (NULL != stats)
+        _bal_eqland(pass, bal_get_lock_stats(stats, &count));
+    for (size_t n = 0; pass && n < count; n++) {
+        TEST_MSG("%s: %"PRIu64" acquisition(s), waited %"PRIu64" nsec (max %"PRIu64
+            "), held %"PRIu64" nsec (max %"PRIu64")", stats[n].site, stats[n].acquisitions,
+            stats[n].wait_nsec, stats[n].max_wait_nsec, stats[n].hold_nsec,
+            stats[n].max_hold_nsec);
+        _bal_eqland(pass, stats[n].max_wait_nsec <= stats[n].wait_nsec);
+        _bal_eqland(pass, stats[n].max_hold_nsec <= stats[n].hold_nsec);
+    }
+    const bal_lock_stats* evt = pass ? _find_lock_site(stats, count, "eventthread") : NULL;
+    const bal_lock_stats* asp = pass ? _find_lock_site(stats, count, "aspoll") : NULL;
+    _bal_eqland(pass, NULL != evt && evt->acquisitions >= 1U && evt->hold_nsec > 0U);
+    _bal_eqland(pass, NULL != asp && 1U == asp->acquisitions);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying socket...");
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("resetting lock site statistics...");
+    _bal_eqland(pass, bal_reset_lock_stats());
+    _bal_eqland(pass, bal_get_lock_stats(stats, &count));
+    asp = pass ? _find_lock_site(stats, count, "aspoll") : NULL;
+    _bal_eqland(pass, NULL != asp && 0U == asp->acquisitions && 0U == asp->hold_nsec);
+    _bal_print_err(pass, false);
+
+    free(stats);
+#endif
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_arena(void)
+{
+    bal_socket* s = NULL;
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("allocating from a socket's arena...");
+    _bal_eqland(pass, bal_create(&s, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_arena(s, 256));
+    uint8_t* first = pass ? bal_arena_alloc(s, 3) : NULL;
+    uint8_t* second = pass ? bal_arena_alloc(s, 40) : NULL;
+    _bal_eqland(pass, NULL != first && NULL != second);
+    _bal_eqland(pass, 0U == ((uintptr_t)first % BAL_ARENA_ALIGN));
+    _bal_eqland(pass, second == first + BAL_ARENA_ALIGN);
+    if (pass)
+        memset(second, 0xab, 40);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("filling more than one chunk, and one oversized allocation...");
+    for (int n = 0; pass && n < 64; n++) {
+        uint8_t* p = bal_arena_alloc(s, 24);
+        _bal_eqland(pass, NULL != p && 0U == ((uintptr_t)p % BAL_ARENA_ALIGN));
+    }
+    uint8_t* big = pass ? bal_arena_alloc(s, 4096) : NULL;
+    _bal_eqland(pass, NULL != big);
+    if (NULL != big)
+        memset(big, 0xcd, 4096);
+    _bal_eqland(pass, NULL == bal_arena_alloc(s, 0));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("resetting: a regular chunk is kept for reuse...");
+    _bal_eqland(pass, bal_arena_reset(s));
+    uint8_t* again = pass ? bal_arena_alloc(s, 8) : NULL;
+    _bal_eqland(pass, NULL != again);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying socket (frees the arena)...");
+    if (NULL != s)
+        _bal_eqland(pass, bal_close(&s, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_uintptr_t _pool_socket;
+static atomic_uint_fast32_t _pool_events;
+
+static void _pool_callback(bal_socket* s, void* ctx)
+{
+    BAL_UNUSED(ctx);
+    atomic_store(&_pool_socket, (uintptr_t)s);
+    atomic_fetch_or(&_pool_events, NULL != s ? 1U : 2U);
+}
+
+bool baltest_connection_pool(void)
+{
+    bal_socket* l        = NULL;
+    bal_socket* p        = NULL;
+    bal_socket* a        = NULL;
+    bal_socket* b        = NULL;
+    bal_socket* c        = NULL;
+    bal_pool* pool       = NULL;
+    bal_pool_stats stats = {0};
+    bal_sockaddr addr    = {0};
+    bal_error err        = {0};
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener...");
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, _bal_loopback_listener(&l, &strings));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating a pool (1 idle, 2 in total per destination)...");
+    bal_pool_cfg cfg = {.max_idle = 1, .max_total = 2};
+    _bal_eqland(pass, bal_pool_create(&pool, &cfg));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking a connection out, in, and out again...");
+    _bal_eqland(pass, bal_pool_checkout(pool, "127.0.0.1", strings.port, &a));
+    _bal_eqland(pass, bal_accept(l, &p, &addr));
+    const bal_socket* first = a;
+    _bal_eqland(pass, bal_pool_checkin(&a, true) && NULL == a);
+    _bal_eqland(pass, bal_pool_checkout(pool, "127.0.0.1", strings.port, &a));
+    _bal_eqland(pass, NULL != a && first == a);
+    _bal_eqland(pass, bal_pool_get_stats(pool, &stats));
+    _bal_eqland(pass, 1U == stats.created && 1U == stats.reused && 1U == stats.busy);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("discarding an idle connection closed by its peer...");
+    _bal_eqland(pass, bal_pool_checkin(&a, true));
+    if (NULL != p)
+        _bal_eqland(pass, bal_close(&p, true));
+    bal_sleep_msec(50);
+    _bal_eqland(pass, bal_pool_checkout(pool, "127.0.0.1", strings.port, &a));
+    _bal_eqland(pass, bal_pool_get_stats(pool, &stats));
+    _bal_eqland(pass, 1U == stats.stale && 2U == stats.created);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("exceeding the limit...");
+    _bal_eqland(pass, bal_pool_checkout(pool, "127.0.0.1", strings.port, &b));
+    _bal_eqland(pass, !bal_pool_checkout(pool, "127.0.0.1", strings.port, &c));
+    _bal_eqland(pass, BAL_E_POOLFULL == bal_get_error(&err));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("waiting for a connection to be checked in...");
+    atomic_store(&_pool_events, 0U);
+    _bal_eqland(pass, bal_pool_checkout_async(pool, "127.0.0.1", strings.port,
+        &_pool_callback, NULL));
+    _bal_eqland(pass, bal_pool_get_stats(pool, &stats));
+    _bal_eqland(pass, 1U == stats.waits);
+    const bal_socket* handed = b;
+    _bal_eqland(pass, bal_pool_checkin(&b, true));
+    _bal_eqland(pass, _wait_for_events(&_pool_events, 1U));
+    b = (bal_socket*)atomic_load(&_pool_socket);
+    _bal_eqland(pass, NULL != b && handed == b);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("opening a connection asynchronously...");
+    _bal_eqland(pass, bal_pool_checkin(&b, false));
+    atomic_store(&_pool_events, 0U);
+    _bal_eqland(pass, bal_pool_checkout_async(pool, "127.0.0.1", strings.port,
+        &_pool_callback, NULL));
+    _bal_eqland(pass, _wait_for_events(&_pool_events, 1U));
+    b = (bal_socket*)atomic_load(&_pool_socket);
+    _bal_eqland(pass, NULL != b && bal_get_peer_addr(b, &addr));
+    _bal_eqland(pass, bal_pool_get_stats(pool, &stats));
+    _bal_eqland(pass, 4U == stats.created && 2U == stats.busy);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking both in (one is kept) and destroying the pool...");
+    _bal_eqland(pass, bal_pool_checkin(&a, true));
+    _bal_eqland(pass, bal_pool_checkin(&b, true));
+    _bal_eqland(pass, bal_pool_get_stats(pool, &stats));
+    _bal_eqland(pass, 1U == stats.idle && 0U == stats.busy);
+    _bal_eqland(pass, bal_pool_destroy(&pool) && NULL == pool);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying listener...");
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static atomic_bool _coalesce_backlog;
+
+static void _coalesce_backlog_callback(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[16] = {0};
+        if (bal_recv(s, buf, sizeof(buf), 0) > 0) {
+            /* the peer isn't reading; keep sending until the coalescer pushes
+             * back, at which point part of it is still buffered. */
+            char chunk[1024];
+            memset(chunk, 'x', sizeof(chunk));
+            for (int n = 0; n < 65536; n++) {
+                if ((ssize_t)sizeof(chunk) != bal_send(s, chunk, sizeof(chunk), 0))
+                    break;
+            }
+            atomic_store(&_coalesce_backlog, true);
+        }
+    }
+}
+
+bool baltest_coalesce_close(void)
+{
+    bal_socket* l  = NULL;
+    bal_socket* c  = NULL;
+    bal_socket* a  = NULL;
+    bal_socket* u  = NULL;
+    bal_socket* c2 = NULL;
+    bal_socket* a2 = NULL;
+
+    atomic_store(&_coalesce_backlog, false);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener and client...");
+    bal_addrstrings strings = {0};
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, &strings));
+    _bal_eqland(pass, bal_set_sendbuf_size(a, 4096));
+    _bal_print_err(pass, false);
+
+    /* keeps the event loop (and its flushing) going once `a` is gone. */
+    TEST_MSG_0("registering an idle UDP socket...");
+    _bal_eqland(pass, bal_create(&u, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_bind(u, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_async_poll(u, &_bal_async_poll_callback, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("coalescing more than the peer will take...");
+    _bal_eqland(pass, bal_set_coalescing(a, true));
+    _bal_eqland(pass, bal_async_poll(a, &_coalesce_backlog_callback, BAL_EVT_NORMAL));
+    _bal_eqland(pass, 2 == bal_send(c, "go", 2, 0));
+    for (int n = 0; pass && n < 150 && !atomic_load(&_coalesce_backlog); n++)
+        bal_sleep_msec(20);
+    _bal_eqland(pass, atomic_load(&_coalesce_backlog));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing (without destroying) while data is still queued...");
+    bal_descriptor old_sd = NULL != a ? a->sd : BAL_BADSOCKET;
+    _bal_eqland(pass, bal_async_poll(a, NULL, 0U));
+    _bal_eqland(pass, bal_close(&a, false));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting again, most likely on the same descriptor...");
+    _bal_eqland(pass, bal_create(&c2, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(c2, "127.0.0.1", strings.port));
+    bal_sockaddr peer = {0};
+    _bal_eqland(pass, bal_accept(l, &a2, &peer));
+    if (NULL != c2)
+        TEST_MSG("old descriptor: " BAL_SOCKET_SPEC ", new: " BAL_SOCKET_SPEC, old_sd,
+            c2->sd);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("nothing left over should arrive on the new connection...");
+    bal_sleep_msec(1000);
+    _bal_eqland(pass, 0U == bal_get_recvqueue_size(a2));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        bal_destroy(&a);
+    if (NULL != a2)
+        _bal_eqland(pass, bal_close(&a2, true));
+    if (NULL != c2)
+        _bal_eqland(pass, bal_close(&c2, true));
+    if (NULL != u)
+        _bal_eqland(pass, bal_close(&u, true));
+    if (NULL != c)
+        _bal_eqland(pass, bal_close(&c, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_coalesce_error(void)
+{
+    bal_socket* l = NULL;
+    bal_socket* c = NULL;
+    bal_socket* a = NULL;
+    bal_socket* u = NULL;
+
+    atomic_store(&_coalesce_backlog, false);
+
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating loopback listener and client...");
+    _bal_eqland(pass, _bal_loopback_pair(&l, &c, &a, NULL));
+    _bal_eqland(pass, bal_set_sendbuf_size(a, 4096));
+    _bal_print_err(pass, false);
+
+    /* keeps the event loop (and its flushing) going once `a` is deregistered. */
+    TEST_MSG_0("registering an idle UDP socket...");
+    _bal_eqland(pass, bal_create(&u, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_bind(u, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_async_poll(u, &_bal_async_poll_callback, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("coalescing more than the peer will take...");
+    _bal_eqland(pass, bal_set_coalescing(a, true));
+    _bal_eqland(pass, bal_async_poll(a, &_coalesce_backlog_callback, BAL_EVT_NORMAL));
+    _bal_eqland(pass, 2 == bal_send(c, "go", 2, 0));
+    for (int n = 0; pass && n < 150 && !atomic_load(&_coalesce_backlog); n++)
+        bal_sleep_msec(20);
+    _bal_eqland(pass, atomic_load(&_coalesce_backlog));
+    _bal_eqland(pass, bal_async_poll(a, NULL, 0U));
+    _bal_print_err(pass, false);
+
+    /* closing with unread data resets the connection. */
+    TEST_MSG_0("resetting the peer; the pending flush should fail...");
+    _bal_eqland(pass, bal_close(&c, true));
+    bal_sleep_msec(1000);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("the next send should report the failure, not that it would block...");
+    /* a stale would-block error must not decide the outcome. */
+#if defined(__WIN__)
+    WSASetLastError(WSAEWOULDBLOCK);
+#else
+    errno = EAGAIN;
+#endif
+    bal_io_result res = bal_try_send(a, "x", 1, 0);
+    TEST_MSG("status: %d", (int)res.status);
+    _bal_eqland(pass, BAL_IO_ERROR == res.status);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != a)
+        _bal_eqland(pass, bal_close(&a, true));
+    if (NULL != u)
+        _bal_eqland(pass, bal_close(&u, true));
+    if (NULL != l)
+        _bal_eqland(pass, bal_close(&l, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
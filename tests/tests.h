@@ -52,4 +52,162 @@ bool baltest_create_bind_listen_tcp(void);
  */
 bool baltest_error_sanity(void);
 
+/**
+ * @test baltest_framing_delim
+ * Ensures that a socket configured for delimiter framing over loopback TCP
+ * receives exactly one read event per complete frame, regardless of how the
+ * frames were split across sends.
+ */
+bool baltest_framing_delim(void);
+
+/**
+ * @test baltest_write_coalescing
+ * Ensures that several sends made by a callback on a coalescing socket arrive
+ * intact and in order once the event loop flushes them.
+ */
+bool baltest_write_coalescing(void);
+
+/**
+ * @test baltest_watermarks
+ * Ensures that filling a socket's send queue against a peer that isn't reading
+ * raises BAL_EVT_WRITE_HIGH (pausing reads), and that draining it raises
+ * BAL_EVT_WRITE_LOW (resuming them).
+ */
+bool baltest_watermarks(void);
+
+/**
+ * @test baltest_timestamping
+ * Ensures that software packet timestamps are delivered with received
+ * datagrams, and that transmit timestamps raise BAL_EVT_TXTIME (where the
+ * platform supports kernel timestamping).
+ */
+bool baltest_timestamping(void);
+
+/**
+ * @test baltest_resolve_async
+ * Ensures that names resolved on the resolver threads are delivered through the
+ * event thread, and that bal_connect_async results in BAL_EVT_CONNECT.
+ */
+bool baltest_resolve_async(void);
+
+/**
+ * @test baltest_resolver_cache
+ * Ensures that repeated lookups are answered by the resolver cache, that the
+ * cache stays within its size limit, and that it can be flushed and disabled.
+ */
+bool baltest_resolver_cache(void);
+
+/**
+ * @test baltest_sendto_dest
+ * Ensures that prepared destinations can be sent to individually and in a
+ * batch (fan-out).
+ */
+bool baltest_sendto_dest(void);
+
+/**
+ * @test baltest_connect_race
+ * Ensures that bal_connect_race_addrlist moves past refused addresses to one
+ * that accepts, and reports BAL_EVT_CONNFAIL when every address fails.
+ */
+bool baltest_connect_race(void);
+
+/**
+ * @test baltest_addrlist
+ * Ensures that address lists enumerate correctly whether their storage is
+ * inline or on the heap.
+ */
+bool baltest_addrlist(void);
+
+/**
+ * @test baltest_parse_addr
+ * Ensures that literal addresses and numeric ports are parsed (and everything
+ * else is rejected) by bal_parse_addr, and compares its speed to getaddrinfo.
+ */
+bool baltest_parse_addr(void);
+
+/**
+ * @test baltest_format_addr
+ * Ensures that bal_format_addr and bal_get_addrstrings format addresses the
+ * way getnameinfo does, and that reverse lookups are cached.
+ */
+bool baltest_format_addr(void);
+
+/**
+ * @test baltest_error_lazy
+ * Ensures that error messages are formatted when retrieved, and that
+ * would-block results leave the error state untouched.
+ */
+bool baltest_error_lazy(void);
+
+/**
+ * @test baltest_try_io
+ * Ensures that bal_try_send/bal_try_recv distinguish success, would-block,
+ * end of stream and errors.
+ */
+bool baltest_try_io(void);
+
+/**
+ * @test baltest_dbglog_async
+ * Ensures that debug log arguments survive capture and deferred formatting,
+ * and that messages are written by the log thread.
+ */
+bool baltest_dbglog_async(void);
+
+/**
+ * @test baltest_trace
+ * Ensures that event loop phases, accept, connect and close are traced, and
+ * that bal_trace_dump writes them as Chrome trace JSON.
+ */
+bool baltest_trace(void);
+
+/**
+ * @test baltest_stats
+ * Ensures that library-wide and per-socket statistics count I/O, events,
+ * callbacks and allocations.
+ */
+bool baltest_stats(void);
+
+/**
+ * @test baltest_callback_watchdog
+ * Ensures that callbacks exceeding the budget are reported through the hook,
+ * and that callback durations and loop lag are recorded in histograms.
+ */
+bool baltest_callback_watchdog(void);
+
+/**
+ * @test baltest_lock_profiler
+ * Ensures that acquisitions, wait and hold times are recorded per lock site,
+ * and that they can be reset.
+ */
+bool baltest_lock_profiler(void);
+
+/**
+ * @test baltest_arena
+ * Ensures that a socket's arena hands out aligned memory across chunks,
+ * including oversized allocations, and that it can be reset.
+ */
+bool baltest_arena(void);
+
+/**
+ * @test baltest_connection_pool
+ * Ensures that pooled connections are reused, that idle connections closed by
+ * the peer are discarded, and that asynchronous checkouts wait for a free slot.
+ */
+bool baltest_connection_pool(void);
+
+/**
+ * @test baltest_coalesce_close
+ * Ensures that closing a coalescing socket without destroying it drops the
+ * data that couldn't be sent, rather than leaving it to be flushed later on a
+ * closed, or reused, descriptor.
+ */
+bool baltest_coalesce_close(void);
+
+/**
+ * @test baltest_coalesce_error
+ * Ensures that when a coalesced flush fails, the next send reports the failure
+ * as an error, whatever the last OS error code happened to be.
+ */
+bool baltest_coalesce_error(void);
+
 #endif /* !_BAL_TESTS_H_INCLUDED */
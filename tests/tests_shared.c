@@ -88,3 +88,27 @@ void _bal_async_poll_callback(bal_socket* s, uint32_t events)
     BAL_UNUSED(s);
     BAL_UNUSED(events);
 }
+
+bool _bal_loopback_listener(bal_socket** l, bal_addrstrings* strings)
+{
+    bal_addrstrings tmp = {0};
+    bool pass = bal_create(l, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, bal_bind(*l, "127.0.0.1", "0"));
+    _bal_eqland(pass, bal_listen(*l, SOMAXCONN));
+    _bal_eqland(pass, bal_get_localhost_strings(*l, false, NULL != strings ? strings : &tmp));
+    return pass;
+}
+
+bool _bal_loopback_pair(bal_socket** l, bal_socket** c, bal_socket** a,
+    bal_addrstrings* strings)
+{
+    bal_addrstrings tmp = {0};
+    bal_addrstrings* out = NULL != strings ? strings : &tmp;
+    bal_sockaddr peer    = {0};
+
+    bool pass = _bal_loopback_listener(l, out);
+    _bal_eqland(pass, bal_create(c, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(*c, "127.0.0.1", out->port));
+    _bal_eqland(pass, bal_accept(*l, a, &peer));
+    return pass;
+}
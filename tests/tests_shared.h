@@ -155,6 +155,16 @@ void _bal_end_all_tests(size_t total, size_t run, size_t passed);
 /** Handles and prints async I/O events as they arrive for a socket. */
 void _bal_async_poll_callback(bal_socket* s, uint32_t events);
 
+/** Creates a TCP socket listening on an ephemeral port on 127.0.0.1; the
+ * port is stored in `strings` (if not NULL). */
+bool _bal_loopback_listener(bal_socket** l, bal_addrstrings* strings);
+
+/** Creates a loopback listener, a client connected to it, and the accepted
+ * end of that connection. Sockets created before a failure are returned, so
+ * that the caller can clean them up. */
+bool _bal_loopback_pair(bal_socket** l, bal_socket** c, bal_socket** a,
+    bal_addrstrings* strings);
+
 # if defined(__cplusplus)
 }
 # endif